@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <libslic3r/GCodeReader.hpp>
+
+#include <libnest2d/tools/benchmark.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <boost/nowide/fstream.hpp>
+
+// Measures the throughput of GCodeReader::parse_file() (memory mapped), of GCodeReader::parse_buffer() on an in-memory
+// G-code and of the former way of parsing a file line by line through std::getline().
+// Without an input file, a synthetic G-code file of about 500 MB is generated into the temp directory.
+int main(const int argc, const char * argv[])
+{
+    using namespace Slic3r;
+
+    if (argc > 2) {
+        std::cout << "Usage: gcodereader [<input_file.gcode>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string path;
+    bool        temporary = argc == 1;
+    if (temporary) {
+        path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("gcodereader-%%%%-%%%%.gcode")).string();
+        FILE *f = boost::nowide::fopen(path.c_str(), "wb");
+        if (f == nullptr) {
+            std::cerr << "Cannot create " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+        double e = 0.;
+        size_t size = 0;
+        for (int layer = 0; size < 500 * 1024 * 1024; ++ layer) {
+            size += fprintf(f, ";LAYER_CHANGE\nG1 Z%.3f F7800.000\n", 0.2 + 0.2 * layer);
+            for (int i = 0; i < 10000; ++ i) {
+                e += 0.03826;
+                size += fprintf(f, "G1 X%.3f Y%.3f E%.5f ; perimeter\n", 100. + (i % 997) * 0.013, 95. + (i % 991) * 0.017, e);
+                if (i % 100 == 0)
+                    size += fprintf(f, "G1 X%.3f Y%.3f F9000.000\n", 80. + (i % 89) * 0.5, 70. + (i % 83) * 0.5);
+            }
+        }
+        fclose(f);
+    } else
+        path = argv[1];
+
+    const double size_MB = double(boost::filesystem::file_size(path)) / (1024. * 1024.);
+    std::cout << "G-code file: " << path << ", " << size_MB << " MB" << std::endl;
+
+    auto report = [size_MB](const char *name, double seconds, size_t lines) {
+        std::cout << name << ": " << seconds << " s, " << size_MB / seconds << " MB/s, " << lines << " lines" << std::endl;
+    };
+
+    Benchmark bench;
+    size_t    lines = 0;
+    float     x_sum = 0.f;
+    auto      callback = [&lines, &x_sum](GCodeReader &, const GCodeReader::GCodeLine &line) {
+        ++ lines;
+        if (line.has_x())
+            x_sum += line.x();
+    };
+
+    {
+        GCodeReader reader;
+        bench.start();
+        reader.parse_file(path, callback);
+        bench.stop();
+        report("parse_file (memory mapped)", bench.getElapsedSec(), lines);
+    }
+
+    {
+        lines = 0;
+        GCodeReader reader;
+        std::ifstream f(path);
+        std::string line;
+        bench.start();
+        while (std::getline(f, line))
+            reader.parse_line(line, callback);
+        bench.stop();
+        report("std::getline + parse_line", bench.getElapsedSec(), lines);
+    }
+
+    {
+        std::string buffer;
+        {
+            boost::nowide::ifstream f(path, std::ios::in | std::ios::binary);
+            buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        }
+        lines = 0;
+        GCodeReader reader;
+        bench.start();
+        reader.parse_buffer(buffer, callback);
+        bench.stop();
+        report("parse_buffer (in memory)", bench.getElapsedSec(), lines);
+    }
+
+    // Print the checksum, so that the parsing is not optimized out.
+    std::cout << "Checksum: " << x_sum << std::endl;
+
+    if (temporary)
+        boost::nowide::remove(path.c_str());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <libslic3r/GCodeWriter.hpp>
+
+#include <libnest2d/tools/benchmark.h>
+
+// Measures the number of G1 lines per second produced by GCodeWriter::extrude_to_xy() and travel_to_xy(),
+// and compares the GCodeG1Formatter with the std::ostringstream formatting the GCodeWriter used before.
+int main(const int argc, const char * argv[])
+{
+    using namespace Slic3r;
+
+    if (argc > 2) {
+        std::cout << "Usage: gcodewriter [<number_of_lines>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const size_t num_lines = argc == 2 ? size_t(std::atoll(argv[1])) : 10000000;
+
+    GCodeWriter writer;
+    writer.set_extruders({ 0 });
+    writer.set_tool(0);
+
+    auto point = [](size_t i) { return Vec2d(100. + double(i % 997) * 0.0131, 95. + double(i % 991) * 0.0173); };
+    auto report = [num_lines](const char *name, double seconds) {
+        std::cout << name << ": " << seconds << " s, " << double(num_lines) / seconds << " lines/s" << std::endl;
+    };
+
+    Benchmark bench;
+    size_t    size = 0;
+
+    bench.start();
+    for (size_t i = 0; i < num_lines; ++ i)
+        size += (i % 50 == 0) ?
+            writer.travel_to_xy(point(i)).size() :
+            writer.extrude_to_xy(point(i), 0.03826).size();
+    bench.stop();
+    report("GCodeWriter", bench.getElapsedSec());
+
+    double E = 0.;
+    bench.start();
+    for (size_t i = 0; i < num_lines; ++ i) {
+        GCodeG1Formatter gcode;
+        gcode.emit_xy(point(i));
+        gcode.emit_axis('E', E += 0.03826, GCodeG1Formatter::E_EXPORT_DIGITS);
+        size += gcode.string().size();
+    }
+    bench.stop();
+    report("GCodeG1Formatter", bench.getElapsedSec());
+
+    E = 0.;
+    bench.start();
+    for (size_t i = 0; i < num_lines; ++ i) {
+        Vec2d p = point(i);
+        std::ostringstream gcode;
+        gcode << "G1 X" << std::fixed << std::setprecision(3) << p.x()
+              <<   " Y" << std::fixed << std::setprecision(3) << p.y()
+              <<   " E" << std::fixed << std::setprecision(5) << (E += 0.03826) << "\n";
+        size += gcode.str().size();
+    }
+    bench.stop();
+    report("std::ostringstream", bench.getElapsedSec());
+
+    // Print the checksum, so that the formatting is not optimized out.
+    std::cout << "Checksum: " << size << std::endl;
+
+    return EXIT_SUCCESS;
+}
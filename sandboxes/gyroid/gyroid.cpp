@@ -0,0 +1,68 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include <libslic3r/ExPolygon.hpp>
+#include <libslic3r/Surface.hpp>
+#include <libslic3r/Fill/Fill.hpp>
+#include <libslic3r/Flow.hpp>
+
+#include <libnest2d/tools/benchmark.h>
+
+// Measures the throughput of the gyroid sparse infill: fills a 250x250 mm plate perforated with a grid of round holes
+// for the given number of layers (100 by default) at several densities, and reports the time per layer together with
+// the length of the generated infill.
+int main(const int argc, const char * argv[])
+{
+    using namespace Slic3r;
+
+    if (argc > 2 || (argc == 2 && atoi(argv[1]) <= 0)) {
+        std::cout << "Usage: gyroid [<number_of_layers>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const size_t num_layers   = (argc == 2) ? size_t(atoi(argv[1])) : 100;
+    const double plate_size   = 250.;
+    const double layer_height = 0.2;
+    const double spacing      = 0.45;
+
+    ExPolygon plate;
+    plate.contour.points = { Point::new_scale(0., 0.), Point::new_scale(plate_size, 0.), Point::new_scale(plate_size, plate_size), Point::new_scale(0., plate_size) };
+    for (double x = 25.; x < plate_size; x += 50.)
+        for (double y = 25.; y < plate_size; y += 50.) {
+            Polygon hole;
+            for (size_t i = 0; i < 64; ++ i) {
+                double angle = - 2. * M_PI * double(i) / 64.;
+                hole.points.emplace_back(Point::new_scale(x + 10. * cos(angle), y + 10. * sin(angle)));
+            }
+            plate.holes.emplace_back(std::move(hole));
+        }
+    Surface surface(stPosInternal | stDensSparse, plate);
+
+    Flow flow(float(spacing), float(layer_height), 0.4f);
+    for (float density : { 0.1f, 0.2f, 0.4f }) {
+        std::unique_ptr<Fill> filler(Fill::new_from_type("gyroid"));
+        filler->bounding_box = get_extents(plate.contour);
+        filler->angle        = 0.f;
+        filler->layer_id     = 0;
+        FillParams params;
+        params.density = density;
+        params.flow    = &flow;
+        filler->init_spacing(spacing, params);
+
+        Benchmark bench;
+        double    length = 0.;
+        bench.start();
+        for (size_t layer = 0; layer < num_layers; ++ layer) {
+            filler->z = layer_height * double(layer + 1);
+            for (const Polyline &polyline : filler->fill_surface(&surface, params))
+                length += unscale<double>(polyline.length());
+        }
+        bench.stop();
+        std::cout << "Density " << density * 100.f << "%: " << bench.getElapsedSec() << " s, " <<
+            bench.getElapsedSec() * 1000. / double(num_layers) << " ms per layer, " <<
+            length / double(num_layers) << " mm of infill per layer" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
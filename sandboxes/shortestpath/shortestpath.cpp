@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <libslic3r/ShortestPath.hpp>
+
+#include <libnest2d/tools/benchmark.h>
+
+// Measures chain_points(), chain_extrusion_entities() and chain_polylines() on large synthetic inputs: randomly scattered
+// short segments (gap fill like) and long parallel lines (dense infill like). Reports the run time and the length of
+// the travel moves, and compares them against a plain nearest neighbor search without a spatial index, which is what
+// the chaining degenerated to for large inputs.
+int main(const int argc, const char * argv[])
+{
+    using namespace Slic3r;
+
+    if (argc > 2) {
+        std::cout << "Usage: shortestpath [num_segments]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const size_t max_segments = (argc > 1) ? size_t(atoll(argv[1])) : 50000;
+
+    auto travel_length = [](const Polylines &polylines) {
+        double length = 0.;
+        for (size_t i = 1; i < polylines.size(); ++ i)
+            length += (polylines[i].first_point() - polylines[i - 1].last_point()).cast<double>().norm();
+        return unscale<double>(length);
+    };
+
+    // Nearest neighbor chaining by brute force, any segment may be reversed.
+    auto chain_brute_force = [](const Polylines &polylines) {
+        Polylines          out;
+        std::vector<char>  taken(polylines.size(), false);
+        Point              last = polylines.front().first_point();
+        out.reserve(polylines.size());
+        for (size_t iter = 0; iter < polylines.size(); ++ iter) {
+            size_t best_idx  = 0;
+            bool   best_rev  = false;
+            double best_dist = std::numeric_limits<double>::max();
+            for (size_t i = 0; i < polylines.size(); ++ i)
+                if (! taken[i]) {
+                    double d1 = (polylines[i].first_point() - last).cast<double>().squaredNorm();
+                    double d2 = (polylines[i].last_point()  - last).cast<double>().squaredNorm();
+                    if (d1 < best_dist) { best_dist = d1; best_idx = i; best_rev = false; }
+                    if (d2 < best_dist) { best_dist = d2; best_idx = i; best_rev = true; }
+                }
+            taken[best_idx] = true;
+            out.emplace_back(polylines[best_idx]);
+            if (best_rev)
+                out.back().reverse();
+            last = out.back().last_point();
+        }
+        return out;
+    };
+
+    std::mt19937 rng(0);
+    auto random_segments = [&rng](size_t num) {
+        std::uniform_real_distribution<double> pos(0., 200.), dir(-1., 1.);
+        Polylines out;
+        for (size_t i = 0; i < num; ++ i) {
+            Vec2d a(pos(rng), pos(rng));
+            Vec2d b = a + Vec2d(dir(rng), dir(rng));
+            out.emplace_back(Polyline(Point::new_scale(a.x(), a.y()), Point::new_scale(b.x(), b.y())));
+        }
+        return out;
+    };
+    auto parallel_lines = [&rng](size_t num) {
+        std::uniform_real_distribution<double> jitter(0., 2.);
+        Polylines out;
+        for (size_t i = 0; i < num; ++ i) {
+            // Lines of 100 columns of 10 mm length, interrupted by holes.
+            double x = 200. * double(i / 100) / double(num / 100 + 1);
+            double y = 2. * double(i % 100);
+            out.emplace_back(Polyline(Point::new_scale(x, y + jitter(rng) * 0.1), Point::new_scale(x, y + 1.5 + jitter(rng) * 0.1)));
+        }
+        std::shuffle(out.begin(), out.end(), rng);
+        return out;
+    };
+
+    Benchmark bench;
+    auto report = [&bench](const char *name, double travel) {
+        std::cout << "    " << name << ": " << bench.getElapsedSec() << " s, travel " << travel << " mm" << std::endl;
+    };
+
+    for (size_t num_segments = 1000; num_segments <= max_segments; num_segments *= 4) {
+        for (int input = 0; input < 2; ++ input) {
+            Polylines polylines = (input == 0) ? random_segments(num_segments) : parallel_lines(num_segments);
+            std::cout << ((input == 0) ? "Random segments: " : "Parallel lines: ") << num_segments << std::endl;
+
+            {
+                bench.start();
+                Polylines chained = chain_brute_force(polylines);
+                bench.stop();
+                report("nearest neighbor, brute force", travel_length(chained));
+            }
+            {
+                Points points;
+                points.reserve(polylines.size());
+                for (const Polyline &pl : polylines)
+                    points.emplace_back(pl.first_point());
+                bench.start();
+                std::vector<size_t> order = chain_points(points);
+                bench.stop();
+                double travel = 0.;
+                for (size_t i = 1; i < order.size(); ++ i)
+                    travel += (points[order[i]] - points[order[i - 1]]).cast<double>().norm();
+                report("chain_points (first points only)", unscale<double>(travel));
+            }
+            {
+                std::vector<ExtrusionEntity*> entities;
+                entities.reserve(polylines.size());
+                for (const Polyline &pl : polylines) {
+                    ExtrusionPath *path = new ExtrusionPath(erGapFill, 0.01, 0.4f, 0.2f);
+                    path->polyline = pl;
+                    entities.emplace_back(path);
+                }
+                Point start_near = polylines.front().first_point();
+                bench.start();
+                chain_and_reorder_extrusion_entities(entities, &start_near);
+                bench.stop();
+                Polylines chained;
+                for (ExtrusionEntity *ee : entities) {
+                    chained.emplace_back(static_cast<ExtrusionPath*>(ee)->polyline);
+                    delete ee;
+                }
+                report("chain_extrusion_entities", travel_length(chained));
+            }
+            {
+                Polylines src = polylines;
+                bench.start();
+                Polylines chained = chain_polylines(std::move(src));
+                bench.stop();
+                report("chain_polylines", travel_length(chained));
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
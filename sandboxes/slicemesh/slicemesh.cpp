@@ -0,0 +1,63 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <libslic3r/TriangleMesh.hpp>
+
+#include <libnest2d/tools/benchmark.h>
+
+#include <tbb/task_scheduler_init.h>
+
+// Measures the scaling of TriangleMeshSlicer::slice() with the number of threads for both slicing algorithms.
+// Without an input file, a sphere of about 5 million triangles is sliced.
+int main(const int argc, const char * argv[])
+{
+    using namespace Slic3r;
+
+    if (argc > 3) {
+        std::cout << "Usage: slicemesh [<input_file.stl> [max_threads]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    TriangleMesh mesh;
+    if (argc > 1) {
+        mesh.ReadSTLFile(argv[1]);
+        mesh.repair();
+    } else
+        // 2236 sectors x 1118 stacks x 2 triangles.
+        mesh = make_sphere(50., 2. * PI / 2236.);
+    mesh.require_shared_vertices();
+
+    int max_threads = (argc > 2) ? atoi(argv[2]) : int(std::thread::hardware_concurrency());
+    if (max_threads < 1)
+        max_threads = 1;
+
+    BoundingBoxf3 bb = mesh.bounding_box();
+    std::vector<float> z;
+    for (double slice_z = bb.min.z() + 0.025; slice_z < bb.max.z(); slice_z += 0.05)
+        z.emplace_back(float(slice_z));
+
+    std::cout << "Facets: " << mesh.facets_count() << ", layers: " << z.size() << std::endl;
+
+    Benchmark bench;
+    for (TriangleMeshSlicer::Algorithm algorithm : { TriangleMeshSlicer::Algorithm::FacetParallel, TriangleMeshSlicer::Algorithm::Sweep }) {
+        std::cout << ((algorithm == TriangleMeshSlicer::Algorithm::Sweep) ? "Sweep" : "Facet parallel") << std::endl;
+        double time_single = 0.;
+        for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+            tbb::task_scheduler_init scheduler(num_threads);
+            TriangleMeshSlicer slicer(0.f, 0.f);
+            slicer.algorithm = algorithm;
+            slicer.init(&mesh, [](){});
+            std::vector<ExPolygons> layers;
+            bench.start();
+            slicer.slice(z, SlicingMode::Regular, &layers, [](){});
+            bench.stop();
+            double time = bench.getElapsedSec();
+            if (num_threads == 1)
+                time_single = time;
+            std::cout << "Threads: " << num_threads << " slicing time: " << time << "s speedup: " << time_single / time << std::endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <admesh/stl.h>
+
+#include <libnest2d/tools/benchmark.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/nowide/cstdio.hpp>
+
+// Measures the time of stl_open() loading an ASCII and a binary STL file.
+// Without input files, a random mesh of 10M facets (or of the given number of facets) is saved as ASCII and as binary STL
+// into the temp directory, then both files are loaded and compared to the generated mesh.
+int main(const int argc, const char * argv[])
+{
+    if (argc > 2 || (argc == 2 && atoi(argv[1]) <= 0)) {
+        std::cout << "Usage: stlload [<number_of_facets>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    stl_file stl;
+    stl.stats.number_of_facets = (argc == 2) ? uint32_t(atoi(argv[1])) : 10000000;
+    stl_allocate(&stl);
+    srand(0);
+    auto random_coordinate = []() { return float(rand() % 2000000) * 0.0001f - 100.f; };
+    for (stl_facet &facet : stl.facet_start) {
+        for (size_t i = 0; i < 3; ++ i)
+            for (size_t j = 0; j < 3; ++ j)
+                facet.vertex[i](j) = random_coordinate();
+        stl_calculate_normal(facet.normal, &facet);
+        stl_normalize_vector(facet.normal);
+    }
+
+    Benchmark   bench;
+    std::string path_ascii  = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("stlload-%%%%-%%%%-ascii.stl")).string();
+    std::string path_binary = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("stlload-%%%%-%%%%-binary.stl")).string();
+    bench.start();
+    bool written = stl_write_ascii(&stl, path_ascii.c_str(), "stlload") && stl_write_binary(&stl, path_binary.c_str(), "stlload");
+    bench.stop();
+    if (! written) {
+        std::cerr << "Cannot create " << path_ascii << " or " << path_binary << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Generated " << stl.stats.number_of_facets << " facets in " << bench.getElapsedSec() << " s" << std::endl;
+
+    bool ok = true;
+    for (const std::string &path : { path_ascii, path_binary }) {
+        const double size_MB = double(boost::filesystem::file_size(path)) / (1024. * 1024.);
+        stl_file     loaded;
+        bench.start();
+        bool         result = stl_open(&loaded, path.c_str());
+        bench.stop();
+        bool         same = result && loaded.stats.number_of_facets == stl.stats.number_of_facets;
+        for (size_t i = 0; same && i < stl.facet_start.size(); ++ i)
+            for (size_t j = 0; j < 3; ++ j)
+                same &= loaded.facet_start[i].vertex[j] == stl.facet_start[i].vertex[j];
+        std::cout << (loaded.stats.type == binary ? "binary" : "ASCII") << " STL, " << size_MB << " MB: " <<
+            bench.getElapsedSec() << " s, " << size_MB / bench.getElapsedSec() << " MB/s, " <<
+            loaded.stats.number_of_facets << " facets" << (same ? "" : ", MISMATCH") << std::endl;
+        ok &= same;
+        boost::nowide::remove(path.c_str());
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -34,6 +34,9 @@
 #define BOOST_POOL_NO_MT
 #include <boost/pool/object_pool.hpp>
 
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+
 #include "stl.h"
 
 struct HashEdge {
@@ -53,12 +56,19 @@ struct HashEdge {
 
 	void load_exact(stl_file *stl, const stl_vertex *a, const stl_vertex *b)
 	{
-		{
-	    	stl_vertex diff = (*a - *b).cwiseAbs();
-	    	float max_diff = std::max(diff(0), std::max(diff(1), diff(2)));
-	    	stl->stats.shortest_edge = std::min(max_diff, stl->stats.shortest_edge);
-	  	}
+		stl->stats.shortest_edge = std::min(edge_length(*a, *b), stl->stats.shortest_edge);
+		this->load_exact_key(a, b);
+	}
+
+	// Length of an edge as accumulated into stl_stats::shortest_edge.
+	static float edge_length(const stl_vertex &a, const stl_vertex &b)
+	{
+		stl_vertex diff = (a - b).cwiseAbs();
+		return std::max(diff(0), std::max(diff(1), diff(2)));
+	}
 
+	void load_exact_key(const stl_vertex *a, const stl_vertex *b)
+	{
 	  	// Ensure identical vertex ordering of equal edges.
 	  	// This method is numerically robust.
 	  	if (vertex_lower(*a, *b)) {
@@ -120,6 +130,25 @@ private:
 	}
 };
 
+// Record facets of edge_a and edge_b as neighbors. Only the neighbors of the two edges are written,
+// thus different pairs of edges may be linked in parallel.
+static void link_neighbors(stl_file *stl, const HashEdge &edge_a, const HashEdge &edge_b)
+{
+	// Facet a's neighbor is facet b
+	stl->neighbors_start[edge_a.facet_number].neighbor[edge_a.which_edge % 3] = edge_b.facet_number;	/* sets the .neighbor part */
+	stl->neighbors_start[edge_a.facet_number].which_vertex_not[edge_a.which_edge % 3] = (edge_b.which_edge + 2) % 3; /* sets the .which_vertex_not part */
+
+	// Facet b's neighbor is facet a
+	stl->neighbors_start[edge_b.facet_number].neighbor[edge_b.which_edge % 3] = edge_a.facet_number;	/* sets the .neighbor part */
+	stl->neighbors_start[edge_b.facet_number].which_vertex_not[edge_b.which_edge % 3] = (edge_a.which_edge + 2) % 3; /* sets the .which_vertex_not part */
+
+	if (((edge_a.which_edge < 3) && (edge_b.which_edge < 3)) || ((edge_a.which_edge > 2) && (edge_b.which_edge > 2))) {
+		// These facets are oriented in opposite directions, their normals are probably messed up.
+		stl->neighbors_start[edge_a.facet_number].which_vertex_not[edge_a.which_edge % 3] += 3;
+		stl->neighbors_start[edge_b.facet_number].which_vertex_not[edge_b.which_edge % 3] += 3;
+	}
+}
+
 struct HashTableEdges {
 	HashTableEdges(size_t number_of_faces) {
 		this->M = (int)hash_size_from_nr_faces(number_of_faces);
@@ -241,19 +270,7 @@ private:
 
 	static void record_neighbors(stl_file *stl, const HashEdge &edge_a, const HashEdge &edge_b)
 	{
-		// Facet a's neighbor is facet b
-		stl->neighbors_start[edge_a.facet_number].neighbor[edge_a.which_edge % 3] = edge_b.facet_number;	/* sets the .neighbor part */
-		stl->neighbors_start[edge_a.facet_number].which_vertex_not[edge_a.which_edge % 3] = (edge_b.which_edge + 2) % 3; /* sets the .which_vertex_not part */
-
-		// Facet b's neighbor is facet a
-		stl->neighbors_start[edge_b.facet_number].neighbor[edge_b.which_edge % 3] = edge_a.facet_number;	/* sets the .neighbor part */
-		stl->neighbors_start[edge_b.facet_number].which_vertex_not[edge_b.which_edge % 3] = (edge_a.which_edge + 2) % 3; /* sets the .which_vertex_not part */
-
-		if (((edge_a.which_edge < 3) && (edge_b.which_edge < 3)) || ((edge_a.which_edge > 2) && (edge_b.which_edge > 2))) {
-			// These facets are oriented in opposite directions, their normals are probably messed up.
-			stl->neighbors_start[edge_a.facet_number].which_vertex_not[edge_a.which_edge % 3] += 3;
-			stl->neighbors_start[edge_b.facet_number].which_vertex_not[edge_b.which_edge % 3] += 3;
-		}
+		link_neighbors(stl, edge_a, edge_b);
 
 		// Count successful connects:
 		// Total connects:
@@ -425,6 +442,59 @@ private:
 	}
 };
 
+// Edge of a facet sorted by stl_check_facets_exact().
+struct SortedEdge {
+	// Hash of the key of the edge.
+	uint32_t hash;
+	// facet_number * 3 + index of the edge in the facet.
+	uint32_t idx;
+};
+
+// Stable parallel LSD radix sort of the edges by their hashes.
+static void radix_sort_edges(std::vector<SortedEdge> &edges)
+{
+	static constexpr const int      digit_bits = 11;
+	static constexpr const uint32_t num_digits = 1 << digit_bits;
+	static constexpr const size_t   chunk_size = 65536;
+	const size_t                    num_chunks = std::max<size_t>(1, (edges.size() + chunk_size - 1) / chunk_size);
+	std::vector<SortedEdge>         out(edges.size());
+	// Histogram of the digits of each chunk, turned into the output positions.
+	std::vector<size_t>             positions(num_chunks * num_digits);
+	for (int shift = 0; shift < 32; shift += digit_bits) {
+		auto digit = [shift](const SortedEdge &edge) { return (edge.hash >> shift) & (num_digits - 1); };
+		auto chunk_range = [&edges](size_t ichunk) {
+			return std::make_pair(edges.begin() + ichunk * chunk_size, edges.begin() + std::min(edges.size(), (ichunk + 1) * chunk_size));
+		};
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, num_chunks), [&positions, &digit, &chunk_range](const tbb::blocked_range<size_t> &range) {
+			for (size_t ichunk = range.begin(); ichunk < range.end(); ++ ichunk) {
+				size_t *histogram = positions.data() + ichunk * num_digits;
+				std::fill(histogram, histogram + num_digits, 0);
+				auto r = chunk_range(ichunk);
+				for (auto it = r.first; it != r.second; ++ it)
+					++ histogram[digit(*it)];
+			}
+		});
+		// Output positions ordered by the digit, then by the chunk.
+		size_t position = 0;
+		for (uint32_t d = 0; d < num_digits; ++ d)
+			for (size_t ichunk = 0; ichunk < num_chunks; ++ ichunk) {
+				size_t &p = positions[ichunk * num_digits + d];
+				size_t  cnt = p;
+				p = position;
+				position += cnt;
+			}
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, num_chunks), [&positions, &out, &digit, &chunk_range](const tbb::blocked_range<size_t> &range) {
+			for (size_t ichunk = range.begin(); ichunk < range.end(); ++ ichunk) {
+				size_t *position = positions.data() + ichunk * num_digits;
+				auto r = chunk_range(ichunk);
+				for (auto it = r.first; it != r.second; ++ it)
+					out[position[digit(*it)] ++] = *it;
+			}
+		});
+		edges.swap(out);
+	}
+}
+
 // This function builds the neighbors list.  No modifications are made
 // to any of the facets.  The edges are said to match only if all six
 // floats of the first edge matches all six floats of the second edge.
@@ -453,22 +523,93 @@ void stl_check_facets_exact(stl_file *stl)
 		  	++ i;
   	}
 
-  	// Initialize hash table.
-  	HashTableEdges hash_table(stl->stats.number_of_facets);
 	for (auto &neighbor : stl->neighbors_start)
 		neighbor.reset();
 
-  	// Connect neighbor edges.
-	for (uint32_t i = 0; i < stl->stats.number_of_facets; ++ i) {
-		const stl_facet &facet = stl->facet_start[i];
-		for (int j = 0; j < 3; ++ j) {
-			HashEdge edge;
-			edge.facet_number = i;
-			edge.which_edge = j;
-			edge.load_exact(stl, &facet.vertex[j], &facet.vertex[(j + 1) % 3]);
-			hash_table.insert_edge_exact(stl, edge);
+	// Connect neighbor edges. Instead of inserting the edges one by one into HashTableEdges, the edges are sorted
+	// by a hash of their key in parallel. The edges of a run of equal hashes are then matched in the order, in which
+	// they would be inserted into the hash table, thus the neighbors are the same as if matched through the hash table.
+	auto load_edge = [stl](size_t idx) {
+		HashEdge edge;
+		edge.facet_number = int(idx / 3);
+		edge.which_edge   = int(idx % 3);
+		const stl_facet &facet = stl->facet_start[edge.facet_number];
+		edge.load_exact_key(&facet.vertex[edge.which_edge], &facet.vertex[(edge.which_edge + 1) % 3]);
+		return edge;
+	};
+	std::vector<SortedEdge> edges(size_t(stl->stats.number_of_facets) * 3);
+	stl->stats.shortest_edge = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, stl->stats.number_of_facets), stl->stats.shortest_edge,
+		[stl, &edges, &load_edge](const tbb::blocked_range<size_t> &range, float shortest_edge) {
+			for (size_t i = range.begin(); i < range.end(); ++ i) {
+				const stl_facet &facet = stl->facet_start[i];
+				for (size_t j = 0; j < 3; ++ j) {
+					shortest_edge = std::min(shortest_edge, HashEdge::edge_length(facet.vertex[j], facet.vertex[(j + 1) % 3]));
+					HashEdge edge = load_edge(i * 3 + j);
+					uint64_t hash = 0;
+					for (size_t k = 0; k < 6; ++ k)
+						hash = (hash ^ edge.key[k]) * 0x9E3779B97F4A7C15ull;
+					edges[i * 3 + j] = { uint32_t(hash >> 32), uint32_t(i * 3 + j) };
+				}
+			}
+			return shortest_edge;
+		},
+		[](float a, float b) { return std::min(a, b); });
+	// Stable sort, the edges of equal hashes stay sorted by their index.
+	radix_sort_edges(edges);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, edges.size()), [stl, &edges, &load_edge](const tbb::blocked_range<size_t> &range) {
+		// Edges not matched yet of the current run of equal hashes, in the order of insertion.
+		std::vector<HashEdge> unmatched;
+		// A run of equal hashes is processed by the range containing its start.
+		size_t begin = range.begin();
+		while (begin > 0 && begin < range.end() && edges[begin].hash == edges[begin - 1].hash)
+			++ begin;
+		for (size_t run_begin = begin; run_begin < range.end();) {
+			size_t run_end = run_begin + 1;
+			while (run_end < edges.size() && edges[run_end].hash == edges[run_begin].hash)
+				++ run_end;
+			for (size_t i = run_begin; i < run_end; ++ i) {
+				HashEdge edge = load_edge(edges[i].idx);
+				// Edges of different facet are allowed to be matched. Different keys may share a hash.
+				auto it = std::find_if(unmatched.begin(), unmatched.end(),
+					[&edge](const HashEdge &other) { return edge.facet_number != other.facet_number && edge == other; });
+				if (it == unmatched.end())
+					unmatched.emplace_back(edge);
+				else {
+					link_neighbors(stl, edge, *it);
+					unmatched.erase(it);
+				}
+			}
+			unmatched.clear();
+			run_begin = run_end;
 		}
-	}
+	});
+
+	// Count successful connects.
+	struct Connects {
+		int edges     = 0;
+		int facets[3] = { 0, 0, 0 };
+	};
+	Connects connects = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, stl->stats.number_of_facets), Connects(),
+		[stl](const tbb::blocked_range<size_t> &range, Connects connects) {
+			for (size_t i = range.begin(); i < range.end(); ++ i) {
+				int num_neighbors = stl->neighbors_start[i].num_neighbors();
+				connects.edges += num_neighbors;
+				// A facet with n neighbors is counted as connected with 1 up to n edges.
+				for (int j = 0; j < num_neighbors; ++ j)
+					++ connects.facets[j];
+			}
+			return connects;
+		},
+		[](Connects a, const Connects &b) {
+			a.edges += b.edges;
+			for (int j = 0; j < 3; ++ j)
+				a.facets[j] += b.facets[j];
+			return a;
+		});
+	stl->stats.connected_edges         = connects.edges;
+	stl->stats.connected_facets_1_edge = connects.facets[0];
+	stl->stats.connected_facets_2_edge = connects.facets[1];
+	stl->stats.connected_facets_3_edge = connects.facets[2];
 
 #if 0
 	printf("Number of faces: %d, number of manifold edges: %d, number of connected edges: %d, number of unconnected edges: %d\r\n", 
@@ -23,18 +23,214 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 
 #include <boost/log/trivial.hpp>
 #include <boost/nowide/cstdio.hpp>
 
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
 #include "stl.h"
 
-void stl_generate_shared_vertices(stl_file *stl, indexed_triangle_set &its)
+// Traverse the fan around the j-th vertex of the facet_idx-th face, call visit(facet, vertex) for all the neighboring triangles
+// in the triangle fan. visited(facet) returns true for the facets already visited by this traversal.
+template<typename Visit, typename Visited>
+static void stl_traverse_fan(const stl_file *stl, int facet_idx, int j, Visit visit, Visited visited)
+{
+	int  facet_in_fan_idx 	= facet_idx;
+	bool edge_direction 	= false;
+	bool traversal_reversed = false;
+	int  vnot      			= (j + 2) % 3;
+	for (;;) {
+		// Next edge on facet_in_fan_idx to be traversed. The edge is indexed by its starting vertex index.
+		int next_edge    = 0;
+		// Vertex index in facet_in_fan_idx, which is being pivoted around, and which is being assigned a new shared vertex.
+		int pivot_vertex = 0;
+		if (vnot > 2) {
+			// The edge of facet_in_fan_idx opposite to vnot is equally oriented, therefore
+			// the neighboring facet is flipped.
+	  		if (! edge_direction) {
+	    		pivot_vertex = (vnot + 2) % 3;
+	    		next_edge    = pivot_vertex;			    		
+	  		} else {
+	    		pivot_vertex = (vnot + 1) % 3;
+	    		next_edge    = vnot % 3;
+	  		}
+	  		edge_direction = ! edge_direction;
+		} else {
+			// The neighboring facet is correctly oriented.
+	  		if (! edge_direction) {
+	    		pivot_vertex = (vnot + 1) % 3;
+	    		next_edge    = vnot;
+	  		} else {
+	    		pivot_vertex = (vnot + 2) % 3;
+	    		next_edge    = pivot_vertex;
+	  		}
+		}
+		visit(facet_in_fan_idx, pivot_vertex);
+
+		// next_edge is an index of the starting vertex of the edge, not an index of the opposite vertex to the edge!
+		int next_facet = stl->neighbors_start[facet_in_fan_idx].neighbor[next_edge];
+		if (next_facet == -1) {
+			// No neighbor going in the current direction.
+			if (traversal_reversed) {
+				// Went to one limit, then turned back and reached the other limit. Quit the fan traversal.
+			    break;
+			} else {
+				// Reached the first limit. Now try to reverse and traverse up to the other limit.
+			    edge_direction        = true;
+			    vnot 	         	  = (j + 1) % 3;
+			    traversal_reversed    = true;
+		    	facet_in_fan_idx      = facet_idx;
+			}
+		} else if (next_facet == facet_idx) {
+			// Traversed a closed fan all around.
+//			assert(! traversal_reversed);
+			break;
+		} else if (next_facet >= (int)stl->stats.number_of_facets) {
+			// The mesh is not valid!
+			// assert(false);
+			break;
+		} else if (visited(next_facet)) {
+			// Traversed a closed fan all around, but did not reach the starting face.
+			// This indicates an invalid geometry (non-manifold).
+			//assert(false);
+			break;
+		} else {
+			// Continue traversal.
+			// next_edge is an index of the starting vertex of the edge, not an index of the opposite vertex to the edge!
+			vnot = stl->neighbors_start[facet_in_fan_idx].which_vertex_not[next_edge];
+			facet_in_fan_idx = next_facet;
+		}
+	}
+}
+
+// Assign the shared vertices in parallel. The fans are found as connected components of the vertices of the faces linked over
+// the neighbor edges, then each fan is traversed by stl_traverse_fan() starting with its first vertex. The result is verified
+// to be the same as the result of the serial traversal: If a traversal does not cover exactly its component, which may happen
+// for a non-manifold mesh, false is returned and the serial traversal has to be done.
+static bool stl_generate_shared_vertices_parallel(const stl_file *stl, indexed_triangle_set &its)
+{
+	const size_t num_corners = size_t(stl->stats.number_of_facets) * 3;
+	// Parent of a vertex of a face (facet_idx * 3 + j) in a disjoint set forest. The root is the lowest index of the component.
+	std::vector<std::atomic<int>> parent(num_corners);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, num_corners), [&parent](const tbb::blocked_range<size_t> &range) {
+		for (size_t i = range.begin(); i < range.end(); ++ i)
+			parent[i].store(int(i), std::memory_order_relaxed);
+	});
+	auto find = [&parent](int i) {
+		for (;;) {
+			int p = parent[i].load(std::memory_order_relaxed);
+			if (p == i)
+				return i;
+			// Path halving.
+			int pp = parent[p].load(std::memory_order_relaxed);
+			parent[i].compare_exchange_weak(p, pp, std::memory_order_relaxed);
+			i = pp;
+		}
+	};
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, stl->stats.number_of_facets), [stl, &parent, &find](const tbb::blocked_range<size_t> &range) {
+		for (size_t facet_idx = range.begin(); facet_idx < range.end(); ++ facet_idx)
+			for (int j = 0; j < 3; ++ j) {
+				// Link the j-th vertex with the same vertex of the neighbor over the edge ending with the j-th vertex,
+				// that is with the face visited next by stl_traverse_fan() starting with the j-th vertex.
+				int next_edge  = (j + 2) % 3;
+				int next_facet = stl->neighbors_start[facet_idx].neighbor[next_edge];
+				if (next_facet < 0 || next_facet >= (int)stl->stats.number_of_facets)
+					continue;
+				int vnot = stl->neighbors_start[facet_idx].which_vertex_not[next_edge];
+				int a    = int(facet_idx * 3 + j);
+				int b    = next_facet * 3 + ((vnot > 2) ? (vnot + 2) % 3 : (vnot + 1) % 3);
+				// Link the higher root below the lower root.
+				for (;;) {
+					a = find(a);
+					b = find(b);
+					if (a == b)
+						break;
+					if (a < b)
+						std::swap(a, b);
+					if (parent[a].compare_exchange_strong(a, b, std::memory_order_relaxed))
+						break;
+				}
+			}
+	});
+
+	// Number of the shared vertices, which are the roots, per block of the vertices of the faces.
+	static constexpr const size_t block_size = 65536;
+	std::vector<int> block_vertices((num_corners + block_size - 1) / block_size + 1, 0);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, block_vertices.size() - 1), [&parent, &block_vertices, num_corners](const tbb::blocked_range<size_t> &range) {
+		for (size_t iblock = range.begin(); iblock < range.end(); ++ iblock) {
+			int num_vertices = 0;
+			for (size_t i = iblock * block_size; i < std::min(num_corners, (iblock + 1) * block_size); ++ i)
+				num_vertices += parent[i].load(std::memory_order_relaxed) == int(i);
+			block_vertices[iblock + 1] = num_vertices;
+		}
+	});
+	for (size_t i = 1; i < block_vertices.size(); ++ i)
+		block_vertices[i] += block_vertices[i - 1];
+	its.vertices.assign(block_vertices.back(), stl_vertex());
+
+	// Traverse the fans starting with the roots, which are the vertices with the lowest index in the fans, thus the fans are
+	// started by the serial traversal at the same vertex. Each vertex of the face is marked with the root of the traversal,
+	// which reached it, and the traversal fails if it reaches a vertex of another component.
+	std::vector<std::atomic<int>> marks(num_corners);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, num_corners), [&marks](const tbb::blocked_range<size_t> &range) {
+		for (size_t i = range.begin(); i < range.end(); ++ i)
+			marks[i].store(-1, std::memory_order_relaxed);
+	});
+	std::atomic<bool> failed(false);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, block_vertices.size() - 1), [stl, &its, &parent, &find, &block_vertices, &marks, &failed, num_corners](const tbb::blocked_range<size_t> &range) {
+		for (size_t iblock = range.begin(); iblock < range.end() && ! failed; ++ iblock) {
+			int idx = block_vertices[iblock];
+			for (size_t i = iblock * block_size; i < std::min(num_corners, (iblock + 1) * block_size); ++ i) {
+				int root = int(i);
+				if (parent[i].load(std::memory_order_relaxed) != root)
+					continue;
+				int facet_idx = root / 3;
+				its.vertices[idx] = stl->facet_start[facet_idx].vertex[root % 3];
+				bool ok = true;
+				stl_traverse_fan(stl, facet_idx, root % 3,
+					[&its, &find, &marks, &ok, root, idx](int facet, int vertex) {
+						int corner = facet * 3 + vertex;
+						if (find(corner) == root) {
+							marks[corner].store(root, std::memory_order_relaxed);
+							its.indices[facet][vertex] = idx;
+						} else
+							ok = false;
+					},
+					[&marks, &ok, root](int facet) {
+						// A face reached out of the component terminates the traversal.
+						return ! ok || marks[facet * 3].load(std::memory_order_relaxed) == root || 
+							marks[facet * 3 + 1].load(std::memory_order_relaxed) == root || marks[facet * 3 + 2].load(std::memory_order_relaxed) == root;
+					});
+				if (! ok) {
+					failed = true;
+					break;
+				}
+				++ idx;
+			}
+		}
+	});
+	// Each vertex has to be reached by the traversal of its component.
+	return ! failed && std::none_of(marks.begin(), marks.end(), [](const std::atomic<int> &mark) { return mark.load(std::memory_order_relaxed) == -1; });
+}
+
+void stl_generate_shared_vertices(stl_file *stl, indexed_triangle_set &its, stl_shared_vertices_algorithm algorithm)
 {
 	// 3 indices to vertex per face
 	its.indices.assign(stl->stats.number_of_facets, stl_triangle_vertex_indices(-1, -1, -1));
+	// The parallel traversal does about three times the work of the serial traversal due to the random memory accesses
+	// of the disjoint set forest, it only pays off with enough threads.
+	if (algorithm == stl_shared_vertices_algorithm::automatic)
+		algorithm = tbb::task_scheduler_init::default_num_threads() >= 4 ? stl_shared_vertices_algorithm::parallel : stl_shared_vertices_algorithm::serial;
+	if (algorithm == stl_shared_vertices_algorithm::parallel && stl_generate_shared_vertices_parallel(stl, its))
+		return;
+
 	// Shared vertices (3D coordinates)
+	its.indices.assign(stl->stats.number_of_facets, stl_triangle_vertex_indices(-1, -1, -1));
 	its.vertices.clear();
 	its.vertices.reserve(stl->stats.number_of_facets / 2);
 
@@ -52,75 +248,13 @@ void stl_generate_shared_vertices(stl_file *stl, indexed_triangle_set &its)
 			// Create a new shared vertex.
 			its.vertices.emplace_back(stl->facet_start[facet_idx].vertex[j]);
 			// Traverse the fan around the j-th vertex of the i-th face, assign the newly created shared vertex index to all the neighboring triangles in the triangle fan.
-			int  facet_in_fan_idx 	= facet_idx;
-			bool edge_direction 	= false;
-			bool traversal_reversed = false;
-			int  vnot      			= (j + 2) % 3;
-			// Increase the 
 			++ fan_traversal_stamp;
-			for (;;) {
-				// Next edge on facet_in_fan_idx to be traversed. The edge is indexed by its starting vertex index.
-				int next_edge    = 0;
-				// Vertex index in facet_in_fan_idx, which is being pivoted around, and which is being assigned a new shared vertex.
-				int pivot_vertex = 0;
-				if (vnot > 2) {
-					// The edge of facet_in_fan_idx opposite to vnot is equally oriented, therefore
-					// the neighboring facet is flipped.
-			  		if (! edge_direction) {
-			    		pivot_vertex = (vnot + 2) % 3;
-			    		next_edge    = pivot_vertex;			    		
-			  		} else {
-			    		pivot_vertex = (vnot + 1) % 3;
-			    		next_edge    = vnot % 3;
-			  		}
-			  		edge_direction = ! edge_direction;
-				} else {
-					// The neighboring facet is correctly oriented.
-			  		if (! edge_direction) {
-			    		pivot_vertex = (vnot + 1) % 3;
-			    		next_edge    = vnot;
-			  		} else {
-			    		pivot_vertex = (vnot + 2) % 3;
-			    		next_edge    = pivot_vertex;
-			  		}
-				}
-				its.indices[facet_in_fan_idx][pivot_vertex] = its.vertices.size() - 1;
-				fan_traversal_facet_visited[facet_in_fan_idx] = fan_traversal_stamp;
-
-				// next_edge is an index of the starting vertex of the edge, not an index of the opposite vertex to the edge!
-				int next_facet = stl->neighbors_start[facet_in_fan_idx].neighbor[next_edge];
-				if (next_facet == -1) {
-					// No neighbor going in the current direction.
-					if (traversal_reversed) {
-						// Went to one limit, then turned back and reached the other limit. Quit the fan traversal.
-					    break;
-					} else {
-						// Reached the first limit. Now try to reverse and traverse up to the other limit.
-					    edge_direction        = true;
-					    vnot 	         	  = (j + 1) % 3;
-					    traversal_reversed    = true;
-				    	facet_in_fan_idx      = facet_idx;
-					}
-				} else if (next_facet == facet_idx) {
-					// Traversed a closed fan all around.
-//					assert(! traversal_reversed);
-					break;
-				} else if (next_facet >= (int)stl->stats.number_of_facets) {
-					// The mesh is not valid!
-					// assert(false);
-					break;
-				} else if (fan_traversal_facet_visited[next_facet] == fan_traversal_stamp) {
-					// Traversed a closed fan all around, but did not reach the starting face.
-					// This indicates an invalid geometry (non-manifold).
-					//assert(false);
-					break;
-				} else {
-					// Continue traversal.
-					// next_edge is an index of the starting vertex of the edge, not an index of the opposite vertex to the edge!
-					vnot = stl->neighbors_start[facet_in_fan_idx].which_vertex_not[next_edge];
-					facet_in_fan_idx = next_facet;
-				}
-			}
+			stl_traverse_fan(stl, facet_idx, j,
+				[&its, &fan_traversal_facet_visited, fan_traversal_stamp](int facet, int vertex) {
+					its.indices[facet][vertex] = its.vertices.size() - 1;
+					fan_traversal_facet_visited[facet] = fan_traversal_stamp;
+				},
+				[&fan_traversal_facet_visited, fan_traversal_stamp](int facet) { return fan_traversal_facet_visited[facet] == fan_traversal_stamp; });
 		}
 	}
 }
@@ -273,7 +273,11 @@ extern void its_rotate_x(indexed_triangle_set &its, float angle);
 extern void its_rotate_y(indexed_triangle_set &its, float angle);
 extern void its_rotate_z(indexed_triangle_set &its, float angle);
 
-extern void stl_generate_shared_vertices(stl_file *stl, indexed_triangle_set &its);
+// Algorithm of stl_generate_shared_vertices(). Both produce the same vertices in the same order.
+// The parallel one falls back to the serial one if a fan of a non-manifold mesh is not traversed completely,
+// the automatic choice only runs it with 4 or more threads.
+enum class stl_shared_vertices_algorithm { automatic, serial, parallel };
+extern void stl_generate_shared_vertices(stl_file *stl, indexed_triangle_set &its, stl_shared_vertices_algorithm algorithm = stl_shared_vertices_algorithm::automatic);
 extern bool its_write_obj(const indexed_triangle_set &its, const char *file);
 extern bool its_write_off(const indexed_triangle_set &its, const char *file);
 extern bool its_write_vrml(const indexed_triangle_set &its, const char *file);
@@ -24,222 +24,390 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include <assert.h>
 
+#include <memory>
+
 #include <boost/log/trivial.hpp>
 #include <boost/nowide/cstdio.hpp>
 #include <boost/detail/endian.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
-#include "stl.h"
+#include <tbb/parallel_for.h>
 
-#ifndef SEEK_SET
-#error "SEEK_SET not defined"
-#endif
+#include "stl.h"
 
 #ifndef BOOST_LITTLE_ENDIAN
 extern void stl_internal_reverse_quads(char *buf, size_t cnt);
 #endif /* BOOST_LITTLE_ENDIAN */
 
-static FILE* stl_open_count_facets(stl_file *stl, const char *file) 
+// Read the whole file into memory. Used if the file could not be memory mapped.
+static bool stl_read_file(const char *file, std::vector<char> &data)
 {
-  	// Open the file in binary mode first.
-  	FILE *fp = boost::nowide::fopen(file, "rb");
-  	if (fp == nullptr) {
-		BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: Couldn't open " << file << " for reading";
-    	return nullptr;
-  	}
-  	// Find size of file.
-  	fseek(fp, 0, SEEK_END);
-  	long file_size = ftell(fp);
-
-  	// Check for binary or ASCII file.
-  	fseek(fp, HEADER_SIZE, SEEK_SET);
-	unsigned char chtest[128];
-  	if (! fread(chtest, sizeof(chtest), 1, fp)) {
-		BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: The input is an empty file: " << file;
-    	fclose(fp);
-    	return nullptr;
-  	}
-  	stl->stats.type = ascii;
-  	for (size_t s = 0; s < sizeof(chtest); s++) {
-    	if (chtest[s] > 127) {
-      		stl->stats.type = binary;
-      		break;
-    	}
-  	}
-  	rewind(fp);
-
-  	uint32_t num_facets = 0;
-
-  	// Get the header and the number of facets in the .STL file.
-  	// If the .STL file is binary, then do the following:
-  	if (stl->stats.type == binary) {
-    	// Test if the STL file has the right size.
-    	if (((file_size - HEADER_SIZE) % SIZEOF_STL_FACET != 0) || (file_size < STL_MIN_FILE_SIZE)) {
-			BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: The file " << file << " has the wrong size.";
-      		fclose(fp);
-      		return nullptr;
-    	}
-    	num_facets = (file_size - HEADER_SIZE) / SIZEOF_STL_FACET;
-
-    	// Read the header.
-    	if (fread(stl->stats.header, LABEL_SIZE, 1, fp) > 79)
-      		stl->stats.header[80] = '\0';
-
-    	// Read the int following the header.  This should contain # of facets.
-	  	uint32_t header_num_facets;
-    	bool header_num_faces_read = fread(&header_num_facets, sizeof(uint32_t), 1, fp) != 0;
-#ifndef BOOST_LITTLE_ENDIAN
-    	// Convert from little endian to big endian.
-    	stl_internal_reverse_quads((char*)&header_num_facets, 4);
-#endif /* BOOST_LITTLE_ENDIAN */
-    	if (! header_num_faces_read || num_facets != header_num_facets)
-			BOOST_LOG_TRIVIAL(info) << "stl_open_count_facets: Warning: File size doesn't match number of facets in the header: " << file;
-  	}
-  	// Otherwise, if the .STL file is ASCII, then do the following:
-  	else
-  	{
-    	// Reopen the file in text mode (for getting correct newlines on Windows)
-    	// fix to silence a warning about unused return value.
-    	// obviously if it fails we have problems....
-    	fp = boost::nowide::freopen(file, "r", fp);
-
-		// do another null check to be safe
-    	if (fp == nullptr) {
-			BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: Couldn't open " << file << " for reading";
-      		fclose(fp);
-      		return nullptr;
-    	}
-    
-    	// Find the number of facets.
-		char linebuf[100];
-		int num_lines = 1;
-		while (fgets(linebuf, 100, fp) != nullptr) {
-		    // Don't count short lines.
-		    if (strlen(linebuf) <= 4)
-		    	continue;
-		    // Skip solid/endsolid lines as broken STL file generators may put several of them.
-		    if (strncmp(linebuf, "solid", 5) == 0 || strncmp(linebuf, "endsolid", 8) == 0)
-		    	continue;
-		    ++ num_lines;
+	FILE *fp = boost::nowide::fopen(file, "rb");
+	if (fp == nullptr)
+		return false;
+	char   buf[65536];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+		data.insert(data.end(), buf, buf + len);
+	bool ok = ! ferror(fp);
+	fclose(fp);
+	return ok;
+}
+
+static inline bool stl_is_whitespace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Parse a decimal floating point number of an ASCII STL, bypassing the locale handling and the generic code paths of strtof().
+// Up to 15 significant digits and the power of 10 up to 22 are exact in double precision, thus the double result is correctly rounded.
+// Rounding it to float gives the same result as strtof(), unless the double falls exactly halfway between two floats.
+// That case and anything else (long mantissas, large exponents, denormals, inf / nan) is passed to strtof().
+// The whole token [begin, end) has to be consumed.
+static bool stl_parse_float(const char *begin, const char *end, float &out)
+{
+	static constexpr double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	                                    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char *p        = begin;
+	bool        negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p ++ == '-';
+	uint64_t mantissa  = 0;
+	int      digits    = 0;
+	int      sig_digits = 0;
+	int      exponent  = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++ p, ++ digits)
+		if (mantissa != 0 || *p != '0') {
+			mantissa = mantissa * 10 + (*p - '0');
+			++ sig_digits;
+		}
+	if (p < end && *p == '.')
+		for (++ p; p < end && *p >= '0' && *p <= '9'; ++ p, ++ digits, -- exponent)
+			if (mantissa != 0 || *p != '0') {
+				mantissa = mantissa * 10 + (*p - '0');
+				++ sig_digits;
+			}
+	if (digits > 0 && p < end && (*p == 'e' || *p == 'E')) {
+		++ p;
+		bool exp_negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			exp_negative = *p ++ == '-';
+		int exp = 0;
+		int exp_digits = 0;
+		for (; p < end && *p >= '0' && *p <= '9' && exp_digits < 4; ++ p, ++ exp_digits)
+			exp = exp * 10 + (*p - '0');
+		if (exp_digits == 0)
+			digits = 0;
+		exponent += exp_negative ? - exp : exp;
+	}
+	if (p == end && digits > 0 && sig_digits <= 15) {
+		if (mantissa == 0) {
+			out = negative ? -0.f : 0.f;
+			return true;
 		}
+		if (exponent >= -22 && exponent <= 22) {
+			double v = exponent < 0 ? double(mantissa) / pow10[- exponent] : double(mantissa) * pow10[exponent];
+			uint64_t bits;
+			memcpy(&bits, &v, sizeof(v));
+			// The lower 29 bits of a double are rounded off by the conversion to float, 1 followed by zeros is a tie.
+			if (v >= double(FLT_MIN) && v <= double(FLT_MAX) && (bits & ((uint64_t(1) << 29) - 1)) != (uint64_t(1) << 28)) {
+				out = float(negative ? - v : v);
+				return true;
+			}
+		}
+	}
+	// Fall back to strtof(), which needs a zero terminated string.
+	char buf[64];
+	if (end - begin >= ptrdiff_t(sizeof(buf)))
+		return false;
+	memcpy(buf, begin, end - begin);
+	buf[end - begin] = 0;
+	char *endptr = nullptr;
+	out = strtof(buf, &endptr);
+	return endptr == buf + (end - begin) && endptr != buf;
+}
 
-    	rewind(fp);
-    
-    	// Get the header.
-		int i = 0;
-    	for (; i < 80 && (stl->stats.header[i] = getc(fp)) != '\n'; ++ i) ;
-    	stl->stats.header[i] = '\0'; // Lose the '\n'
-    	stl->stats.header[80] = '\0';
+// Parser of the ASCII STL facets working on a memory block, which is not zero terminated.
+class StlAsciiParser
+{
+public:
+	StlAsciiParser(const char *begin, const char *end) : p(begin), end(end) {}
+
+	const char *p;
+	const char *end;
+	// The data ended in the middle of a facet.
+	bool 		truncated = false;
+
+	void skip_whitespaces() { while (p < end && stl_is_whitespace(*p)) ++ p; }
+	void skip_line() { 
+		const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+		p = (eol == nullptr) ? end : eol + 1;
+	}
+	// Does the data at p start with the keyword?
+	bool starts_with(const char *keyword) const {
+		size_t len = strlen(keyword);
+		return size_t(end - p) >= len && memcmp(p, keyword, len) == 0;
+	}
+	// Skip whitespaces and a keyword followed by a whitespace or by the end of the data.
+	bool keyword(const char *keyword) {
+		this->skip_whitespaces();
+		size_t len = strlen(keyword);
+		if (size_t(end - p) < len) {
+			truncated = memcmp(p, keyword, end - p) == 0;
+			return false;
+		}
+		if (memcmp(p, keyword, len) != 0 || (p + len < end && ! stl_is_whitespace(p[len])))
+			return false;
+		p += len;
+		return true;
+	}
+	// Skip whitespaces and a token delimited by whitespaces.
+	bool token(const char *&token_begin, const char *&token_end) {
+		this->skip_whitespaces();
+		if (p == end) {
+			truncated = true;
+			return false;
+		}
+		token_begin = p;
+		while (p < end && ! stl_is_whitespace(*p))
+			++ p;
+		token_end = p;
+		return true;
+	}
+
+	// Parse a single facet, the leading solid / endsolid lines are skipped.
+	bool facet(stl_facet &facet) {
+		const char *token_begin, *token_end;
+		if (! this->keyword("facet") || ! this->keyword("normal"))
+			return false;
+		// Invalid normals are allowed, the normal is just reset then.
+		bool normal_valid = true;
+		for (size_t i = 0; i < 3; ++ i) {
+			if (! this->token(token_begin, token_end))
+				return false;
+			normal_valid &= stl_parse_float(token_begin, token_end, facet.normal(i));
+		}
+		if (! normal_valid)
+			facet.normal = stl_normal::Zero();
+		if (! this->keyword("outer") || ! this->keyword("loop"))
+			return false;
+		for (size_t i = 0; i < 3; ++ i) {
+			if (! this->keyword("vertex"))
+				return false;
+			for (size_t j = 0; j < 3; ++ j)
+				if (! this->token(token_begin, token_end) || ! stl_parse_float(token_begin, token_end, facet.vertex[i](j)))
+					return false;
+		}
+		// Some G-code generators tend to produce text after "endloop" and "endfacet". Just ignore it.
+		if (! this->keyword("endloop"))
+			return false;
+		this->skip_line();
+		if (! this->keyword("endfacet"))
+			return false;
+		this->skip_line();
+		return true;
+	}
 
-    	num_facets = num_lines / ASCII_LINES_PER_FACET;
-  	}
+	// Skip whitespaces and the solid / endsolid lines, as broken STL file generators may put several of them anywhere.
+	void skip_solid() {
+		for (;;) {
+			this->skip_whitespaces();
+			if (! this->starts_with("solid") && ! this->starts_with("endsolid"))
+				break;
+			this->skip_line();
+		}
+	}
+};
 
-  	stl->stats.number_of_facets += num_facets;
-  	stl->stats.original_num_facets = stl->stats.number_of_facets;
-  	return fp;
+// Is there a line starting with the "facet" keyword at p?
+static inline bool stl_ascii_is_facet_line(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++ p;
+	return end - p > 5 && memcmp(p, "facet", 5) == 0 && stl_is_whitespace(p[5]);
 }
 
-/* Reads the contents of the file pointed to by fp into the stl structure,
-   starting at facet first_facet.  The second argument says if it's our first
-   time running this for the stl and therefore we should reset our max and min stats. */
-static bool stl_read(stl_file *stl, FILE *fp, int first_facet, bool first)
+// Find the start of the first line starting with the "facet" keyword, which starts after p.
+static const char* stl_ascii_next_facet_line(const char *p, const char *end)
 {
-	if (stl->stats.type == binary)
-    	fseek(fp, HEADER_SIZE, SEEK_SET);
-  	else
-    	rewind(fp);
-
-  	char normal_buf[3][32];
-  	for (uint32_t i = first_facet; i < stl->stats.number_of_facets; ++ i) {
-  	  	stl_facet facet;
-
-    	if (stl->stats.type == binary) {
-      		// Read a single facet from a binary .STL file. We assume little-endian architecture!
-      		if (fread(&facet, 1, SIZEOF_STL_FACET, fp) != SIZEOF_STL_FACET)
-      			return false;
-#ifndef BOOST_LITTLE_ENDIAN
-      		// Convert the loaded little endian data to big endian.
-      		stl_internal_reverse_quads((char*)&facet, 48);
-#endif /* BOOST_LITTLE_ENDIAN */
-    	} else {
-			// Read a single facet from an ASCII .STL file
-			// skip solid/endsolid
-			// (in this order, otherwise it won't work when they are paired in the middle of a file)
-			fscanf(fp, " endsolid%*[^\n]\n");
-			fscanf(fp, " solid%*[^\n]\n");  // name might contain spaces so %*s doesn't work and it also can be empty (just "solid")
-			// Leading space in the fscanf format skips all leading white spaces including numerous new lines and tabs.
-			int res_normal     = fscanf(fp, " facet normal %31s %31s %31s", normal_buf[0], normal_buf[1], normal_buf[2]);
-			assert(res_normal == 3);
-			int res_outer_loop = fscanf(fp, " outer loop");
-			assert(res_outer_loop == 0);
-			int res_vertex1    = fscanf(fp, " vertex %f %f %f", &facet.vertex[0](0), &facet.vertex[0](1), &facet.vertex[0](2));
-			assert(res_vertex1 == 3);
-			int res_vertex2    = fscanf(fp, " vertex %f %f %f", &facet.vertex[1](0), &facet.vertex[1](1), &facet.vertex[1](2));
-			assert(res_vertex2 == 3);
-			// Trailing whitespace is there to eat all whitespaces and empty lines up to the next non-whitespace.
-			int res_vertex3    = fscanf(fp, " vertex %f %f %f ", &facet.vertex[2](0), &facet.vertex[2](1), &facet.vertex[2](2));
-			assert(res_vertex3 == 3);
-			// Some G-code generators tend to produce text after "endloop" and "endfacet". Just ignore it.
-			char buf[2048];
-			fgets(buf, 2047, fp);
-			bool endloop_ok = strncmp(buf, "endloop", 7) == 0 && (buf[7] == '\r' || buf[7] == '\n' || buf[7] == ' ' || buf[7] == '\t');
-			assert(endloop_ok);
-			// Skip the trailing whitespaces and empty lines.
-			fscanf(fp, " ");
-			fgets(buf, 2047, fp);
-			bool endfacet_ok = strncmp(buf, "endfacet", 8) == 0 && (buf[8] == '\r' || buf[8] == '\n' || buf[8] == ' ' || buf[8] == '\t');
-			assert(endfacet_ok);
-			if (res_normal != 3 || res_outer_loop != 0 || res_vertex1 != 3 || res_vertex2 != 3 || res_vertex3 != 3 || ! endloop_ok || ! endfacet_ok) {
-				BOOST_LOG_TRIVIAL(error) << "Something is syntactically very wrong with this ASCII STL! ";
-				return false;
+	for (;;) {
+		p = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (p == nullptr)
+			return end;
+		if (stl_ascii_is_facet_line(++ p, end))
+			return p;
+	}
+}
+
+static bool stl_read_ascii(stl_file *stl, const char *data, size_t size)
+{
+	const char *end = data + size;
+
+	// Get the header.
+	{
+		size_t i = 0;
+		for (; i < 80 && i < size && data[i] != '\n'; ++ i)
+			stl->stats.header[i] = data[i];
+		if (i > 0 && stl->stats.header[i - 1] == '\r')
+			-- i;
+		stl->stats.header[i] = '\0';
+	}
+
+	// Split the file into chunks at the starts of the facets to be parsed in parallel.
+	static constexpr const size_t chunk_size = 1024 * 1024;
+	std::vector<const char*> chunks { data };
+	for (const char *p = data + chunk_size; p < end; p = chunks.back() + chunk_size) {
+		p = stl_ascii_next_facet_line(p, end);
+		if (p == end)
+			break;
+		chunks.emplace_back(p);
+	}
+	chunks.emplace_back(end);
+
+	// Count the facets, so that they are parsed directly into the stl_file.
+	// A line starting with the "facet" keyword starts a facet.
+	std::vector<size_t> facets_start(chunks.size(), 0);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size() - 1), [&chunks, &facets_start, end](const tbb::blocked_range<size_t> &range) {
+		for (size_t ichunk = range.begin(); ichunk < range.end(); ++ ichunk) {
+			size_t num_facets = 0;
+			for (const char *p = chunks[ichunk]; p < chunks[ichunk + 1];) {
+				num_facets += stl_ascii_is_facet_line(p, end);
+				const char *eol = static_cast<const char*>(memchr(p, '\n', chunks[ichunk + 1] - p));
+				p = (eol == nullptr) ? end : eol + 1;
 			}
+			facets_start[ichunk + 1] = num_facets;
+		}
+	});
+	for (size_t i = 1; i < facets_start.size(); ++ i)
+		facets_start[i] += facets_start[i - 1];
+	stl->stats.number_of_facets = uint32_t(facets_start.back());
+	stl_allocate(stl);
 
-			// The facet normal has been parsed as a single string as to workaround for not a numbers in the normal definition.
-			if (sscanf(normal_buf[0], "%f", &facet.normal(0)) != 1 ||
-			    sscanf(normal_buf[1], "%f", &facet.normal(1)) != 1 ||
-			    sscanf(normal_buf[2], "%f", &facet.normal(2)) != 1) {
-			    // Normal was mangled. Maybe denormals or "not a number" were stored?
-			  	// Just reset the normal and silently ignore it.
-			  	memset(&facet.normal, 0, sizeof(facet.normal));
+	// Parse the facets of each chunk. The last facet of a chunk may extend over the end of the chunk.
+	enum ChunkStatus : char { Ok, Truncated, Error };
+	std::vector<ChunkStatus> status(chunks.size() - 1, Ok);
+	std::vector<size_t>      num_parsed(chunks.size() - 1, 0);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size() - 1), [stl, &chunks, &facets_start, &status, &num_parsed, end](const tbb::blocked_range<size_t> &range) {
+		for (size_t ichunk = range.begin(); ichunk < range.end(); ++ ichunk) {
+			StlAsciiParser parser(chunks[ichunk], end);
+			size_t 		   ifacet = facets_start[ichunk];
+			for (;;) {
+				parser.skip_solid();
+				if (parser.p >= chunks[ichunk + 1])
+					break;
+				if (ifacet == facets_start[ichunk + 1] || ! parser.facet(stl->facet_start[ifacet])) {
+					status[ichunk] = parser.truncated ? Truncated : Error;
+					break;
+				}
+				++ ifacet;
 			}
+			num_parsed[ichunk] = ifacet - facets_start[ichunk];
+			if (status[ichunk] == Ok && ifacet != facets_start[ichunk + 1])
+				status[ichunk] = Error;
 		}
+	});
 
-#if 0
-		// Report close to zero vertex coordinates. Due to the nature of the floating point numbers,
-		// close to zero values may be represented with singificantly higher precision than the rest of the vertices.
-		// It may be worth to round these numbers to zero during loading to reduce the number of errors reported
-		// during the STL import.
-		for (size_t j = 0; j < 3; ++ j) {
-		if (facet.vertex[j](0) > -1e-12f && facet.vertex[j](0) < 1e-12f)
-		    printf("stl_read: facet %d(0) = %e\r\n", j, facet.vertex[j](0));
-		if (facet.vertex[j](1) > -1e-12f && facet.vertex[j](1) < 1e-12f)
-		    printf("stl_read: facet %d(1) = %e\r\n", j, facet.vertex[j](1));
-		if (facet.vertex[j](2) > -1e-12f && facet.vertex[j](2) < 1e-12f)
-		    printf("stl_read: facet %d(2) = %e\r\n", j, facet.vertex[j](2));
+	for (size_t ichunk = 0; ichunk < status.size(); ++ ichunk)
+		if (status[ichunk] == Error || (status[ichunk] == Truncated && ichunk + 1 < status.size())) {
+			BOOST_LOG_TRIVIAL(error) << "Something is syntactically very wrong with this ASCII STL! ";
+			return false;
 		}
-#endif
+	if (status.back() == Truncated) {
+		// The last facet is incomplete, ignore it.
+		BOOST_LOG_TRIVIAL(info) << "stl_read_ascii: Warning: The ASCII STL file is truncated, ignoring the incomplete last facet.";
+		stl->stats.number_of_facets = uint32_t(facets_start[status.size() - 1] + num_parsed.back());
+		stl_reallocate(stl);
+	}
+	return true;
+}
 
-		// Write the facet into memory.
-		stl->facet_start[i] = facet;
-		stl_facet_stats(stl, facet, first);
-  	}
-  
-  	stl->stats.size = stl->stats.max - stl->stats.min;
-  	stl->stats.bounding_diameter = stl->stats.size.norm();
-  	return true;
+static bool stl_read_binary(stl_file *stl, const char *data, size_t size)
+{
+	// Test if the STL file has the right size.
+	if (((size - HEADER_SIZE) % SIZEOF_STL_FACET != 0) || (size < STL_MIN_FILE_SIZE)) {
+		BOOST_LOG_TRIVIAL(error) << "stl_read_binary: The file has the wrong size.";
+		return false;
+	}
+	stl->stats.number_of_facets = uint32_t((size - HEADER_SIZE) / SIZEOF_STL_FACET);
+
+	// Get the header.
+	memcpy(stl->stats.header, data, LABEL_SIZE);
+	stl->stats.header[80] = '\0';
+
+	// Read the int following the header.  This should contain # of facets.
+	uint32_t header_num_facets;
+	memcpy(&header_num_facets, data + LABEL_SIZE, sizeof(uint32_t));
+#ifndef BOOST_LITTLE_ENDIAN
+	// Convert from little endian to big endian.
+	stl_internal_reverse_quads((char*)&header_num_facets, 4);
+#endif /* BOOST_LITTLE_ENDIAN */
+	if (stl->stats.number_of_facets != header_num_facets)
+		BOOST_LOG_TRIVIAL(info) << "stl_read_binary: Warning: File size doesn't match number of facets in the header";
+
+	stl_allocate(stl);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, stl->stats.number_of_facets), [stl, data](const tbb::blocked_range<size_t> &range) {
+		const char *src = data + HEADER_SIZE + range.begin() * SIZEOF_STL_FACET;
+		for (size_t i = range.begin(); i < range.end(); ++ i, src += SIZEOF_STL_FACET) {
+			// The facets are packed in the file, they are not aligned.
+			memcpy(static_cast<void*>(&stl->facet_start[i]), src, SIZEOF_STL_FACET);
+#ifndef BOOST_LITTLE_ENDIAN
+			// Convert the loaded little endian data to big endian.
+			stl_internal_reverse_quads((char*)&stl->facet_start[i], 48);
+#endif /* BOOST_LITTLE_ENDIAN */
+		}
+	});
+	return true;
 }
 
 bool stl_open(stl_file *stl, const char *file)
 {
 	stl->clear();
-	FILE *fp = stl_open_count_facets(stl, file);
-	if (fp == nullptr)
+
+	// Map the file into memory and parse it in place. The mapping may fail, for example for a path
+	// not representable in the local code page on Windows, or for an empty file, then read the file into memory.
+	std::unique_ptr<boost::interprocess::mapped_region> region;
+	std::vector<char>                                   buffer;
+	try {
+		boost::interprocess::file_mapping mapping(file, boost::interprocess::read_only);
+		region = std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_only);
+	} catch (const boost::interprocess::interprocess_exception &) {
+		if (! stl_read_file(file, buffer)) {
+			BOOST_LOG_TRIVIAL(error) << "stl_open: Couldn't open " << file << " for reading";
+			return false;
+		}
+	}
+	const char *data = region ? static_cast<const char*>(region->get_address()) : buffer.data();
+	size_t      size = region ? region->get_size() : buffer.size();
+
+	// Check for binary or ASCII file.
+	if (size < HEADER_SIZE + 128) {
+		BOOST_LOG_TRIVIAL(error) << "stl_open: The input is an empty file: " << file;
 		return false;
-	stl_allocate(stl);
-	bool result = stl_read(stl, fp, 0, true);
-  	fclose(fp);
-  	return result;
+	}
+	stl->stats.type = ascii;
+	for (size_t s = HEADER_SIZE; s < HEADER_SIZE + 128; ++ s)
+		if ((unsigned char)data[s] > 127) {
+			stl->stats.type = binary;
+			break;
+		}
+
+	if (! (stl->stats.type == binary ? stl_read_binary(stl, data, size) : stl_read_ascii(stl, data, size))) {
+		BOOST_LOG_TRIVIAL(error) << "stl_open: Failed to read " << file;
+		stl->clear();
+		return false;
+	}
+	stl->stats.original_num_facets = stl->stats.number_of_facets;
+
+	bool first = true;
+	for (const stl_facet &facet : stl->facet_start)
+		stl_facet_stats(stl, facet, first);
+	stl->stats.size = stl->stats.max - stl->stats.min;
+	stl->stats.bounding_diameter = stl->stats.size.norm();
+	return true;
 }
 
 void stl_allocate(stl_file *stl) 
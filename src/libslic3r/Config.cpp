@@ -447,6 +447,8 @@ void ConfigBase::apply_only(const ConfigBase &other, const t_config_option_keys
 t_config_option_keys ConfigBase::diff(const ConfigBase &other) const
 {
     t_config_option_keys diff;
+    if (this->diff_same_type(other, diff))
+        return diff;
     for (const t_config_option_key &opt_key : this->keys()) {
         const ConfigOption *this_opt  = this->option(opt_key);
         const ConfigOption *other_opt = other.option(opt_key);
@@ -814,6 +816,31 @@ bool DynamicConfig::operator==(const DynamicConfig &rhs) const
     return it1 == it1_end && it2 == it2_end;
 }
 
+bool DynamicConfig::diff_same_type(const ConfigBase &other, t_config_option_keys &diff) const
+{
+    const DynamicConfig *rhs = dynamic_cast<const DynamicConfig*>(&other);
+    if (rhs == nullptr || this->parent != nullptr || rhs->parent != nullptr)
+        // The options missing in a config with a parent are resolved by the parent.
+        return false;
+    auto it1     = this->options.begin();
+    auto it1_end = this->options.end();
+    auto it2     = rhs->options.begin();
+    auto it2_end = rhs->options.end();
+    while (it1 != it1_end && it2 != it2_end) {
+        if (it1->first < it2->first)
+            ++ it1;
+        else if (it2->first < it1->first)
+            ++ it2;
+        else {
+            if (*it1->second != *it2->second)
+                diff.emplace_back(it1->first);
+            ++ it1;
+            ++ it2;
+        }
+    }
+    return true;
+}
+
 // Remove options with all nil values, those are optional and it does not help to hold them.
 size_t DynamicConfig::remove_nil_options()
 {
@@ -1640,6 +1640,10 @@ public:
     virtual t_config_option_keys    keys() const = 0;
 
 protected:
+    // Fast path of diff(): collect the keys of the differing options of two configs of the same storage type
+    // by walking their options directly, without looking up the options by their names.
+    // Returns false if other is not of a compatible type, then diff() falls back to the lookups by name.
+    virtual bool                    diff_same_type(const ConfigBase &/*other*/, t_config_option_keys &/*diff*/) const { return false; }
     // Verify whether the opt_key has not been obsoleted or renamed.
     // Both opt_key and value may be modified by handle_legacy().
     // If the opt_key is no more valid in this version of Slic3r, opt_key is cleared by handle_legacy().
@@ -1856,6 +1860,12 @@ public:
     t_config_option_keys    keys() const override;
     bool                    empty() const { return options.empty(); }
 
+protected:
+    // Overrides ConfigBase::diff_same_type(). Both option maps are sorted by the key, they are merged in a single pass.
+    bool                    diff_same_type(const ConfigBase &other, t_config_option_keys &diff) const override;
+
+public:
+
     // Set a value for an opt_key. Returns true if the value did not exist yet.
     // This DynamicConfig will take ownership of opt.
     // Be careful, as this method does not test the existence of opt_key in this->def().
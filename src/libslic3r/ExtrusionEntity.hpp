@@ -2,6 +2,7 @@
 #define slic3r_ExtrusionEntity_hpp_
 
 #include "libslic3r.h"
+#include "ExtrusionEntityArena.hpp"
 #include "Polygon.hpp"
 #include "Polyline.hpp"
 
@@ -141,6 +142,9 @@ public:
     // Create a new object, initialize it with this object using the move semantics.
     virtual ExtrusionEntity* clone_move() = 0;
     virtual ~ExtrusionEntity() {}
+    // Allocated from the ExtrusionEntityArena of the current thread's ExtrusionEntityArena::Scope, or from the heap.
+    static void* operator new(size_t size) { return ExtrusionEntityArena::allocate(size); }
+    static void  operator delete(void *ptr) { ExtrusionEntityArena::deallocate(ptr); }
     virtual void reverse() = 0;
     virtual const Point& first_point() const = 0;
     virtual const Point& last_point() const = 0;
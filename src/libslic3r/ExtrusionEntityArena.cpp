@@ -0,0 +1,114 @@
+#include "ExtrusionEntityArena.hpp"
+
+#include <cassert>
+#include <new>
+
+namespace Slic3r {
+
+namespace {
+    // Stored in front of each allocated block, its size keeps the payload aligned the same way as ::operator new() does.
+    struct alignas(16) BlockHeader
+    {
+        // Arena the block was allocated from, nullptr if allocated on the heap.
+        ExtrusionEntityArena *arena;
+        size_t                size_class;
+    };
+
+    // Arena of the innermost ExtrusionEntityArena::Scope active on this thread.
+    thread_local ExtrusionEntityArena *s_current_arena = nullptr;
+}
+
+ExtrusionEntityArena::~ExtrusionEntityArena()
+{
+    assert(m_blocks_alive == 0);
+    for (char *chunk : m_chunks)
+        ::operator delete(chunk);
+}
+
+void ExtrusionEntityArena::release()
+{
+    bool last;
+    {
+        tbb::spin_mutex::scoped_lock lock(m_mutex);
+        m_released = true;
+        last = m_blocks_alive == 0;
+    }
+    if (last)
+        delete this;
+}
+
+void* ExtrusionEntityArena::allocate(size_t size)
+{
+    static_assert(sizeof(BlockHeader) % block_granularity == 0, "BlockHeader breaks the alignment of the blocks");
+    size_t                total = size + sizeof(BlockHeader);
+    ExtrusionEntityArena *arena = s_current_arena;
+    BlockHeader          *header;
+    if (arena != nullptr && total <= max_block_size) {
+        size_t size_class = (total + block_granularity - 1) / block_granularity - 1;
+        header = static_cast<BlockHeader*>(arena->allocate_block(size_class));
+        header->arena      = arena;
+        header->size_class = size_class;
+    } else {
+        header = static_cast<BlockHeader*>(::operator new(total));
+        header->arena      = nullptr;
+        header->size_class = 0;
+    }
+    return header + 1;
+}
+
+void ExtrusionEntityArena::deallocate(void *ptr)
+{
+    if (ptr == nullptr)
+        return;
+    BlockHeader          *header = static_cast<BlockHeader*>(ptr) - 1;
+    ExtrusionEntityArena *arena  = header->arena;
+    if (arena == nullptr)
+        ::operator delete(header);
+    else if (arena->deallocate_block(header, header->size_class))
+        delete arena;
+}
+
+void* ExtrusionEntityArena::allocate_block(size_t size_class)
+{
+    assert(size_class < max_block_size / block_granularity);
+    tbb::spin_mutex::scoped_lock lock(m_mutex);
+    void *block = m_free_blocks[size_class];
+    if (block != nullptr) {
+        // Reuse a deleted block.
+        m_free_blocks[size_class] = *static_cast<void**>(block);
+    } else {
+        size_t size = (size_class + 1) * block_granularity;
+        if (size_t(m_chunk_end - m_chunk_top) < size) {
+            // The rest of the current chunk is abandoned, it is smaller than max_block_size.
+            m_chunks.reserve(m_chunks.size() + 1);
+            m_chunks.emplace_back(static_cast<char*>(::operator new(chunk_size)));
+            m_chunk_top = m_chunks.back();
+            m_chunk_end = m_chunk_top + chunk_size;
+        }
+        block = m_chunk_top;
+        m_chunk_top += size;
+    }
+    ++ m_blocks_alive;
+    return block;
+}
+
+bool ExtrusionEntityArena::deallocate_block(void *block, size_t size_class)
+{
+    tbb::spin_mutex::scoped_lock lock(m_mutex);
+    *static_cast<void**>(block) = m_free_blocks[size_class];
+    m_free_blocks[size_class] = block;
+    assert(m_blocks_alive > 0);
+    return -- m_blocks_alive == 0 && m_released;
+}
+
+ExtrusionEntityArena::Scope::Scope(ExtrusionEntityArena *arena) : m_previous(s_current_arena)
+{
+    s_current_arena = arena;
+}
+
+ExtrusionEntityArena::Scope::~Scope()
+{
+    s_current_arena = m_previous;
+}
+
+} // namespace Slic3r
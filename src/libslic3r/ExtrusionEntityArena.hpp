@@ -0,0 +1,77 @@
+#ifndef slic3r_ExtrusionEntityArena_hpp_
+#define slic3r_ExtrusionEntityArena_hpp_
+
+#include "libslic3r.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <tbb/spin_mutex.h>
+
+namespace Slic3r {
+
+// Memory pool for the ExtrusionEntities of a single Layer.
+//
+// The perimeter and infill generators allocate tens of millions of small ExtrusionPaths / Loops / MultiPaths
+// and ExtrusionEntityCollections for a large print, each separately on the heap, and all of them are released again
+// on a re-slice. While an ExtrusionEntityArena::Scope is active on a thread, ExtrusionEntity::operator new takes
+// the memory from the arena of that scope: small blocks are carved out of large chunks and deleted blocks are recycled.
+// Outside of a scope the ExtrusionEntities are allocated on the heap as usual.
+//
+// The arena is reference counted by the blocks allocated from it, so an ExtrusionEntity may safely outlive its Layer,
+// for example if it was created by a task stolen by a thread working inside a scope. The chunks are freed at once
+// after the owner called release() and the last block was deleted.
+class ExtrusionEntityArena
+{
+public:
+    ExtrusionEntityArena() = default;
+    ExtrusionEntityArena(const ExtrusionEntityArena &) = delete;
+    ExtrusionEntityArena& operator=(const ExtrusionEntityArena &) = delete;
+
+    // Called by the owner instead of delete, the arena deletes itself once no block allocated from it is alive.
+    void            release();
+
+    // Allocate from the arena of the current thread's Scope, or from the heap if there is no active Scope.
+    static void*    allocate(size_t size);
+    // Return a block allocated by allocate() to its arena or to the heap.
+    static void     deallocate(void *ptr);
+
+    // Make the ExtrusionEntities allocated on this thread use the arena until the Scope is destroyed.
+    class Scope {
+    public:
+        explicit Scope(ExtrusionEntityArena *arena);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope& operator=(const Scope &) = delete;
+    private:
+        ExtrusionEntityArena *m_previous;
+    };
+
+    // Number of blocks allocated from this arena and not yet deleted.
+    size_t          blocks_alive() const { return m_blocks_alive; }
+
+private:
+    ~ExtrusionEntityArena();
+
+    // Blocks are rounded up to multiples of block_granularity, larger blocks than max_block_size are allocated on the heap.
+    static constexpr size_t block_granularity = 16;
+    static constexpr size_t max_block_size    = 512;
+    static constexpr size_t chunk_size        = 64 * 1024;
+
+    void*           allocate_block(size_t size_class);
+    // Returns true if the arena shall be deleted.
+    bool            deallocate_block(void *block, size_t size_class);
+
+    tbb::spin_mutex     m_mutex;
+    std::vector<char*>  m_chunks;
+    char               *m_chunk_top  = nullptr;
+    char               *m_chunk_end  = nullptr;
+    // Heads of the intrusive lists of deleted blocks, one per size class.
+    void               *m_free_blocks[max_block_size / block_granularity] = { nullptr };
+    size_t              m_blocks_alive = 0;
+    bool                m_released     = false;
+};
+
+} // namespace Slic3r
+
+#endif /* slic3r_ExtrusionEntityArena_hpp_ */
@@ -58,10 +58,8 @@ ExtrusionEntityCollection::operator ExtrusionPaths() const
 
 ExtrusionEntityCollection* ExtrusionEntityCollection::clone() const
 {
-    ExtrusionEntityCollection* coll = new ExtrusionEntityCollection(*this);
-    for (size_t i = 0; i < coll->entities.size(); ++i)
-        coll->entities[i] = this->entities[i]->clone();
-    return coll;
+    // The copy constructor clones the entities.
+    return new ExtrusionEntityCollection(*this);
 }
 
 void ExtrusionEntityCollection::reverse()
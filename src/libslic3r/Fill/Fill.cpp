@@ -2,6 +2,9 @@
 #include <stdio.h>
 #include <memory>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 #include "../ClipperUtils.hpp"
 #include "../Geometry.hpp"
 #include "../Layer.hpp"
@@ -203,9 +206,9 @@ void make_fill(LayerRegion &layerm, ExtrusionEntityCollection &out)
 //            red_expolygons  => [ map $_->expolygon, grep  $_->is_solid, @surfaces ],
 //        );
     }
-    for (const Surface &surface : surfaces) {
+    auto fill_surface = [&](const Surface &surface, ExtrusionEntitiesPtr &out_entities) {
         if (surface.surface_type == (stPosInternal | stDensVoid))
-            continue;
+            return;
         InfillPattern  fill_pattern = layerm.region()->config().fill_pattern.value;
         double         density      = fill_density;
         FlowRole role = (surface.has_pos_top()) ? frTopSolidInfill :
@@ -232,7 +235,7 @@ void make_fill(LayerRegion &layerm, ExtrusionEntityCollection &out)
                 fill_pattern = ipRectiWithPerimeter;
             }
             if (density <= 0)
-                continue;
+                return;
         }
 
         //Set Params for fill
@@ -337,8 +340,25 @@ void make_fill(LayerRegion &layerm, ExtrusionEntityCollection &out)
             params.density *= layerm.region()->config().bridge_overlap.get_abs_value(1);
         }
 
-        f->fill_surface_extrusion(&surface, params, out.entities);
-    }
+        f->fill_surface_extrusion(&surface, params, out_entities);
+    };
+
+    if (surfaces.size() > 1 && layerm.layer()->process_islands_in_parallel()) {
+        // Fill the surfaces in parallel, then collect the fills in the order of the surfaces,
+        // so that the result does not depend on the scheduling.
+        std::vector<ExtrusionEntitiesPtr> surface_fills(surfaces.size());
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, surfaces.size()),
+            [&layerm, &surfaces, &surface_fills, &fill_surface](const tbb::blocked_range<size_t> &range) {
+                ExtrusionEntityArena::Scope arena_scope(layerm.layer()->extrusion_arena());
+                for (size_t surface_idx = range.begin(); surface_idx < range.end(); ++ surface_idx)
+                    fill_surface(surfaces[surface_idx], surface_fills[surface_idx]);
+            });
+        for (ExtrusionEntitiesPtr &fills : surface_fills)
+            append(out.entities, std::move(fills));
+    } else
+        for (const Surface &surface : surfaces)
+            fill_surface(surface, out.entities);
 
     // add thin fill regions
     // thin_fills are of C++ Slic3r::ExtrusionEntityCollection, perl type Slic3r::ExtrusionPath::Collection
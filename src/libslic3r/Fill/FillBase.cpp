@@ -3,6 +3,7 @@
 #include "../ClipperUtils.hpp"
 #include "../EdgeGrid.hpp"
 #include "../Geometry.hpp"
+#include "../KDTreeIndirect.hpp"
 #include "../Surface.hpp"
 #include "../PrintConfig.hpp"
 #include "../ExtrusionEntityCollection.hpp"
@@ -255,36 +256,153 @@ void cut_polygon(Polyline &poly, size_t idx_1, Point p1, Point p2) {
     poly.points.insert(poly.points.begin(), p2);
 }
 
+/// Points of the polylines which shall not be crossed by the connections, see collision().
+struct BlockerPointAccessor {
+    const Point* operator()(const Point &pt) const { return &pt; }
+};
+typedef ClosestPointInRadiusLookup<Point, BlockerPointAccessor> BlockerPointLookup;
+
 /// check if the polyline from pts_to_check may be at 'width' distance of a point in polylines_blocker
 /// it use equally_spaced_points with width/2 precision, so don't worry with pts_to_check number of points.
 /// it use the given polylines_blocker points, be sure to put enough of them to be reliable.
-/// complexity : N(pts_to_check.equally_spaced_points(width / 2)) x N(polylines_blocker.points)
-bool collision(const Points &pts_to_check, const Polylines &polylines_blocker, const coord_t width) {
+/// the search radius of polylines_blocker has to be at least width.
+/// complexity : N(pts_to_check.equally_spaced_points(width / 2)) x N(polylines_blocker.points near a point)
+bool collision(const Points &pts_to_check, BlockerPointLookup &polylines_blocker, const coord_t width) {
     //check if it's not too close to a polyline
     //convert to double to allow ² operation 
     double min_dist_square = (double)width * (double)width * 0.9 - SCALED_EPSILON;
     Polyline better_polylines(pts_to_check);
     Points better_pts = better_polylines.equally_spaced_points(width / 2);
     for (const Point &p : better_pts) {
-        for (const Polyline &poly2 : polylines_blocker) {
-            for (const Point &p2 : poly2.points) {
-                if (p.distance_to_square(p2) < min_dist_square) {
-                    return true;
-                }
-            }
+        // The closest blocker point inside the search radius is closer than min_dist_square if any is.
+        std::pair<const Point*, double> closest = polylines_blocker.find(p);
+        if (closest.first != nullptr && closest.second < min_dist_square) {
+            return true;
         }
     }
     return false;
 }
 
+/// Spatial index of the frontier polylines of Fill::connect_infill(), to test only the polylines getFrontier() may walk along.
+/// getFrontier() only removes points from a frontier polyline or cuts it in two pieces lying on its segments,
+/// thus the cells of a frontier polyline stay valid for the pieces cut from it. The cells hold labels of the polylines:
+/// when a polyline is cut, the longer piece keeps the label and only the shorter piece is rasterized with a new label,
+/// so that each segment is rasterized O(log(N)) times.
+class FrontierLookup {
+public:
+    FrontierLookup(const ExPolygon &boundary, coord_t resolution) {
+        // The points inserted by the cuts lie within SCALED_EPSILON of the boundary.
+        BoundingBox bbox = get_extents(boundary.contour);
+        bbox.offset(10 * SCALED_EPSILON);
+        m_grid.set_bbox(bbox);
+        m_grid.create(boundary, resolution);
+        m_cell_labels.assign(m_grid.rows() * m_grid.cols(), std::vector<size_t>());
+        // The boundary contours rasterized by m_grid are labeled by their index. m_grid skips the empty contours,
+        // thus the frontier polylines have to be created from m_grid.contours(), see frontier_polylines().
+        for (size_t i = 0; i < m_grid.contours().size(); ++ i) {
+            m_label_polyline.emplace_back(i);
+            m_polyline_label.emplace_back(i);
+        }
+    }
+
+    /// The initial frontier polylines: the non-empty boundary contours closed into polylines, indexed the same as by this lookup.
+    Polylines frontier_polylines() const {
+        Polylines out;
+        out.reserve(m_grid.contours().size());
+        for (const Points *contour : m_grid.contours()) {
+            out.emplace_back();
+            out.back().points.reserve(contour->size() + 1);
+            out.back().points = *contour;
+            out.back().points.emplace_back(contour->front());
+        }
+        return out;
+    }
+
+    /// Indices of the frontier polylines, which may have a segment closer than SCALED_EPSILON to pt, in ascending order.
+    void find(const Point &pt, std::vector<size_t> &out) const {
+        out.clear();
+        // The points inserted by the cuts lie within SCALED_EPSILON of the segments they split, leave some margin for them.
+        const coord_t margin = 10 * SCALED_EPSILON;
+        BoundingBox bbox(pt - Point(margin, margin), pt + Point(margin, margin));
+        auto visitor = [this, &out](coord_t row, coord_t col) {
+            auto range = m_grid.cell_data_range(row, col);
+            for (auto it = range.first; it != range.second; ++ it)
+                out.emplace_back(m_label_polyline[it->first]);
+            for (size_t label : m_cell_labels[row * m_grid.cols() + col])
+                out.emplace_back(m_label_polyline[label]);
+            return true;
+        };
+        m_grid.visit_cells_intersecting_box(bbox, visitor);
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    /// The frontier polyline idx_new was cut from the frontier polyline idx_polyline.
+    void split(const Polylines &polylines, size_t idx_polyline, size_t idx_new) {
+        assert(idx_new == m_polyline_label.size());
+        size_t label = m_polyline_label[idx_polyline];
+        size_t label_new = m_label_polyline.size();
+        size_t idx_shorter = idx_new;
+        if (shorter_first(polylines[idx_polyline], polylines[idx_new])) {
+            // The new polyline takes over the label.
+            m_label_polyline[label] = idx_new;
+            m_polyline_label[idx_polyline] = label_new;
+            m_polyline_label.emplace_back(label);
+            idx_shorter = idx_polyline;
+        } else
+            m_polyline_label.emplace_back(label_new);
+        m_label_polyline.emplace_back(idx_shorter);
+        // Rasterize the shorter polyline with its new label.
+        const Points &pts = polylines[idx_shorter].points;
+        auto visitor = [this, label_new](coord_t row, coord_t col) {
+            std::vector<size_t> &labels = m_cell_labels[row * m_grid.cols() + col];
+            if (labels.empty() || labels.back() != label_new)
+                labels.emplace_back(label_new);
+            return true;
+        };
+        for (size_t i = 1; i < pts.size(); ++ i)
+            m_grid.visit_cells_intersecting_line(pts[i - 1], pts[i], visitor);
+    }
+
+private:
+    /// Does pl1 cross less cells than pl2? Walks both polylines at once, so the cost is proportional to the shorter one.
+    bool shorter_first(const Polyline &pl1, const Polyline &pl2) const {
+        auto segment_cells = [this](const Points &pts, size_t i) {
+            return 1 + (std::abs(pts[i].x() - pts[i - 1].x()) + std::abs(pts[i].y() - pts[i - 1].y())) / m_grid.resolution();
+        };
+        coord_t cells1 = 0;
+        coord_t cells2 = 0;
+        for (size_t i1 = 1, i2 = 1;;) {
+            if (cells1 <= cells2) {
+                if (i1 >= pl1.points.size())
+                    return true;
+                cells1 += segment_cells(pl1.points, i1 ++);
+            } else {
+                if (i2 >= pl2.points.size())
+                    return false;
+                cells2 += segment_cells(pl2.points, i2 ++);
+            }
+        }
+    }
+
+    EdgeGrid::Grid                      m_grid;
+    // Labels of the polylines rasterized after the boundary contours.
+    std::vector<std::vector<size_t>>    m_cell_labels;
+    std::vector<size_t>                 m_label_polyline;
+    std::vector<size_t>                 m_polyline_label;
+};
+
 /// Try to find a path inside polylines that allow to go from p1 to p2.
 /// width if the width of the extrusion
 /// polylines_blockers are the array of polylines to check if the path isn't blocked by something.
-/// complexity: N(polylines.points) + a collision check after that if we finded a path: N(2(p2-p1)/width) x N(polylines_blocker.points)
+/// polylines_lookup indexes the polylines, it's updated when a polyline is split.
+/// complexity: N(polylines.points near p1) + a collision check after that if we finded a path: N(2(p2-p1)/width) x N(polylines_blocker.points near a point)
 /// @param width is scaled
 /// @param max_size is scaled
-Points getFrontier(Polylines &polylines, const Point& p1, const Point& p2, const coord_t width, const Polylines &polylines_blockers, coord_t max_size = -1) {
-    for (size_t idx_poly = 0; idx_poly < polylines.size(); ++idx_poly) {
+Points getFrontier(Polylines &polylines, FrontierLookup &polylines_lookup, const Point& p1, const Point& p2, const coord_t width, BlockerPointLookup &polylines_blockers, coord_t max_size = -1) {
+    std::vector<size_t> candidates;
+    polylines_lookup.find(p1, candidates);
+    for (size_t idx_poly : candidates) {
         Polyline &poly = polylines[idx_poly];
         if (poly.size() <= 1) continue;
 
@@ -418,7 +536,10 @@ Points getFrontier(Polylines &polylines, const Point& p1, const Point& p2, const
             //edge case: on the same line
             if (idx_1 == idx_2) {
                 if (collision(Points() = { p1, p2 }, polylines_blockers, width)) return Points();
+                size_t num_polylines = polylines.size();
                 cut_polyline(poly, polylines, idx_1, p1, p2);
+                if (polylines.size() > num_polylines)
+                    polylines_lookup.split(polylines, idx_poly, num_polylines);
                 return Points() = { Line(p1, p2).midpoint() };
             }
 
@@ -442,7 +563,10 @@ Points getFrontier(Polylines &polylines, const Point& p1, const Point& p2, const
             if (collision(p_ret, polylines_blockers, width)) return Points();
             //cut polyline
             poly.points.erase(poly.points.begin() + first_idx + 1, poly.points.begin() + last_idx);
+            size_t num_polylines = polylines.size();
             cut_polyline(poly, polylines, first_idx, p1, p2);
+            if (polylines.size() > num_polylines)
+                polylines_lookup.split(polylines, idx_poly, num_polylines);
             //order the returned array to be p1->p2
             if (idx_1 > idx_2) {
                 std::reverse(p_ret.begin(), p_ret.end());
@@ -459,21 +583,25 @@ Points getFrontier(Polylines &polylines, const Point& p1, const Point& p2, const
 /// It uses only the boundary polygons to do so, and can't pass two times at the same place.
 /// It avoid passing over the infill_ordered's polylines (preventing local over-extrusion).
 /// return the connected polylines in polylines_out. Can output polygons (stored as polylines with first_point = last_point).
-/// complexity: worst: N(infill_ordered.points) x N(boundary.points)
-///             typical: N(infill_ordered) x ( N(boundary.points) + N(infill_ordered.points) )
+/// The boundary segments and the infill points are indexed by grids and the polyline ends by a KD tree,
+/// so each connection only looks at its neighborhood.
+/// complexity: typical: N(infill_ordered) x log(N(infill_ordered))
 void
 Fill::connect_infill(const Polylines &infill_ordered, const ExPolygon &boundary, Polylines &polylines_out, const FillParams &params) const {
 
-    //TODO: fallback to the quick & dirty old algorithm when n(points) is too high.
-    Polylines polylines_frontier = to_polylines(((Polygons)boundary));
+    const coord_t width = scale_(this->spacing);
+    FrontierLookup frontier_lookup(boundary, 10 * width);
+    Polylines polylines_frontier = frontier_lookup.frontier_polylines();
 
-    Polylines polylines_blocker;
-    coord_t clip_size = scale_(this->spacing) * 2;
+    BlockerPointLookup polylines_blocker(width);
+    coord_t clip_size = width * 2;
     for (const Polyline &polyline : infill_ordered) {
         if (polyline.length() > 2.01 * clip_size) {
-            polylines_blocker.push_back(polyline);
-            polylines_blocker.back().clip_end((double)clip_size);
-            polylines_blocker.back().clip_start((double)clip_size);
+            Polyline blocker = polyline;
+            blocker.clip_end((double)clip_size);
+            blocker.clip_start((double)clip_size);
+            for (const Point &pt : blocker.points)
+                polylines_blocker.insert(pt);
         }
     }
 
@@ -488,8 +616,8 @@ Fill::connect_infill(const Polylines &infill_ordered, const ExPolygon &boundary,
             Points &pts_end = polylines_connected_first.back().points;
             const Point &last_point = pts_end.back();
             const Point &first_point = polyline.points.front();
-            if (last_point.distance_to(first_point) < scale_(this->spacing) * 10) {
-                Points pts_frontier = getFrontier(polylines_frontier, last_point, first_point, scale_(this->spacing), polylines_blocker, scale_(ideal_length) * 2);
+            if (last_point.distance_to(first_point) < width * 10) {
+                Points pts_frontier = getFrontier(polylines_frontier, frontier_lookup, last_point, first_point, width, polylines_blocker, scale_(ideal_length) * 2);
                 if (!pts_frontier.empty()) {
                     // The lines can be connected.
                     pts_end.insert(pts_end.end(), pts_frontier.begin(), pts_frontier.end());
@@ -513,8 +641,7 @@ Fill::connect_infill(const Polylines &infill_ordered, const ExPolygon &boundary,
             const Point &last_point = pts_end.back();
             const Point &first_point = polyline.points.front();
 
-            Polylines before = polylines_frontier;
-            Points pts_frontier = getFrontier(polylines_frontier, last_point, first_point, scale_(this->spacing), polylines_blocker);
+            Points pts_frontier = getFrontier(polylines_frontier, frontier_lookup, last_point, first_point, width, polylines_blocker);
             if (!pts_frontier.empty()) {
                 // The lines can be connected.
                 pts_end.insert(pts_end.end(), pts_frontier.begin(), pts_frontier.end());
@@ -529,48 +656,99 @@ Fill::connect_infill(const Polylines &infill_ordered, const ExPolygon &boundary,
     }
 
     //try to link to nearest point if possible
+    // The end points of the polylines following idx1 are searched in a KD tree. Only idx1 and the polyline merged into it
+    // are modified by a connection, so the end points of the following polylines stay valid until they are merged.
+    // The merged polylines are only filtered out by the search, the KD tree is rebuilt once half of its points are taken.
+    std::vector<Point> end_points;
+    end_points.reserve(polylines_connected.size() * 2);
+    for (const Polyline &polyline : polylines_connected) {
+        end_points.emplace_back(polyline.first_point());
+        end_points.emplace_back(polyline.last_point());
+    }
+    std::vector<bool> merged(polylines_connected.size(), false);
+    auto coordinate_fn = [&end_points](size_t idx, size_t dimension) -> double { return double(end_points[idx](dimension)); };
+    typedef KDTreeIndirect<2, double, decltype(coordinate_fn)> KDTreeType;
+    KDTreeType kdtree(coordinate_fn, end_points.size());
+    size_t num_indexed = end_points.size();
+    size_t num_taken   = 0;
     for (size_t idx1 = 0; idx1 < polylines_connected.size(); idx1++) {
-        size_t min_idx = 0;
-        coordf_t min_length = 0;
-        bool switch_id1 = false;
-        bool switch_id2 = false;
-        for (size_t idx2 = idx1 + 1; idx2 < polylines_connected.size(); idx2++) {
-            double last_first = polylines_connected[idx1].last_point().distance_to_square(polylines_connected[idx2].first_point());
-            double first_first = polylines_connected[idx1].first_point().distance_to_square(polylines_connected[idx2].first_point());
-            double first_last = polylines_connected[idx1].first_point().distance_to_square(polylines_connected[idx2].last_point());
-            double last_last = polylines_connected[idx1].last_point().distance_to_square(polylines_connected[idx2].last_point());
-            double min = std::min(std::min(last_first, last_last), std::min(first_first, first_last));
-            if (min < min_length || min_length == 0) {
-                min_idx = idx2;
-                switch_id1 = (std::min(last_first, last_last) > std::min(first_first, first_last));
-                switch_id2 = (std::min(last_first, first_first) > std::min(last_last, first_last));
-                min_length = min;
-            }
+        if (merged[idx1])
+            continue;
+        num_taken += 2;
+        if (num_taken * 2 > num_indexed && num_indexed > 64) {
+            std::vector<size_t> remaining;
+            remaining.reserve(num_indexed - num_taken);
+            for (size_t idx = (idx1 + 1) * 2; idx < end_points.size(); ++ idx)
+                if (! merged[idx / 2])
+                    remaining.emplace_back(idx);
+            num_indexed = remaining.size();
+            num_taken   = 0;
+            kdtree.build(std::move(remaining));
         }
-        if (min_idx > idx1 && min_idx < polylines_connected.size()){
-            Points pts_frontier = getFrontier(polylines_frontier, 
+        // Closest end point of a following polyline, the lowest index wins a tie as with a linear search.
+        auto find_closest = [&kdtree, &merged, idx1](const Point &pt) {
+            struct Visitor {
+                const KDTreeType        &tree;
+                const std::vector<bool> &merged;
+                const size_t             idx1;
+                const Vec2d              pt;
+                size_t                   min_idx  = KDTreeType::npos;
+                double                   min_dist = std::numeric_limits<double>::max();
+                unsigned int operator()(size_t idx, size_t dimension) {
+                    if (idx / 2 > idx1 && ! merged[idx / 2]) {
+                        double dist = (Vec2d(tree.coordinate(idx, 0), tree.coordinate(idx, 1)) - pt).squaredNorm();
+                        if (dist < min_dist || (dist == min_dist && idx < min_idx)) {
+                            min_dist = dist;
+                            min_idx  = idx;
+                        }
+                    }
+                    return tree.descent_mask(pt(dimension), min_dist, idx, dimension);
+                }
+            } visitor { kdtree, merged, idx1, pt.cast<double>() };
+            if (! kdtree.empty())
+                kdtree.visit(visitor);
+            return std::make_pair(visitor.min_idx, visitor.min_dist);
+        };
+        std::pair<size_t, double> closest_first = find_closest(polylines_connected[idx1].first_point());
+        std::pair<size_t, double> closest_last  = find_closest(polylines_connected[idx1].last_point());
+        std::pair<size_t, double> closest = (closest_last.second < closest_first.second ||
+            (closest_last.second == closest_first.second && closest_last.first / 2 < closest_first.first / 2)) ? closest_last : closest_first;
+        if (closest.first != KDTreeType::npos) {
+            size_t min_idx = closest.first / 2;
+            double last_first = polylines_connected[idx1].last_point().distance_to_square(polylines_connected[min_idx].first_point());
+            double first_first = polylines_connected[idx1].first_point().distance_to_square(polylines_connected[min_idx].first_point());
+            double first_last = polylines_connected[idx1].first_point().distance_to_square(polylines_connected[min_idx].last_point());
+            double last_last = polylines_connected[idx1].last_point().distance_to_square(polylines_connected[min_idx].last_point());
+            bool switch_id1 = (std::min(last_first, last_last) > std::min(first_first, first_last));
+            bool switch_id2 = (std::min(last_first, first_first) > std::min(last_last, first_last));
+            Points pts_frontier = getFrontier(polylines_frontier, frontier_lookup,
                 switch_id1 ? polylines_connected[idx1].first_point() : polylines_connected[idx1].last_point(), 
                 switch_id2 ? polylines_connected[min_idx].last_point() : polylines_connected[min_idx].first_point(),
-                scale_(this->spacing), polylines_blocker);
+                width, polylines_blocker);
             if (!pts_frontier.empty()) {
                 if (switch_id1) polylines_connected[idx1].reverse();
                 if (switch_id2) polylines_connected[min_idx].reverse();
                 Points &pts_end = polylines_connected[idx1].points;
                 pts_end.insert(pts_end.end(), pts_frontier.begin(), pts_frontier.end());
                 pts_end.insert(pts_end.end(), polylines_connected[min_idx].points.begin(), polylines_connected[min_idx].points.end());
-                polylines_connected.erase(polylines_connected.begin() + min_idx);
+                polylines_connected[min_idx].points.clear();
+                merged[min_idx] = true;
+                num_taken += 2;
             }
         }
     }
 
     //try to create some loops if possible
-    for (Polyline &polyline : polylines_connected) {
-        Points pts_frontier = getFrontier(polylines_frontier, polyline.last_point(), polyline.first_point(), scale_(this->spacing), polylines_blocker);
+    for (size_t idx = 0; idx < polylines_connected.size(); ++ idx) {
+        if (merged[idx])
+            continue;
+        Polyline &polyline = polylines_connected[idx];
+        Points pts_frontier = getFrontier(polylines_frontier, frontier_lookup, polyline.last_point(), polyline.first_point(), width, polylines_blocker);
         if (!pts_frontier.empty()) {
             polyline.points.insert(polyline.points.end(), pts_frontier.begin(), pts_frontier.end());
             polyline.points.insert(polyline.points.begin(), polyline.points.back());
         }
-        polylines_out.emplace_back(polyline);
+        polylines_out.emplace_back(std::move(polyline));
     }
 }
 
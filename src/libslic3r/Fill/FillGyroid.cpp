@@ -4,6 +4,10 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 
 #include "FillGyroid.hpp"
 
@@ -29,34 +33,62 @@ static inline double f(double x, double z_sin, double z_cos, bool vertical, bool
     }
 }
 
+// Samples of a period of a wave, stored as separate x and y arrays, so that the periods may be shifted and transformed
+// with Eigen array expressions, which Eigen vectorizes with SSE2 / AVX / NEON packets.
+typedef Eigen::Array<double,  Eigen::Dynamic, 1> WaveCoordinates;
+typedef Eigen::Array<coord_t, Eigen::Dynamic, 1> WaveCoordinatesScaled;
+
 static inline Polyline make_wave(
     const std::vector<Vec2d>& one_period, double width, double height, double offset, double scaleFactor,
     double z_cos, double z_sin, bool vertical, bool flip)
 {
-    std::vector<Vec2d> points = one_period;
-    double period = points.back()(0);
-    if (width != period) // do not extend if already truncated
-    {
-        points.reserve(one_period.size() * floor(width / period));
-        points.pop_back();
-
-        int n = points.size();
-        do {
-            points.emplace_back(Vec2d(points[points.size()-n](0) + period, points[points.size()-n](1)));
-        } while (points.back()(0) < width - EPSILON);
-
-        points.emplace_back(Vec2d(width, f(width, z_sin, z_cos, vertical, flip)));
+    const double period = one_period.back()(0);
+    // do not extend if already truncated
+    const bool   extend = width != period;
+    // Number of samples of a single period. The last sample of an extended period is the first sample of the next one.
+    const size_t n      = extend ? one_period.size() - 1 : one_period.size();
+    WaveCoordinates x(n), y(n);
+    for (size_t i = 0; i < n; ++ i) {
+        x[i] = one_period[i](0);
+        y[i] = one_period[i](1);
     }
+    // All the periods share the y coordinates, thus they are offset, clamped and scaled just once.
+    const WaveCoordinatesScaled y_scaled = ((y + offset).min(height).max(0.) * scaleFactor).cast<coord_t>();
+    WaveCoordinatesScaled       x_scaled(n);
 
     // and construct the final polyline to return:
     Polyline polyline;
-    polyline.points.reserve(points.size());
-    for (auto& point : points) {
-        point(1) += offset;
-        point(1) = clamp(0., height, double(point(1)));
+    polyline.points.reserve(extend ? (size_t(std::max(0., std::floor(width / period))) + 2) * n + 1 : n);
+    auto append_period = [vertical, scaleFactor, &x, &x_scaled, &y_scaled, &polyline](size_t num_samples) {
+        x_scaled.head(num_samples) = (x.head(num_samples) * scaleFactor).cast<coord_t>();
+        if (vertical)
+            for (size_t i = 0; i < num_samples; ++ i)
+                polyline.points.emplace_back(y_scaled[i], x_scaled[i]);
+        else
+            for (size_t i = 0; i < num_samples; ++ i)
+                polyline.points.emplace_back(x_scaled[i], y_scaled[i]);
+    };
+    append_period(n);
+
+    if (extend) {
+        for (;;) {
+            // Shift the samples by a whole period. The x coordinates are accumulated period by period
+            // to produce exactly the same samples as if they were extended one by one.
+            x += period;
+            const double *begin = x.data();
+            const double *end   = begin + n;
+            const double *it    = std::find_if(begin, end, [width](double sample_x) { return sample_x >= width - EPSILON; });
+            if (it == end)
+                append_period(n);
+            else {
+                append_period(it - begin + 1);
+                break;
+            }
+        }
+        Vec2d last(width, clamp(0., height, f(width, z_sin, z_cos, vertical, flip) + offset));
         if (vertical)
-            std::swap(point(0), point(1));
-        polyline.points.emplace_back((point * scaleFactor).cast<coord_t>());
+            std::swap(last(0), last(1));
+        polyline.points.emplace_back((last * scaleFactor).cast<coord_t>());
     }
 
     return polyline;
@@ -75,34 +107,97 @@ static std::vector<Vec2d> make_one_period(double width, double scaleFactor, doub
     points.emplace_back(Vec2d(limit, f(limit, z_sin, z_cos, vertical, flip)));
 
     // piecewise increase in resolution up to requested tolerance
+    std::vector<Vec2d> refined;
     for(;;)
     {
-        size_t size = points.size();
-        for (unsigned int i = 1;i < size; ++i) {
-            auto& lp = points[i-1]; // left point
-            auto& rp = points[i];   // right point
-            double x = lp(0) + (rp(0) - lp(0)) / 2;
-            double y = f(x, z_sin, z_cos, vertical, flip);
-            Vec2d ip = {x, y};
-            if (std::abs(cross2(Vec2d(ip - lp), Vec2d(ip - rp))) > sqr(tolerance)) {
-                points.emplace_back(std::move(ip));
-            }
+        // Evaluate the midpoints of all the segments of the current pass in a single batch.
+        size_t          size = points.size();
+        WaveCoordinates xl(size - 1), xr(size - 1);
+        for (size_t i = 1; i < size; ++ i) {
+            xl[i - 1] = points[i - 1](0);
+            xr[i - 1] = points[i](0);
         }
+        WaveCoordinates xm = xl + (xr - xl) / 2;
+        WaveCoordinates ym(size - 1);
+        for (size_t i = 0; i + 1 < size; ++ i)
+            ym[i] = f(xm[i], z_sin, z_cos, vertical, flip);
 
-        if (size == points.size())
-            break;
-        else
-        {
-            // insert new points in order
-            std::sort(points.begin(), points.end(),
-                      [](const Vec2d &lhs, const Vec2d &rhs) { return lhs(0) < rhs(0); });
+        // insert new points in order
+        refined.clear();
+        refined.reserve(2 * size - 1);
+        refined.emplace_back(points.front());
+        for (size_t i = 1; i < size; ++ i) {
+            const Vec2d &lp = points[i-1]; // left point
+            const Vec2d &rp = points[i];   // right point
+            Vec2d        ip = { xm[i - 1], ym[i - 1] };
+            if (std::abs(cross2(Vec2d(ip - lp), Vec2d(ip - rp))) > sqr(tolerance))
+                refined.emplace_back(ip);
+            refined.emplace_back(rp);
         }
+
+        if (size == refined.size())
+            break;
+        points.swap(refined);
     }
 
     return points;
 }
 
-static Polylines make_gyroid_waves(double gridZ, double density_adjusted, double line_spacing, double width, double height)
+// One period of the odd and of the even waves of a gyroid layer.
+struct GyroidPeriods
+{
+    std::vector<Vec2d> odd;
+    std::vector<Vec2d> even;
+};
+
+// The periods only depend on the z phase, on the scaling and on the tolerance, thus they are shared by all the surfaces
+// and regions printed at the same z. The layers are filled in parallel, therefore the cache is guarded by a mutex.
+static std::shared_ptr<const GyroidPeriods> make_periods(double scaleFactor, double tolerance, double width, double z_cos, double z_sin, bool vertical)
+{
+    auto periods = std::make_shared<GyroidPeriods>();
+    // even polylines are a bit shifted
+    periods->odd  = make_one_period(width, scaleFactor, z_cos, z_sin, vertical, ! vertical, tolerance);
+    periods->even = make_one_period(width, scaleFactor, z_cos, z_sin, vertical, vertical, tolerance);
+    return periods;
+}
+
+class GyroidPeriodsCache
+{
+public:
+    std::shared_ptr<const GyroidPeriods> get(double z, double scaleFactor, double tolerance, double width, double z_cos, double z_sin, bool vertical)
+    {
+        // make_one_period() only depends on the width if it is shorter than a period.
+        Key key(z, scaleFactor, tolerance, std::min(2*M_PI, width));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_periods.find(key);
+            if (it != m_periods.end())
+                return it->second;
+        }
+        // Calculate outside of the lock, a concurrent calculation of the same periods gives the same result.
+        std::shared_ptr<const GyroidPeriods> periods = make_periods(scaleFactor, tolerance, width, z_cos, z_sin, vertical);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_periods.size() >= FillGyroid::MaxPeriodsCached)
+            // The periods of the layers processed so far will hardly be needed again.
+            m_periods.clear();
+        return m_periods.emplace(key, std::move(periods)).first->second;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_periods.size();
+    }
+
+private:
+    typedef std::tuple<double, double, double, double> Key;
+    std::mutex                                              m_mutex;
+    std::map<Key, std::shared_ptr<const GyroidPeriods>>     m_periods;
+};
+
+static GyroidPeriodsCache gyroid_periods_cache;
+
+Polylines FillGyroid::make_waves(double gridZ, double density_adjusted, double line_spacing, double width, double height, bool use_periods_cache)
 {
     const double scaleFactor = scale_(line_spacing) / density_adjusted;
 
@@ -127,10 +222,16 @@ static Polylines make_gyroid_waves(double gridZ, double density_adjusted, double
         std::swap(width,height);
     }
 
-    std::vector<Vec2d> one_period_odd = make_one_period(width, scaleFactor, z_cos, z_sin, vertical, flip, tolerance); // creates one period of the waves, so it doesn't have to be recalculated all the time
-    flip = !flip;                                                                   // even polylines are a bit shifted
-    std::vector<Vec2d> one_period_even = make_one_period(width, scaleFactor, z_cos, z_sin, vertical, flip, tolerance);
+    // one period of the waves, so it doesn't have to be recalculated all the time
+    std::shared_ptr<const GyroidPeriods> periods = use_periods_cache ?
+        gyroid_periods_cache.get(z, scaleFactor, tolerance, width, z_cos, z_sin, vertical) :
+        make_periods(scaleFactor, tolerance, width, z_cos, z_sin, vertical);
+    const std::vector<Vec2d> &one_period_odd  = periods->odd;
+    const std::vector<Vec2d> &one_period_even = periods->even;
+    flip = !flip;
     Polylines result;
+    // Polyline is not nothrow move constructible, thus the waves would be copied when growing the vector.
+    result.reserve(size_t(std::max(0., (upper_bound - lower_bound) / M_PI)) + 2);
 
     for (double y0 = lower_bound; y0 < upper_bound + EPSILON; y0 += M_PI) {
         // creates odd polylines
@@ -145,8 +246,14 @@ static Polylines make_gyroid_waves(double gridZ, double density_adjusted, double
     return result;
 }
 
+size_t FillGyroid::periods_cached()
+{
+    return gyroid_periods_cache.size();
+}
+
 // FIXME: needed to fix build on Mac on buildserver
 constexpr double FillGyroid::PatternTolerance;
+constexpr size_t FillGyroid::MaxPeriodsCached;
 
 void FillGyroid::_fill_surface_single(
     const FillParams                &params, 
@@ -169,7 +276,7 @@ void FillGyroid::_fill_surface_single(
     bb.merge(_align_to_grid(bb.min, Point(2*M_PI*distance, 2*M_PI*distance)));
 
     // generate pattern
-    Polylines polylines = make_gyroid_waves(
+    Polylines polylines = make_waves(
         scale_(this->z),
         density_adjusted,
         this->spacing,
@@ -23,6 +23,15 @@ public:
     // Gyroid upper resolution tolerance (mm^-2)
     static constexpr double PatternTolerance = 0.2;
 
+    // Maximum number of layers, for which one period of the odd and of the even waves is cached.
+    static constexpr size_t MaxPeriodsCached = 1024;
+
+    // Unclipped waves of a layer at the scaled grid_z, starting at the origin. The width and height are in the units
+    // of the scaled distance of the waves, scale_(line_spacing) / density_adjusted.
+    // One period of the waves is shared through a cache by all the surfaces filled at the same z, unless use_periods_cache is false.
+    static Polylines make_waves(double grid_z, double density_adjusted, double line_spacing, double width, double height, bool use_periods_cache = true);
+    // Number of the layers with their periods cached.
+    static size_t    periods_cached();
 
 protected:
     virtual void _fill_surface_single(
@@ -7,6 +7,7 @@
 namespace Slic3r {
 
 FillHoneycomb::Cache FillHoneycomb::cache{};
+std::mutex           FillHoneycomb::cache_mutex;
 
 void FillHoneycomb::_fill_surface_single(
     const FillParams                &params, 
@@ -16,7 +17,9 @@ void FillHoneycomb::_fill_surface_single(
     Polylines                       &polylines_out) const
 {
     // cache hexagons math
+    // The layers are filled in parallel, copy the cached data under the lock.
     CacheID cache_id(params.density, this->spacing);
+    std::unique_lock<std::mutex> lock(FillHoneycomb::cache_mutex);
     Cache::iterator it_m = FillHoneycomb::cache.find(cache_id);
     if (it_m == FillHoneycomb::cache.end()) {
         it_m = FillHoneycomb::cache.insert(it_m, std::pair<CacheID, CacheData>(cache_id, CacheData()));
@@ -32,7 +35,8 @@ void FillHoneycomb::_fill_surface_single(
         m.y_offset = m.x_offset * sqrt(3)/3;
         m.hex_center = Point(m.hex_width/2, m.hex_side);
     }
-    CacheData &m = it_m->second;
+    const CacheData m = it_m->second;
+    lock.unlock();
 
     Polygons polygons;
     {
@@ -2,6 +2,7 @@
 #define slic3r_FillHoneycomb_hpp_
 
 #include <map>
+#include <mutex>
 
 #include "../libslic3r.h"
 
@@ -48,6 +49,7 @@ protected:
     };
     typedef std::map<CacheID, CacheData> Cache;
 	static Cache cache;
+	static std::mutex cache_mutex;
 
     virtual float _layer_angle(size_t idx) const { return float(M_PI/3.) * (idx % 3); }
 };
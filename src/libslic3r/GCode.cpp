@@ -32,6 +32,7 @@
 #include "SVG.hpp"
 
 #include <tbb/parallel_for.h>
+#include <tbb/pipeline.h>
 
 #include <Shiny/Shiny.h>
 
@@ -755,6 +756,7 @@ void GCode::do_export(Print *print, const char *path, GCodePreviewData *preview_
         throw std::runtime_error(std::string("G-code export to ") + path + " failed.\nCannot open the file for writing.\n");
 
     m_enable_analyzer = preview_data != nullptr;
+    bool remaining_times_enabled = print->config().remaining_times.value;
 
     try {
         m_placeholder_parser_failed_templates.clear();
@@ -763,6 +765,12 @@ void GCode::do_export(Print *print, const char *path, GCodePreviewData *preview_
 #else
         this->_do_export(*print, file);
 #endif // ENABLE_THUMBNAIL_GENERATOR
+        if (m_remaining_times_writer) {
+            // The print time is known now, fill in the remaining times of the M73 lines already written.
+            BOOST_LOG_TRIVIAL(debug) << "Time estimator filling in the remaining times" << log_memory_info();
+            m_remaining_times_writer->finalize(file, m_normal_time_estimator.get_time(), m_silent_time_estimator.get_time());
+            m_remaining_times_writer.reset();
+        }
         fflush(file);
         if (ferror(file)) {
             fclose(file);
@@ -772,6 +780,7 @@ void GCode::do_export(Print *print, const char *path, GCodePreviewData *preview_
     } catch (std::exception & /* ex */) {
         // Rethrow on any exception. std::runtime_exception and CanceledException are expected to be thrown.
         // Close and remove the file.
+        m_remaining_times_writer.reset();
         fclose(file);
         boost::nowide::remove(path_tmp.c_str());
         throw;
@@ -791,14 +800,14 @@ void GCode::do_export(Print *print, const char *path, GCodePreviewData *preview_
         throw std::runtime_error(msg);
     }
 
-    GCodeTimeEstimator::PostProcessData normal_data = m_normal_time_estimator.get_post_process_data();
-    GCodeTimeEstimator::PostProcessData silent_data = m_silent_time_estimator.get_post_process_data();
+    if (! m_single_pass_export) {
+        GCodeTimeEstimator::PostProcessData normal_data = m_normal_time_estimator.get_post_process_data();
+        GCodeTimeEstimator::PostProcessData silent_data = m_silent_time_estimator.get_post_process_data();
 
-    bool remaining_times_enabled = print->config().remaining_times.value;
-
-    BOOST_LOG_TRIVIAL(debug) << "Time estimator post processing" << log_memory_info();
-    GCodeTimeEstimator::post_process(path_tmp, 60.0f, remaining_times_enabled ? &normal_data : nullptr, 
-        (remaining_times_enabled && m_silent_time_estimator_enabled) ? &silent_data : nullptr);
+        BOOST_LOG_TRIVIAL(debug) << "Time estimator post processing" << log_memory_info();
+        GCodeTimeEstimator::post_process(path_tmp, 60.0f, remaining_times_enabled ? &normal_data : nullptr, 
+            (remaining_times_enabled && m_silent_time_estimator_enabled) ? &silent_data : nullptr);
+    }
 
     if (remaining_times_enabled)
     {
@@ -1194,11 +1203,20 @@ void GCode::_do_export(Print &print, FILE *file)
     	// modifies the following:
     	m_normal_time_estimator, m_silent_time_estimator, m_silent_time_estimator_enabled);
     DoExport::init_gcode_analyzer(print.config(), m_analyzer);
+    if (m_single_pass_export) {
+        // Place the remaining times while writing the G-code, do_export() fills in their values.
+        bool remaining_times_enabled = print.config().remaining_times.value;
+        GCodeTimeEstimator::PostProcessData normal_data = m_normal_time_estimator.get_post_process_data();
+        GCodeTimeEstimator::PostProcessData silent_data = m_silent_time_estimator.get_post_process_data();
+        m_remaining_times_writer.reset(new GCodeTimeEstimator::RemainingTimesWriter(remaining_times_enabled ? &normal_data : nullptr,
+            (remaining_times_enabled && m_silent_time_estimator_enabled) ? &silent_data : nullptr, 60.0f));
+    }
 
     // resets analyzer's tracking data
     m_last_mm3_per_mm = GCodeAnalyzer::Default_mm3_per_mm;
     m_last_width = GCodeAnalyzer::Default_Width;
     m_last_height = GCodeAnalyzer::Default_Height;
+    m_analyzer_extrusion_params.clear();
     print.m_print_statistics.color_extruderid_to_used_filament.clear();
     print.m_print_statistics.color_extruderid_to_used_weight.clear();
 
@@ -1512,12 +1530,17 @@ if (print.config().gcode_flavor.value != gcfopenfl) {
             m_cooling_buffer->set_current_extruder(initial_extruder_id);
             // Pair the object layers with the support layers by z, extrude them.
             std::vector<LayerToPrint> layers_to_print = collect_layers_to_print(object);
-            for (const LayerToPrint &ltp : layers_to_print) {
-                std::vector<LayerToPrint> lrs;
-                lrs.emplace_back(std::move(ltp));
-                this->process_layer(file, print, print.m_print_statistics, lrs, tool_ordering.tools_for_layer(ltp.print_z()), nullptr, *print_object_instance_sequential_active - object.instances().data());
-                print.throw_if_canceled();
-            }
+            const size_t              single_object_instance_idx = *print_object_instance_sequential_active - object.instances().data();
+            this->process_layers(file, print, layers_to_print.size(),
+                [this, &print, &layers_to_print](size_t layer_idx) {
+                    return this->prepare_layers(print, { layers_to_print[layer_idx] });
+                },
+                [this, &print, &layers_to_print, &tool_ordering, single_object_instance_idx](size_t layer_idx, const LayerPrepared &prepared) {
+                    const LayerToPrint &ltp = layers_to_print[layer_idx];
+                    std::vector<LayerToPrint> lrs;
+                    lrs.emplace_back(ltp);
+                    return this->process_layer(print, print.m_print_statistics, lrs, tool_ordering.tools_for_layer(ltp.print_z()), prepared, nullptr, single_object_instance_idx);
+                });
 #ifdef HAS_PRESSURE_EQUALIZER
             if (m_pressure_equalizer)
                 _write(file, m_pressure_equalizer->process("", true));
@@ -1564,13 +1587,17 @@ if (print.config().gcode_flavor.value != gcfopenfl) {
             print.throw_if_canceled();
         }
         // Extrude the layers.
-        for (auto &layer : layers_to_print) {
-            const LayerTools &layer_tools = tool_ordering.tools_for_layer(layer.first);
-            if (m_wipe_tower && layer_tools.has_wipe_tower)
-                m_wipe_tower->next_layer();
-            this->process_layer(file, print, print.m_print_statistics, layer.second, layer_tools, &print_object_instances_ordering, size_t(-1));
-            print.throw_if_canceled();
-        }
+        this->process_layers(file, print, layers_to_print.size(),
+            [this, &print, &layers_to_print](size_t layer_idx) {
+                return this->prepare_layers(print, layers_to_print[layer_idx].second);
+            },
+            [this, &print, &layers_to_print, &tool_ordering, &print_object_instances_ordering](size_t layer_idx, const LayerPrepared &prepared) {
+                const std::pair<coordf_t, std::vector<LayerToPrint>> &layer = layers_to_print[layer_idx];
+                const LayerTools &layer_tools = tool_ordering.tools_for_layer(layer.first);
+                if (m_wipe_tower && layer_tools.has_wipe_tower)
+                    m_wipe_tower->next_layer();
+                return this->process_layer(print, print.m_print_statistics, layer.second, layer_tools, prepared, &print_object_instances_ordering, size_t(-1));
+            });
 #ifdef HAS_PRESSURE_EQUALIZER
         if (m_pressure_equalizer)
             _write(file, m_pressure_equalizer->process("", true));
@@ -1736,53 +1763,61 @@ static bool custom_gcode_sets_temperature(const std::string &gcode, const int mc
 // Do not process this piece of G-code by the time estimator, it already knows the values through another sources.
 void GCode::print_machine_envelope(FILE *file, Print &print)
 {
+    // Written in order with the rest of the G-code (possibly into the export buffer), but bypassing the time estimators:
+    // they would interpret the M566 jerk limits in mm/min.
+    auto write_format = [this, file](const char *format, auto... args) {
+        char line[256];
+        int  len = ::snprintf(line, sizeof(line), format, args...);
+        if (len > 0)
+            this->_write_output(file, line, std::min(size_t(len), sizeof(line) - 1));
+    };
    // gcfRepRap, gcfRepetier, gcfTeacup, gcfMakerWare, gcfMarlin, gcfKlipper, gcfSailfish, gcfMach3, gcfMachinekit,
    ///     gcfSmoothie, gcfNoExtrusion, gcfLerdge,
     if (print.config().print_machine_envelope) {
         if (std::set<uint8_t>{gcfMarlin, gcfLerdge, gcfRepetier, gcfRepRap}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M201 X%d Y%d Z%d E%d ; sets maximum accelerations, mm/sec^2\n",
+            write_format("M201 X%d Y%d Z%d E%d ; sets maximum accelerations, mm/sec^2\n",
                 int(print.config().machine_max_acceleration_x.values.front() + 0.5),
                 int(print.config().machine_max_acceleration_y.values.front() + 0.5),
                 int(print.config().machine_max_acceleration_z.values.front() + 0.5),
                 int(print.config().machine_max_acceleration_e.values.front() + 0.5));
         if (std::set<uint8_t>{gcfRepetier}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M202 X%d Y%d ; sets maximum travel speed\n",
+            write_format("M202 X%d Y%d ; sets maximum travel speed\n",
                 int(print.config().travel_speed.value),
                 int(print.config().travel_speed.value));
         if (std::set<uint8_t>{gcfMarlin, gcfLerdge, gcfRepetier, gcfRepRap, gcfSmoothie}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M203 X%d Y%d Z%d E%d ; sets maximum feedrates, mm/sec\n",
+            write_format("M203 X%d Y%d Z%d E%d ; sets maximum feedrates, mm/sec\n",
                 int(print.config().machine_max_feedrate_x.values.front() + 0.5),
                 int(print.config().machine_max_feedrate_y.values.front() + 0.5),
                 int(print.config().machine_max_feedrate_z.values.front() + 0.5),
                 int(print.config().machine_max_feedrate_e.values.front() + 0.5));
         if (std::set<uint8_t>{gcfMarlin, gcfLerdge}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M204 P%d R%d T%d ; sets acceleration (P, T) and retract acceleration (R), mm/sec^2\n",
+            write_format("M204 P%d R%d T%d ; sets acceleration (P, T) and retract acceleration (R), mm/sec^2\n",
                 int(print.config().machine_max_acceleration_extruding.values.front() + 0.5),
                 int(print.config().machine_max_acceleration_retracting.values.front() + 0.5),
                 int(print.config().machine_max_acceleration_extruding.values.front() + 0.5));
         if (std::set<uint8_t>{gcfRepRap, gcfKlipper}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M204 P%d T%d ; sets acceleration (P, T) and retract acceleration (R), mm/sec^2\n",
+            write_format("M204 P%d T%d ; sets acceleration (P, T) and retract acceleration (R), mm/sec^2\n",
                 int(print.config().machine_max_acceleration_extruding.values.front() + 0.5),
                 int(print.config().machine_max_acceleration_retracting.values.front() + 0.5));
         if (std::set<uint8_t>{gcfMarlin, gcfLerdge, gcfRepetier}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M566 X%.2lf Y%.2lf Z%.2lf E%.2lf ; sets the jerk limits, mm/sec\n",
+            write_format("M566 X%.2lf Y%.2lf Z%.2lf E%.2lf ; sets the jerk limits, mm/sec\n",
                 print.config().machine_max_jerk_x.values.front(),
                 print.config().machine_max_jerk_y.values.front(),
                 print.config().machine_max_jerk_z.values.front(),
                 print.config().machine_max_jerk_e.values.front());
         if (std::set<uint8_t>{gcfRepRap}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M205 X%.2lf Y%.2lf Z%.2lf E%.2lf ; sets the jerk limits, mm/sec\n",
+            write_format("M205 X%.2lf Y%.2lf Z%.2lf E%.2lf ; sets the jerk limits, mm/sec\n",
                 print.config().machine_max_jerk_x.values.front(),
                 print.config().machine_max_jerk_y.values.front(),
                 print.config().machine_max_jerk_z.values.front(),
                 print.config().machine_max_jerk_e.values.front());
         if (std::set<uint8_t>{gcfSmoothie}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M205 X%.2lf Z%.2lf ; sets the jerk limits, mm/sec\n",
+            write_format("M205 X%.2lf Z%.2lf ; sets the jerk limits, mm/sec\n",
                 std::min(print.config().machine_max_jerk_x.values.front(),
                 print.config().machine_max_jerk_y.values.front()),
                 print.config().machine_max_jerk_z.values.front());
         if (std::set<uint8_t>{gcfMarlin, gcfLerdge, gcfRepetier}.count(print.config().gcode_flavor.value) > 0)
-            fprintf(file, "M205 S%d T%d ; sets the minimum extruding and travel feed rate, mm/sec\n",
+            write_format("M205 S%d T%d ; sets the minimum extruding and travel feed rate, mm/sec\n",
                 int(print.config().machine_min_extruding_rate.values.front() + 0.5),
                 int(print.config().machine_min_travel_rate.values.front() + 0.5));
     }
@@ -2074,14 +2109,14 @@ namespace Skirt {
 // In non-sequential mode, process_layer is called per each print_z height with all object and support layers accumulated.
 // For multi-material prints, this routine minimizes extruder switches by gathering extruder specific extrusion paths
 // and performing the extruder specific extrusions together.
-void GCode::process_layer(
-    // Write into the output file.
-    FILE                                    *file,
+GCode::LayerResult GCode::process_layer(
     const Print                             &print,
     PrintStatistics                         &print_stat,
     // Set of object & print layers of the same PrintObject and with the same print_z.
     const std::vector<LayerToPrint>         &layers,
     const LayerTools                        &layer_tools,
+    // Data precalculated by prepare_layers() for these layers.
+    const LayerPrepared                     &prepared,
 	// Pairs of PrintObject index and its instance index.
 	const std::vector<const PrintInstance*> *ordering,
     // If set to size_t(-1), then print all copies of all objects.
@@ -2093,9 +2128,10 @@ void GCode::process_layer(
     // Either printing all copies of all objects, or just a single copy of a single object.
     assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
 
+    LayerResult result;
     if (layer_tools.extruders.empty())
         // Nothing to extrude.
-        return;
+        return result;
 
     // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
     const Layer         *object_layer  = nullptr;
@@ -2340,7 +2376,9 @@ void GCode::process_layer(
     } // for objects
 
     // Extrude the skirt, brim, support, perimeters, infill ordered by the extruders.
-    std::vector<std::unique_ptr<EdgeGrid::Grid>> lower_layer_edge_grids(layers.size());
+    // Distance fields over the lower layers, precalculated by prepare_layers() or calculated on demand by extrude_loop().
+    std::vector<std::shared_ptr<EdgeGrid::Grid>> lower_layer_edge_grids = prepared.lower_layer_edge_grids;
+    lower_layer_edge_grids.resize(layers.size());
     for (unsigned int extruder_id : layer_tools.extruders)
     {
         gcode += (layer_tools.has_wipe_tower && m_wipe_tower) ?
@@ -2581,14 +2619,120 @@ void GCode::process_layer(
         gcode = m_pressure_equalizer->process(gcode.c_str(), false);
     // printf("G-code after filter:\n%s\n", out.c_str());
 #endif /* HAS_PRESSURE_EQUALIZER */
-    
-    _write(file, gcode);
-    BOOST_LOG_TRIVIAL(trace) << "Exported layer " << layer.id() << " print_z " << print_z << 
-        ", time estimator memory: " <<
-            format_memsize_MB(m_normal_time_estimator.memory_used() + (m_silent_time_estimator_enabled ? m_silent_time_estimator.memory_used() : 0)) <<
-        ", analyzer memory: " <<
-            format_memsize_MB(m_analyzer.memory_used()) <<
-        log_memory_info();
+
+    result.gcode    = std::move(gcode);
+    result.layer_id = layer.id();
+    result.print_z  = print_z;
+    result.analyzer_extrusion_params = std::move(m_analyzer_extrusion_params);
+    m_analyzer_extrusion_params.clear();
+    return result;
+}
+
+// Distance field over the slices of a layer, used to detect the overhangs of the layer above it.
+static std::shared_ptr<EdgeGrid::Grid> make_lower_layer_edge_grid(const Layer &lower_layer)
+{
+    const coord_t distance_field_resolution = coord_t(scale_(1.) + 0.5);
+    auto grid = std::make_shared<EdgeGrid::Grid>();
+    grid->create(lower_layer.lslices, distance_field_resolution);
+    grid->calculate_sdf();
+    return grid;
+}
+
+GCode::LayerPrepared GCode::prepare_layers(const Print &print, const std::vector<LayerToPrint> &layers)
+{
+    LayerPrepared prepared;
+    // The motion planner graphs are only calculated ahead by the layer pipeline, where it runs in parallel with the generation
+    // of the preceding layers. When exporting layer by layer, they are calculated lazily by the first travel needing them,
+    // as a layer may not need them at all.
+    if (m_pipelined_export && print.config().avoid_crossing_perimeters.value && m_avoid_crossing_perimeters.share_graphs())
+        for (const LayerToPrint &ltp : layers)
+            if (ltp.layer() != nullptr) {
+                // Same islands as passed to init_layer_mp() by process_layer().
+                MotionPlannerGraphPtrs layer_graphs = m_avoid_crossing_perimeters.prepare_layer_mp(union_ex(ltp.layer()->lslices, true));
+                append(prepared.mp_graphs, std::move(layer_graphs));
+            }
+    // The distance fields are needed by extrude_loop() for the perimeters of the object layers having a layer below.
+    prepared.lower_layer_edge_grids.assign(layers.size(), nullptr);
+    for (size_t i = 0; i < layers.size(); ++ i) {
+        const Layer *layer = layers[i].object_layer;
+        if (layer != nullptr && layer->lower_layer != nullptr &&
+            std::any_of(layer->regions().begin(), layer->regions().end(), [](const LayerRegion *layerm) { return ! layerm->perimeters.entities.empty(); }))
+            prepared.lower_layer_edge_grids[i] = make_lower_layer_edge_grid(*layer->lower_layer);
+    }
+    return prepared;
+}
+
+void GCode::process_layers(FILE *file, const Print &print, size_t num_layers,
+    std::function<LayerPrepared(size_t)> prepare_layer, std::function<LayerResult(size_t, const LayerPrepared&)> generate_layer)
+{
+    auto log_layer_exported = [this](const LayerResult &layer) {
+        BOOST_LOG_TRIVIAL(trace) << "Exported layer " << layer.layer_id << " print_z " << layer.print_z << 
+            ", time estimator memory: " <<
+                format_memsize_MB(m_normal_time_estimator.memory_used() + (m_silent_time_estimator_enabled ? m_silent_time_estimator.memory_used() : 0)) <<
+            ", analyzer memory: " <<
+                format_memsize_MB(layer.analyzer_memory_used) <<
+            log_memory_info();
+    };
+
+    if (! m_pipelined_export) {
+        for (size_t layer_idx = 0; layer_idx < num_layers; ++ layer_idx) {
+            LayerResult layer = generate_layer(layer_idx, prepare_layer(layer_idx));
+            print.throw_if_canceled();
+            if (layer.layer_id != size_t(-1)) {
+                this->_write_analyzed(file, this->_write_analyze(std::move(layer.gcode), layer.analyzer_extrusion_params));
+                layer.analyzer_memory_used = m_analyzer.memory_used();
+                log_layer_exported(layer);
+            }
+        }
+        return;
+    }
+
+    // The G-code generation is stateful (extruder state, last position, cooling buffer, spiral vase ...),
+    // therefore the layers are generated strictly in order. The analyzer and the time estimators
+    // only consume the generated text, so they run in their own stages, each one in order,
+    // while the following layers are being generated.
+    // The motion planner graphs and the distance fields of the layers in flight ahead of the generated one
+    // are calculated in parallel. The number of layers in flight limits the amount of G-code and of the precalculated
+    // data buffered in memory.
+    static constexpr const size_t max_layers_in_flight = 16;
+    typedef std::pair<size_t, LayerPrepared> LayerIdxPrepared;
+    size_t layer_idx = 0;
+    tbb::parallel_pipeline(max_layers_in_flight,
+        tbb::make_filter<void, size_t>(tbb::filter::serial_in_order,
+            [num_layers, &layer_idx](tbb::flow_control &fc) -> size_t {
+                if (layer_idx == num_layers) {
+                    fc.stop();
+                    return 0;
+                }
+                return layer_idx ++;
+            }) &
+        tbb::make_filter<size_t, LayerIdxPrepared>(tbb::filter::parallel,
+            [&print, &prepare_layer](size_t layer_idx) -> LayerIdxPrepared {
+                // Don't calculate anything if canceled, the generation stage will throw.
+                return LayerIdxPrepared(layer_idx, print.canceled() ? LayerPrepared() : prepare_layer(layer_idx));
+            }) &
+        tbb::make_filter<LayerIdxPrepared, LayerResult>(tbb::filter::serial_in_order,
+            [&print, &generate_layer](const LayerIdxPrepared &prepared) -> LayerResult {
+                print.throw_if_canceled();
+                LayerResult layer = generate_layer(prepared.first, prepared.second);
+                print.throw_if_canceled();
+                return layer;
+            }) &
+        tbb::make_filter<LayerResult, LayerResult>(tbb::filter::serial_in_order,
+            [this](LayerResult layer) -> LayerResult {
+                if (layer.layer_id != size_t(-1)) {
+                    layer.gcode = this->_write_analyze(std::move(layer.gcode), layer.analyzer_extrusion_params);
+                    layer.analyzer_memory_used = m_analyzer.memory_used();
+                }
+                return layer;
+            }) &
+        tbb::make_filter<LayerResult, void>(tbb::filter::serial_in_order,
+            [this, file, &log_layer_exported](const LayerResult &layer) {
+                if (layer.layer_id != size_t(-1)) {
+                    this->_write_analyzed(file, layer.gcode);
+                    log_layer_exported(layer);
+                }
+            }));
 }
 
 void GCode::apply_print_config(const PrintConfig &print_config)
@@ -2846,7 +2990,7 @@ std::vector<float> polygon_angles_at_vertices(const Polygon &polygon, const std:
 }
 
 //like extrude_loop but with varying z and two full round
-std::string GCode::extrude_loop_vase(const ExtrusionLoop &original_loop, const std::string &description, double speed, std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
+std::string GCode::extrude_loop_vase(const ExtrusionLoop &original_loop, const std::string &description, double speed, std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
 {
     //don't keep the speed
     speed = -1;
@@ -2856,11 +3000,8 @@ std::string GCode::extrude_loop_vase(const ExtrusionLoop &original_loop, const s
 
     if (m_layer->lower_layer != nullptr && lower_layer_edge_grid != nullptr) {
         if (!*lower_layer_edge_grid) {
-            // Create the distance field for a layer below.
-            const coord_t distance_field_resolution = coord_t(scale_(1.) + 0.5);
-            *lower_layer_edge_grid = make_unique<EdgeGrid::Grid>();
-            (*lower_layer_edge_grid)->create(m_layer->lower_layer->lslices, distance_field_resolution);
-            (*lower_layer_edge_grid)->calculate_sdf();
+            // Create the distance field for a layer below, if it was not precalculated by prepare_layers().
+            *lower_layer_edge_grid = make_lower_layer_edge_grid(*m_layer->lower_layer);
 #if 0
             {
                 static int iRun = 0;
@@ -3099,7 +3240,7 @@ std::string GCode::extrude_loop_vase(const ExtrusionLoop &original_loop, const s
     return gcode;
 }
 
-void GCode::split_at_seam_pos(ExtrusionLoop &loop, std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
+void GCode::split_at_seam_pos(ExtrusionLoop &loop, std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
 {
     if (loop.paths.empty())
         return;
@@ -3290,7 +3431,7 @@ void GCode::split_at_seam_pos(ExtrusionLoop &loop, std::unique_ptr<EdgeGrid::Gri
     }
 }
 
-std::string GCode::extrude_loop(const ExtrusionLoop &original_loop, const std::string &description, double speed, std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
+std::string GCode::extrude_loop(const ExtrusionLoop &original_loop, const std::string &description, double speed, std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
 {
 #if DEBUG_EXTRUSION_OUTPUT
     std::cout << "extrude loop_" << (original_loop.polygon().is_counter_clockwise() ? "ccw" : "clw") << ": ";
@@ -3320,11 +3461,8 @@ std::string GCode::extrude_loop(const ExtrusionLoop &original_loop, const std::s
 
     if (m_layer->lower_layer != nullptr && lower_layer_edge_grid != nullptr) {
         if (! *lower_layer_edge_grid) {
-            // Create the distance field for a layer below.
-            const coord_t distance_field_resolution = coord_t(scale_(1.) + 0.5);
-            *lower_layer_edge_grid = make_unique<EdgeGrid::Grid>();
-            (*lower_layer_edge_grid)->create(m_layer->lower_layer->lslices, distance_field_resolution);
-            (*lower_layer_edge_grid)->calculate_sdf();
+            // Create the distance field for a layer below, if it was not precalculated by prepare_layers().
+            *lower_layer_edge_grid = make_lower_layer_edge_grid(*m_layer->lower_layer);
             #if 0
             {
                 static int iRun = 0;
@@ -3519,7 +3657,7 @@ std::string GCode::extrude_multi_path3D(const ExtrusionMultiPath3D &multipath3D,
     return gcode;
 }
 
-std::string GCode::extrude_entity(const ExtrusionEntity &entity, const std::string &description, double speed, std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
+std::string GCode::extrude_entity(const ExtrusionEntity &entity, const std::string &description, double speed, std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid)
 {
     this->visitor_gcode.clear();
     this->visitor_comment = description;
@@ -3589,7 +3727,7 @@ std::string GCode::extrude_path_3D(const ExtrusionPath3D &path, const std::strin
 }
 
 // Extrude perimeters: Decide where to put seams (hide or align seams).
-std::string GCode::extrude_perimeters(const Print &print, const std::vector<ObjectByExtruder::Island::Region> &by_region, std::unique_ptr<EdgeGrid::Grid> &lower_layer_edge_grid)
+std::string GCode::extrude_perimeters(const Print &print, const std::vector<ObjectByExtruder::Island::Region> &by_region, std::shared_ptr<EdgeGrid::Grid> &lower_layer_edge_grid)
 {
     std::string gcode;
     for (const ObjectByExtruder::Island::Region &region : by_region)
@@ -3663,18 +3801,40 @@ void GCode::_write(FILE* file, const char *what)
         std::string str_preproc{ what };
         //_post_process(str_preproc);
 
-        const std::string str_ana = m_analyzer.process_gcode(str_preproc);
+        this->_write_analyzed(file, this->_write_analyze(std::move(str_preproc), m_analyzer_extrusion_params));
+        m_analyzer_extrusion_params.clear();
+    }
+}
 
-        // apply analyzer, if enabled
-        const char * gcode = m_enable_analyzer ? str_ana.c_str() : str_preproc.c_str();
+std::string GCode::_write_analyze(std::string &&what, const std::vector<GCodeAnalyzer::ExtrusionParams> &extrusion_params)
+{
+    // apply analyzer, if enabled
+    return m_enable_analyzer ? m_analyzer.process_gcode(what, extrusion_params) : std::move(what);
+}
 
-        // writes string to file
-        fwrite(gcode, 1, ::strlen(gcode), file);
-        // updates time estimator and gcode lines vector
-        m_normal_time_estimator.add_gcode_block(gcode);
-        if (m_silent_time_estimator_enabled)
-            m_silent_time_estimator.add_gcode_block(gcode);
+void GCode::_write_analyzed(FILE* file, const std::string &what)
+{
+    const char *gcode = what.c_str();
+    // updates time estimator and gcode lines vector
+    // and calculates the times of the new blocks, so that the remaining times may be placed while writing the G-code
+    // (in both export modes to export the same G-code)
+    m_normal_time_estimator.add_gcode_block(gcode);
+    m_normal_time_estimator.resolve_times();
+    if (m_silent_time_estimator_enabled) {
+        m_silent_time_estimator.add_gcode_block(gcode);
+        m_silent_time_estimator.resolve_times();
     }
+    this->_write_output(file, gcode, ::strlen(gcode));
+}
+
+void GCode::_write_output(FILE* file, const char *what, size_t len)
+{
+    if (m_remaining_times_writer)
+        // writes string to file, placing the remaining times
+        m_remaining_times_writer->write(file, what, len);
+    else
+        // writes string to file
+        fwrite(what, 1, len, file);
 }
 
 void GCode::_writeln(FILE* file, const std::string &what)
@@ -3912,34 +4072,17 @@ std::string GCode::_before_extrude(const ExtrusionPath &path, const std::string
         // PrusaMultiMaterial::Writer may generate GCodeAnalyzer::Height_Tag and GCodeAnalyzer::Width_Tag lines without updating m_last_height and m_last_width
         // so, if the last role was erWipeTower we force export of GCodeAnalyzer::Height_Tag and GCodeAnalyzer::Width_Tag lines
         bool last_was_wipe_tower = (m_last_analyzer_extrusion_role == erWipeTower);
-        char buf[64];
 
-        if (path.role() != m_last_analyzer_extrusion_role)
+        // the parameters are handed over to the analyzer together with the gcode, the gcode receives just a tag marking where they apply
+        if (last_was_wipe_tower || path.role() != m_last_analyzer_extrusion_role || m_last_mm3_per_mm != path.mm3_per_mm ||
+            m_last_width != path.width || m_last_height != path.height)
         {
             m_last_analyzer_extrusion_role = path.role();
-            sprintf(buf, ";%s%d\n", GCodeAnalyzer::Extrusion_Role_Tag.c_str(), int(m_last_analyzer_extrusion_role));
-            gcode += buf;
-        }
-
-        if (last_was_wipe_tower || (m_last_mm3_per_mm != path.mm3_per_mm))
-        {
             m_last_mm3_per_mm = path.mm3_per_mm;
-            sprintf(buf, ";%s%f\n", GCodeAnalyzer::Mm3_Per_Mm_Tag.c_str(), m_last_mm3_per_mm);
-            gcode += buf;
-        }
-
-        if (last_was_wipe_tower || (m_last_width != path.width))
-        {
             m_last_width = path.width;
-            sprintf(buf, ";%s%f\n", GCodeAnalyzer::Width_Tag.c_str(), m_last_width);
-            gcode += buf;
-        }
-
-        if (last_was_wipe_tower || (m_last_height != path.height))
-        {
             m_last_height = path.height;
-            sprintf(buf, ";%s%f\n", GCodeAnalyzer::Height_Tag.c_str(), m_last_height);
-            gcode += buf;
+            m_analyzer_extrusion_params.push_back({ m_last_analyzer_extrusion_role, m_last_mm3_per_mm, m_last_width, m_last_height });
+            gcode += ";" + GCodeAnalyzer::Extrusion_Params_Tag + "\n";
         }
     }
 
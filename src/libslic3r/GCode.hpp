@@ -21,6 +21,7 @@
 #include "GCode/ThumbnailData.hpp"
 #endif // ENABLE_THUMBNAIL_GENERATOR
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -46,12 +47,20 @@ public:
     // we enable it by default for the first travel move in print
     bool disable_once;
     
-    AvoidCrossingPerimeters() : use_external_mp(false), use_external_mp_once(false), disable_once(true) {}
+    AvoidCrossingPerimeters() : use_external_mp(false), use_external_mp_once(false), disable_once(true), m_share_graphs(true) {}
     ~AvoidCrossingPerimeters() {}
 
-    void reset() { m_external_mp.reset(); m_layer_mp.reset(); }
+    void reset() { m_external_mp.reset(); m_layer_mp.reset(); m_layer_mp_graphs.clear(); }
 	void init_external_mp(const Print &print);
-    void init_layer_mp(const ExPolygons &islands) { m_layer_mp = Slic3r::make_unique<MotionPlanner>(islands); }
+    void init_layer_mp(const ExPolygons &islands) { m_layer_mp = Slic3r::make_unique<MotionPlanner>(islands, this->graph_cache()); }
+    // Calculate the motion planner graphs of a layer in advance, so that init_layer_mp() of the same islands will reuse them
+    // as long as the returned graphs are held. Thread safe, may be called for the following layers while a layer is being exported.
+    MotionPlannerGraphPtrs prepare_layer_mp(const ExPolygons &islands)
+        { return m_share_graphs ? MotionPlanner(islands, &m_layer_mp_graphs).init_graphs() : MotionPlannerGraphPtrs(); }
+    // Share the graphs between the layer motion planners (enabled by default). If disabled, each layer motion planner
+    // calculates its own graphs when a path is first planned there. The planned paths are identical in both modes.
+    bool share_graphs() const { return m_share_graphs; }
+    void set_share_graphs(bool enable) { m_share_graphs = enable; }
 
     Polyline travel_to(const GCode &gcodegen, const Point &point);
 
@@ -62,6 +71,11 @@ private:
 
     std::unique_ptr<MotionPlanner> m_external_mp;
     std::unique_ptr<MotionPlanner> m_layer_mp;
+    // Graphs of the layer motion planners, shared between the copies of an object and between the layers with the same islands.
+    MotionPlannerGraphCache        m_layer_mp_graphs;
+    bool                           m_share_graphs;
+
+    MotionPlannerGraphCache*       graph_cache() { return m_share_graphs ? &m_layer_mp_graphs : nullptr; }
 };
 
 class OozePrevention {
@@ -147,6 +161,8 @@ public:
         m_enable_cooling_markers(false), 
         m_enable_extrusion_role_markers(false), 
         m_enable_analyzer(false),
+        m_pipelined_export(true),
+        m_single_pass_export(true),
         m_last_analyzer_extrusion_role(erNone),
         m_layer_count(0),
         m_layer_index(-1), 
@@ -193,6 +209,20 @@ public:
     bool            enable_cooling_markers() const { return m_enable_cooling_markers; }
     std::string     extrusion_role_to_string_for_parser(const ExtrusionRole &);
 
+    // Overlap the per layer G-code generation with the G-code analysis, time estimation and output (enabled by default).
+    // The exported G-code is identical in both modes.
+    bool            pipelined_export() const { return m_pipelined_export; }
+    void            set_pipelined_export(bool enable) { m_pipelined_export = enable; }
+    // Write the G-code into the file with the remaining times (M73 lines) placed while it is being generated and fill in
+    // their values once the print time is known, instead of post processing the exported file (enabled by default).
+    // The exported G-code is identical in both modes.
+    bool            single_pass_export() const { return m_single_pass_export; }
+    void            set_single_pass_export(bool enable) { m_single_pass_export = enable; }
+    // Share the motion planner graphs of the avoid_crossing_perimeters islands between the layers and the object copies
+    // and calculate them by the layer pipeline in advance (enabled by default). The exported G-code is identical in both modes.
+    bool            share_motion_planner_graphs() const { return m_avoid_crossing_perimeters.share_graphs(); }
+    void            set_share_motion_planner_graphs(bool enable) { m_avoid_crossing_perimeters.set_share_graphs(enable); }
+
     // For Perl bindings, to be used exclusively by unit tests.
     unsigned int    layer_count() const { return m_layer_count; }
     void            set_layer_count(unsigned int value) { m_layer_count = value; }
@@ -225,19 +255,48 @@ private:
 
     static std::vector<LayerToPrint>        		                   collect_layers_to_print(const PrintObject &object);
     static std::vector<std::pair<coordf_t, std::vector<LayerToPrint>>> collect_layers_to_print(const Print &print);
-    void            process_layer(
-        // Write into the output file.
-        FILE                            *file,
+
+    // G-code of a single layer produced by process_layer(), handed over to the analyzer, the time estimators and the output file.
+    struct LayerResult {
+        std::string gcode;
+        size_t      layer_id    { size_t(-1) };
+        coordf_t    print_z     { 0. };
+        // Parameters of the extrusions of gcode for the analyzer, see GCodeAnalyzer::process_gcode().
+        std::vector<GCodeAnalyzer::ExtrusionParams> analyzer_extrusion_params;
+        // Memory of the analyzer after it processed this layer, for logging. Captured by the analyzer stage,
+        // as the analyzer already processes the next layer while this one is being written.
+        size_t      analyzer_memory_used { 0 };
+    };
+    // Data of a layer calculated by prepare_layers() in parallel, ahead of the G-code generation of the layer.
+    struct LayerPrepared {
+        // Motion planner graphs of the layers printed together, if avoid_crossing_perimeters is enabled.
+        MotionPlannerGraphPtrs                        mp_graphs;
+        // Distance fields over the layers below the layers printed together, used to place the seams of the perimeters
+        // away from the overhangs. Indexed as the layers printed together, null where there is no perimeter or no layer below.
+        std::vector<std::shared_ptr<EdgeGrid::Grid>>  lower_layer_edge_grids;
+    };
+    LayerResult     process_layer(
         const Print                     &print,
         PrintStatistics                 &print_stat,
         // Set of object & print layers of the same PrintObject and with the same print_z.
         const std::vector<LayerToPrint> &layers,
         const LayerTools  				&layer_tools,
+        // Data precalculated by prepare_layers() for these layers.
+        const LayerPrepared             &prepared,
         // Pairs of PrintObject index and its instance index.
         const std::vector<const PrintInstance*> *ordering,
         // If set to size_t(-1), then print all copies of all objects.
         // Otherwise print a single copy of a single object.
         const size_t                     single_object_idx = size_t(-1));
+    // Generate G-code for num_layers layers by calling generate_layer(layer_idx) in order and write them into the file.
+    // With m_pipelined_export enabled, the generation of a layer overlaps with the analysis, time estimation
+    // and writing of the layers generated before, otherwise the layers are generated and written one by one.
+    // prepare_layer(layer_idx) is called in parallel for the layers ahead of the one being generated,
+    // its result is held until the layer is generated.
+    void            process_layers(FILE *file, const Print &print, size_t num_layers,
+                        std::function<LayerPrepared(size_t)> prepare_layer, std::function<LayerResult(size_t, const LayerPrepared&)> generate_layer);
+    // Calculate the motion planner graphs and the distance fields for the seam placement of the layers printed together.
+    LayerPrepared   prepare_layers(const Print &print, const std::vector<LayerToPrint> &layers);
 
     void            set_last_pos(const Point &pos) { m_last_pos = pos; m_last_pos_defined = true; }
     bool            last_pos_defined() const { return m_last_pos_defined; }
@@ -247,21 +306,21 @@ private:
     std::string     visitor_gcode;
     std::string     visitor_comment;
     double          visitor_speed;
-    std::unique_ptr<EdgeGrid::Grid> *visitor_lower_layer_edge_grid;
+    std::shared_ptr<EdgeGrid::Grid> *visitor_lower_layer_edge_grid;
     virtual void use(const ExtrusionPath &path) override { visitor_gcode += extrude_path(path, visitor_comment, visitor_speed); };
     virtual void use(const ExtrusionPath3D &path3D) override { visitor_gcode += extrude_path_3D(path3D, visitor_comment, visitor_speed); };
     virtual void use(const ExtrusionMultiPath &multipath) override { visitor_gcode += extrude_multi_path(multipath, visitor_comment, visitor_speed); };
     virtual void use(const ExtrusionMultiPath3D &multipath) override { visitor_gcode += extrude_multi_path3D(multipath, visitor_comment, visitor_speed); };
     virtual void use(const ExtrusionLoop &loop) override { visitor_gcode += extrude_loop(loop, visitor_comment, visitor_speed, visitor_lower_layer_edge_grid); };
     virtual void use(const ExtrusionEntityCollection &collection) override;
-    std::string     extrude_entity(const ExtrusionEntity &entity, const std::string &description, double speed = -1., std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid = nullptr);
-    std::string     extrude_loop(const ExtrusionLoop &loop, const std::string &description, double speed = -1., std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid = nullptr);
-    std::string     extrude_loop_vase(const ExtrusionLoop &loop, const std::string &description, double speed = -1., std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid = nullptr);
+    std::string     extrude_entity(const ExtrusionEntity &entity, const std::string &description, double speed = -1., std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid = nullptr);
+    std::string     extrude_loop(const ExtrusionLoop &loop, const std::string &description, double speed = -1., std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid = nullptr);
+    std::string     extrude_loop_vase(const ExtrusionLoop &loop, const std::string &description, double speed = -1., std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid = nullptr);
     std::string     extrude_multi_path(const ExtrusionMultiPath &multipath, const std::string &description, double speed = -1.);
     std::string     extrude_multi_path3D(const ExtrusionMultiPath3D &multipath, const std::string &description, double speed = -1.);
     std::string     extrude_path(const ExtrusionPath &path, const std::string &description, double speed = -1.);
     std::string     extrude_path_3D(const ExtrusionPath3D &path, const std::string &description, double speed = -1.);
-    void            split_at_seam_pos(ExtrusionLoop &loop, std::unique_ptr<EdgeGrid::Grid> *lower_layer_edge_grid);
+    void            split_at_seam_pos(ExtrusionLoop &loop, std::shared_ptr<EdgeGrid::Grid> *lower_layer_edge_grid);
 
     // Extruding multiple objects with soluble / non-soluble / combined supports
     // on a multi-material printer, trying to minimize tool switches.
@@ -326,7 +385,7 @@ private:
 		// For sequential print, the instance of the object to be printing has to be defined.
 		const size_t                     				 single_object_instance_idx);
 
-    std::string     extrude_perimeters(const Print &print, const std::vector<ObjectByExtruder::Island::Region> &by_region, std::unique_ptr<EdgeGrid::Grid> &lower_layer_edge_grid);
+    std::string     extrude_perimeters(const Print &print, const std::vector<ObjectByExtruder::Island::Region> &by_region, std::shared_ptr<EdgeGrid::Grid> &lower_layer_edge_grid);
     std::string     extrude_infill(const Print &print, const std::vector<ObjectByExtruder::Island::Region> &by_region, bool is_infill_first);
     std::string     extrude_support(const ExtrusionEntityCollection &support_fills);
 
@@ -360,7 +419,15 @@ private:
     // Extended markers will be added during G-code generation.
     // The G-code Analyzer will remove these comments from the final G-code.
     bool                                m_enable_analyzer;
+    // Run the layer G-code generation in a pipeline with the analyzer, time estimators and file output.
+    bool                                m_pipelined_export;
+    // Write the exported G-code through m_remaining_times_writer instead of post processing the exported file.
+    bool                                m_single_pass_export;
+    std::unique_ptr<GCodeTimeEstimator::RemainingTimesWriter> m_remaining_times_writer;
     ExtrusionRole                       m_last_analyzer_extrusion_role;
+    // Extrusion parameters of the G-code generated since the last process_layer() or _write(), in the order of their
+    // GCodeAnalyzer::Extrusion_Params_Tag, handed over to the analyzer together with the G-code.
+    std::vector<GCodeAnalyzer::ExtrusionParams> m_analyzer_extrusion_params;
     // How many times will change_layer() be called?
     // change_layer() will update the progress bar.
     unsigned int                        m_layer_count;
@@ -411,6 +478,13 @@ private:
     // Write a string into a file.
     void _write(FILE* file, const std::string& what) { this->_write(file, what.c_str()); }
     void _write(FILE* file, const char *what);
+    // The two halves of _write(), run as separate stages by process_layers().
+    // Pass the G-code through the analyzer, return the G-code to be written.
+    std::string _write_analyze(std::string &&what, const std::vector<GCodeAnalyzer::ExtrusionParams> &extrusion_params);
+    // Feed the analyzed G-code to the time estimators and write it into the file.
+    void _write_analyzed(FILE* file, const std::string &what);
+    // Write into the file (through m_remaining_times_writer if set) without passing the G-code to the analyzer or to the time estimators.
+    void _write_output(FILE* file, const char *what, size_t len);
 
     // Write a string into a file. 
     // Add a newline, if the string does not end with a newline already.
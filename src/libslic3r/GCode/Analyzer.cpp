@@ -7,7 +7,11 @@
 #include "../Utils.hpp"
 #include "Print.hpp"
 
+#include <unordered_map>
+
 #include <boost/log/trivial.hpp>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
 
 #include "Analyzer.hpp"
 #include "PreviewData.hpp"
@@ -32,6 +36,9 @@ const std::string GCodeAnalyzer::Color_Change_Tag = "_ANALYZER_COLOR_CHANGE";
 const std::string GCodeAnalyzer::Pause_Print_Tag = "_ANALYZER_PAUSE_PRINT";
 const std::string GCodeAnalyzer::Custom_Code_Tag = "_ANALYZER_CUSTOM_CODE";
 const std::string GCodeAnalyzer::End_Pause_Print_Or_Custom_Code_Tag = "_ANALYZER_END_PAUSE_PRINT_OR_CUSTOM_CODE";
+const std::string GCodeAnalyzer::Extrusion_Params_Tag = "_ANALYZER_PARAMS";
+// Common prefix of all the tags above.
+static const std::string Analyzer_Tag_Prefix = "_ANALYZER_";
 
 const double GCodeAnalyzer::Default_mm3_per_mm = 0.0;
 const float GCodeAnalyzer::Default_Width = 0.0f;
@@ -108,6 +115,69 @@ GCodeAnalyzer::GCodeMove::GCodeMove(GCodeMove::EType type, const GCodeAnalyzer::
 {
 }
 
+void GCodeAnalyzer::GCodeMovesList::append(const Metadata& data, const Vec2d& extruder_offset, const Vec3d& start_position, const Vec3d& end_position, float delta_extruder)
+{
+    size_t idx = m_end_positions.size();
+    Vec3f start = start_position.cast<float>();
+    if (m_end_positions.empty() || m_end_positions.back() != start)
+        m_start_positions.emplace_back(idx, start);
+    if (m_metadata.empty() || m_metadata.back() != data || m_extruder_offsets.back() != extruder_offset) {
+        m_metadata.emplace_back(data);
+        m_extruder_offsets.emplace_back(extruder_offset);
+        m_metadata_first_move.emplace_back(idx);
+    }
+    if (m_layers.empty() || m_layers.back().z != start.z())
+        m_layers.push_back({ start.z(), idx });
+    m_end_positions.emplace_back(end_position.cast<float>());
+    m_delta_extruder.emplace_back(delta_extruder);
+}
+
+void GCodeAnalyzer::GCodeMovesList::clear()
+{
+    m_end_positions.clear();
+    m_delta_extruder.clear();
+    m_start_positions.clear();
+    m_metadata.clear();
+    m_extruder_offsets.clear();
+    m_metadata_first_move.clear();
+    m_layers.clear();
+}
+
+size_t GCodeAnalyzer::GCodeMovesList::metadata_run(size_t idx) const
+{
+    assert(! m_metadata_first_move.empty() && m_metadata_first_move.front() == 0);
+    return size_t(std::upper_bound(m_metadata_first_move.begin(), m_metadata_first_move.end(), idx) - m_metadata_first_move.begin()) - 1;
+}
+
+size_t GCodeAnalyzer::GCodeMovesList::start_position_lower_bound(size_t idx) const
+{
+    return size_t(std::lower_bound(m_start_positions.begin(), m_start_positions.end(), idx,
+        [](const StartPosition &start, size_t idx) { return start.first < idx; }) - m_start_positions.begin());
+}
+
+GCodeAnalyzer::GCodeMove GCodeAnalyzer::GCodeMovesList::operator[](size_t idx) const
+{
+    assert(idx < this->size());
+    size_t start_idx = this->start_position_lower_bound(idx);
+    size_t run       = this->metadata_run(idx);
+    Vec3d  offset(m_extruder_offsets[run].x(), m_extruder_offsets[run].y(), 0.);
+    Vec3d  start_position = ((start_idx < m_start_positions.size() && m_start_positions[start_idx].first == idx) ?
+        m_start_positions[start_idx].second : m_end_positions[idx - 1]).cast<double>() + offset;
+    return GCodeMove(m_type, m_metadata[run], start_position, m_end_positions[idx].cast<double>() + offset, m_delta_extruder[idx]);
+}
+
+size_t GCodeAnalyzer::GCodeMovesList::memory_used() const
+{
+    return sizeof(*this) + 
+        SLIC3R_STDVEC_MEMSIZE(m_end_positions, Vec3f) +
+        SLIC3R_STDVEC_MEMSIZE(m_delta_extruder, float) +
+        SLIC3R_STDVEC_MEMSIZE(m_start_positions, StartPosition) +
+        SLIC3R_STDVEC_MEMSIZE(m_metadata, Metadata) +
+        SLIC3R_STDVEC_MEMSIZE(m_extruder_offsets, Vec2d) +
+        SLIC3R_STDVEC_MEMSIZE(m_metadata_first_move, size_t) +
+        SLIC3R_STDVEC_MEMSIZE(m_layers, LayerOffset);
+}
+
 void GCodeAnalyzer::set_extruders_count(unsigned int count)
 {
     m_extruders_count = count;
@@ -134,39 +204,59 @@ void GCodeAnalyzer::reset()
     _reset_axes_origin();
     _reset_cached_position();
 
-    m_moves_map.clear();
+    for (size_t type = 0; type < GCodeMove::Num_Types; ++ type)
+        m_moves[type] = GCodeMovesList(GCodeMove::EType(type));
     m_extruder_offsets.clear();
     m_extruders_count = 1;
     m_extruder_color.clear();
 }
 
-const std::string& GCodeAnalyzer::process_gcode(const std::string& gcode)
+const std::string& GCodeAnalyzer::process_gcode(const std::string& gcode, const std::vector<ExtrusionParams>& extrusion_params)
 {
     m_process_output = "";
+    m_extrusion_params = &extrusion_params;
+    m_extrusion_params_next = 0;
 
     m_parser.parse_buffer(gcode,
         [this](GCodeReader& reader, const GCodeReader::GCodeLine& line)
     { this->_process_gcode_line(reader, line); });
 
+    assert(m_extrusion_params_next == extrusion_params.size());
+    m_extrusion_params = nullptr;
     return m_process_output;
 }
 
 void GCodeAnalyzer::calc_gcode_preview_data(GCodePreviewData& preview_data, std::function<void()> cancel_callback)
 {
+    // The callback defaults to an empty function, which would throw std::bad_function_call.
+    if (! cancel_callback)
+        cancel_callback = [](){};
+
     // resets preview data
     preview_data.reset();
 
-    // calculates extrusion layers
-    _calc_gcode_preview_extrusion_layers(preview_data, cancel_callback);
-
-    // calculates travel
-    _calc_gcode_preview_travel(preview_data, cancel_callback);
+    // The passes fill in different parts of preview_data, only the ranges are shared, thus each pass updates its own copy.
+    GCodePreviewData::Ranges extrusion_ranges;
+    GCodePreviewData::Ranges travel_ranges;
+    tbb::parallel_invoke(
+        // calculates extrusion layers
+        [this, &preview_data, &extrusion_ranges, &cancel_callback]() { _calc_gcode_preview_extrusion_layers(preview_data, extrusion_ranges, cancel_callback); },
+        // calculates travel
+        [this, &preview_data, &travel_ranges, &cancel_callback]() { _calc_gcode_preview_travel(preview_data, travel_ranges, cancel_callback); },
+        // calculates retractions
+        [this, &preview_data, &cancel_callback]() { _calc_gcode_preview_retractions(preview_data, cancel_callback); },
+        // calculates unretractions
+        [this, &preview_data, &cancel_callback]() { _calc_gcode_preview_unretractions(preview_data, cancel_callback); });
 
-    // calculates retractions
-    _calc_gcode_preview_retractions(preview_data, cancel_callback);
-
-    // calculates unretractions
-    _calc_gcode_preview_unretractions(preview_data, cancel_callback);
+    // updates preview ranges data
+    for (const GCodePreviewData::Ranges *ranges : { &extrusion_ranges, &travel_ranges })
+    {
+        preview_data.ranges.height.update_from(ranges->height);
+        preview_data.ranges.width.update_from(ranges->width);
+        preview_data.ranges.feedrate.update_from(ranges->feedrate);
+        preview_data.ranges.volumetric_rate.update_from(ranges->volumetric_rate);
+        preview_data.ranges.fan_speed.update_from(ranges->fan_speed);
+    }
 }
 
 bool GCodeAnalyzer::is_valid_extrusion_role(ExtrusionRole role)
@@ -181,7 +271,8 @@ void GCodeAnalyzer::_process_gcode_line(GCodeReader&, const GCodeReader::GCodeLi
     {
 #if 0
         // DEBUG ONLY: puts the line back into the gcode
-        m_process_output += line.raw() + "\n";
+        m_process_output += line.raw();
+        m_process_output += '\n';
 #endif
         return;
     }
@@ -191,7 +282,7 @@ void GCodeAnalyzer::_process_gcode_line(GCodeReader&, const GCodeReader::GCodeLi
     _set_start_extrusion(_get_axis_position(E));
 
     // processes 'normal' gcode lines
-    std::string cmd = line.cmd();
+    std::string_view cmd = line.cmd();
     if (cmd.length() > 1)
     {
         switch (::toupper(cmd[0]))
@@ -304,7 +395,8 @@ void GCodeAnalyzer::_process_gcode_line(GCodeReader&, const GCodeReader::GCodeLi
     }
 
     // puts the line back into the gcode
-    m_process_output += line.raw() + "\n";
+    m_process_output += line.raw();
+    m_process_output += '\n';
 }
 
 void GCodeAnalyzer::_processG1(const GCodeReader::GCodeLine& line)
@@ -493,7 +585,7 @@ void GCodeAnalyzer::_processM108orM135(const GCodeReader::GCodeLine& line)
     if ((code == 108 && m_gcode_flavor == gcfSailfish)
         || (code == 135 && m_gcode_flavor == gcfMakerWare)) {
 
-        std::string cmd = line.raw();
+        std::string cmd(line.raw());
         size_t T_pos = cmd.find("T");
         if (T_pos != std::string::npos) {
             cmd = cmd.substr(T_pos);
@@ -602,15 +694,27 @@ void GCodeAnalyzer::_processT(const std::string& cmd)
 
 void GCodeAnalyzer::_processT(const GCodeReader::GCodeLine& line)
 {
-    _processT(line.cmd());
+    _processT(std::string(line.cmd()));
 }
 
 bool GCodeAnalyzer::_process_tags(const GCodeReader::GCodeLine& line)
 {
-    std::string comment = line.comment();
+    std::string_view comment = line.comment();
+
+    // most comments are not tags
+    if (comment.find(Analyzer_Tag_Prefix) == comment.npos)
+        return false;
+
+    // extrusion parameters tag
+    size_t pos = comment.find(Extrusion_Params_Tag);
+    if (pos != comment.npos)
+    {
+        _process_extrusion_params_tag();
+        return true;
+    }
 
     // extrusion role tag
-    size_t pos = comment.find(Extrusion_Role_Tag);
+    pos = comment.find(Extrusion_Role_Tag);
     if (pos != comment.npos)
     {
         _process_extrusion_role_tag(comment, pos);
@@ -646,7 +750,7 @@ bool GCodeAnalyzer::_process_tags(const GCodeReader::GCodeLine& line)
     if (pos != comment.npos)
     {
         pos = comment.find_last_of(",T");
-        int extruder = pos == comment.npos ? 0 : std::atoi(comment.substr(pos + 1, comment.npos).c_str());
+        int extruder = pos == comment.npos ? 0 : std::atoi(comment.data() + pos + 1);
         _process_color_change_tag(extruder);
         return true;
     }
@@ -678,9 +782,9 @@ bool GCodeAnalyzer::_process_tags(const GCodeReader::GCodeLine& line)
     return false;
 }
 
-void GCodeAnalyzer::_process_extrusion_role_tag(const std::string& comment, size_t pos)
+void GCodeAnalyzer::_process_extrusion_role_tag(std::string_view comment, size_t pos)
 {
-    int role = (int)::strtol(comment.substr(pos + Extrusion_Role_Tag.length()).c_str(), nullptr, 10);
+    int role = (int)::strtol(comment.data() + pos + Extrusion_Role_Tag.length(), nullptr, 10);
     if (_is_valid_extrusion_role(role))
         _set_extrusion_role((ExtrusionRole)role);
     else
@@ -689,19 +793,32 @@ void GCodeAnalyzer::_process_extrusion_role_tag(const std::string& comment, size
     }
 }
 
-void GCodeAnalyzer::_process_mm3_per_mm_tag(const std::string& comment, size_t pos)
+void GCodeAnalyzer::_process_mm3_per_mm_tag(std::string_view comment, size_t pos)
 {
-    _set_mm3_per_mm(::strtod(comment.substr(pos + Mm3_Per_Mm_Tag.length()).c_str(), nullptr));
+    _set_mm3_per_mm(::strtod(comment.data() + pos + Mm3_Per_Mm_Tag.length(), nullptr));
 }
 
-void GCodeAnalyzer::_process_width_tag(const std::string& comment, size_t pos)
+void GCodeAnalyzer::_process_width_tag(std::string_view comment, size_t pos)
 {
-    _set_width((float)::strtod(comment.substr(pos + Width_Tag.length()).c_str(), nullptr));
+    _set_width((float)::strtod(comment.data() + pos + Width_Tag.length(), nullptr));
 }
 
-void GCodeAnalyzer::_process_height_tag(const std::string& comment, size_t pos)
+void GCodeAnalyzer::_process_height_tag(std::string_view comment, size_t pos)
 {
-    _set_height((float)::strtod(comment.substr(pos + Height_Tag.length()).c_str(), nullptr));
+    _set_height((float)::strtod(comment.data() + pos + Height_Tag.length(), nullptr));
+}
+
+void GCodeAnalyzer::_process_extrusion_params_tag()
+{
+    if (m_extrusion_params == nullptr || m_extrusion_params_next == m_extrusion_params->size())
+        // Tag without parameters, for example in a gcode exported before.
+        return;
+    const ExtrusionParams &params = (*m_extrusion_params)[m_extrusion_params_next ++];
+    if (_is_valid_extrusion_role(int(params.extrusion_role)))
+        _set_extrusion_role(params.extrusion_role);
+    _set_mm3_per_mm(params.mm3_per_mm);
+    _set_width(params.width);
+    _set_height(params.height);
 }
 
 void GCodeAnalyzer::_process_color_change_tag(int extruder)
@@ -907,21 +1024,15 @@ Vec3d GCodeAnalyzer::_get_end_position() const
 
 void GCodeAnalyzer::_store_move(GCodeAnalyzer::GCodeMove::EType type)
 {
-    // if type non mapped yet, map it
-    TypeToMovesMap::iterator it = m_moves_map.find(type);
-    if (it == m_moves_map.end())
-        it = m_moves_map.insert(TypeToMovesMap::value_type(type, GCodeMovesList())).first;
-
-    // store move
-    Vec3d extruder_offset = Vec3d::Zero();
+    // store move, the extruder offset is applied by the moves list
+    Vec2d extruder_offset = Vec2d::Zero();
     unsigned int extruder_id = _get_extruder_id();
     ExtruderOffsetsMap::iterator extr_it = m_extruder_offsets.find(extruder_id);
     if (extr_it != m_extruder_offsets.end())
-        extruder_offset = Vec3d(extr_it->second(0), extr_it->second(1), 0.0);
+        extruder_offset = extr_it->second;
 
-    Vec3d start_position = _get_start_position() + extruder_offset;
-    Vec3d end_position = _get_end_position() + extruder_offset;
-    it->second.emplace_back(type, _get_extrusion_role(), extruder_id, _get_mm3_per_mm(), _get_width(), _get_height(), _get_feedrate(), start_position, end_position, _get_delta_extrusion(), _get_fan_speed(), _get_cp_color_id());
+    m_moves[type].append(Metadata(_get_extrusion_role(), extruder_id, _get_mm3_per_mm(), _get_width(), _get_height(), _get_feedrate(), _get_fan_speed(), _get_cp_color_id()), 
+        extruder_offset, _get_start_position(), _get_end_position(), _get_delta_extrusion());
 }
 
 bool GCodeAnalyzer::_is_valid_extrusion_role(int value) const
@@ -929,38 +1040,57 @@ bool GCodeAnalyzer::_is_valid_extrusion_role(int value) const
     return ((int)erNone <= value) && (value <= (int)erMixed);
 }
 
-void GCodeAnalyzer::_calc_gcode_preview_extrusion_layers(GCodePreviewData& preview_data, std::function<void()> cancel_callback)
+// Splits the moves into ranges of whole layers of at least min_moves moves, to be processed by parallel tasks.
+static std::vector<std::pair<size_t, size_t>> split_moves_by_layers(const GCodeAnalyzer::GCodeMovesList& moves, size_t min_moves)
 {
-    struct Helper
-    {
-        static GCodePreviewData::Extrusion::Layer& get_layer_at_z(GCodePreviewData::Extrusion::LayersList& layers, float z)
+    std::vector<std::pair<size_t, size_t>> out;
+    size_t begin = 0;
+    for (const GCodeAnalyzer::GCodeMovesList::LayerOffset& layer : moves.layers())
+        if (layer.first_move >= begin + min_moves)
         {
-            //FIXME this has a terrible time complexity
-            for (GCodePreviewData::Extrusion::Layer& layer : layers)
-            {
-                // if layer found, return it
-                if (layer.z == z)
-                    return layer;
-            }
+            out.emplace_back(begin, layer.first_move);
+            begin = layer.first_move;
+        }
+    if (begin < moves.size())
+        out.emplace_back(begin, moves.size());
+    return out;
+}
 
-            // if layer not found, create and return it
+void GCodeAnalyzer::_calc_gcode_preview_extrusion_layers(GCodePreviewData& preview_data, GCodePreviewData::Ranges& ranges, std::function<void()> cancel_callback)
+{
+    // Layers and ranges produced by a single task.
+    struct Chunk
+    {
+        GCodePreviewData::Extrusion::LayersList layers;
+        GCodePreviewData::Range height_range;
+        GCodePreviewData::Range width_range;
+        GCodePreviewData::MultiRange<GCodePreviewData::FeedrateKind> feedrate_range;
+        GCodePreviewData::Range volumetric_rate_range;
+        GCodePreviewData::Range fan_speed_range;
+
+        GCodePreviewData::Extrusion::Layer& get_layer_at_z(float z)
+        {
+            // A chunk contains a few layers only, mostly the last one is hit.
+            for (auto it = layers.rbegin(); it != layers.rend(); ++ it)
+                if (it->z == z)
+                    return *it;
             layers.emplace_back(z, GCodePreviewData::Extrusion::Paths());
             return layers.back();
         }
 
-        static void store_polyline(const Polyline& polyline, const Metadata& data, float z, GCodePreviewData& preview_data)
+        void store_polyline(const Polyline& polyline, const Metadata& data, float z)
         {
             // if the polyline is valid, create the extrusion path from it and store it
             if (polyline.is_valid())
             {
-				auto& paths = get_layer_at_z(preview_data.extrusion.layers, z).paths;
-				paths.emplace_back(GCodePreviewData::Extrusion::Path());
-				GCodePreviewData::Extrusion::Path &path = paths.back();
+                auto& paths = this->get_layer_at_z(z).paths;
+                paths.emplace_back(GCodePreviewData::Extrusion::Path());
+                GCodePreviewData::Extrusion::Path &path = paths.back();
                 path.polyline = polyline;
-				path.extrusion_role = data.extrusion_role;
-				path.mm3_per_mm = float(data.mm3_per_mm);
-				path.width = data.width;
-				path.height = data.height;
+                path.extrusion_role = data.extrusion_role;
+                path.mm3_per_mm = float(data.mm3_per_mm);
+                path.width = data.width;
+                path.height = data.height;
                 path.feedrate = data.feedrate;
                 path.extruder_id = data.extruder_id;
                 path.cp_color_id = data.cp_color_id;
@@ -969,174 +1099,221 @@ void GCodeAnalyzer::_calc_gcode_preview_extrusion_layers(GCodePreviewData& previ
         }
     };
 
-    TypeToMovesMap::iterator extrude_moves = m_moves_map.find(GCodeMove::Extrude);
-    if (extrude_moves == m_moves_map.end())
+    const GCodeMovesList &extrude_moves = m_moves[GCodeMove::Extrude];
+    if (extrude_moves.empty())
         return;
 
-    Metadata data;
-    float z = FLT_MAX;
-    Polyline polyline;
-    Vec3d position(FLT_MAX, FLT_MAX, FLT_MAX);
-    float volumetric_rate = FLT_MAX;
-    GCodePreviewData::Range height_range;
-    GCodePreviewData::Range width_range;
-    GCodePreviewData::MultiRange<GCodePreviewData::FeedrateKind> feedrate_range;
-    GCodePreviewData::Range volumetric_rate_range;
-    GCodePreviewData::Range fan_speed_range;
+    // A polyline never continues over a change of z, thus the chunks of whole layers produce the same paths
+    // as a single pass over all the moves.
+    std::vector<std::pair<size_t, size_t>> move_ranges = split_moves_by_layers(extrude_moves, m_preview_min_moves_per_task);
+    std::vector<Chunk> chunks(move_ranges.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1),
+        [&extrude_moves, &move_ranges, &chunks, &cancel_callback](const tbb::blocked_range<size_t>& range) {
+        for (size_t chunk_id = range.begin(); chunk_id < range.end(); ++ chunk_id)
+        {
+            Chunk &chunk = chunks[chunk_id];
+            Metadata data;
+            float z = FLT_MAX;
+            Polyline polyline;
+            Vec3d position(FLT_MAX, FLT_MAX, FLT_MAX);
+            float volumetric_rate = FLT_MAX;
+
+            // to avoid to call the callback too often
+            unsigned int cancel_callback_threshold = (unsigned int)std::max((int)(move_ranges[chunk_id].second - move_ranges[chunk_id].first) / 25, 1);
+            unsigned int cancel_callback_curr = 0;
+
+            // constructs the polylines while traversing the moves
+            extrude_moves.for_each(move_ranges[chunk_id].first, move_ranges[chunk_id].second, [&](const GCodeMove& move)
+            {
+                // to avoid to call the callback too often
+                cancel_callback_curr = (cancel_callback_curr + 1) % cancel_callback_threshold;
+                if (cancel_callback_curr == 0)
+                    cancel_callback();
 
-    // to avoid to call the callback too often
-    unsigned int cancel_callback_threshold = (unsigned int)std::max((int)extrude_moves->second.size() / 25, 1);
-    unsigned int cancel_callback_curr = 0;
+                if ((data != move.data) || (z != move.start_position.z()) || (position != move.start_position) || (volumetric_rate != move.data.feedrate * (float)move.data.mm3_per_mm))
+                {
+                    // store current polyline
+                    polyline.remove_duplicate_points();
+                    chunk.store_polyline(polyline, data, z);
+
+                    // reset current polyline
+                    polyline = Polyline();
+
+                    // add both vertices of the move
+                    polyline.append(Point(scale_(move.start_position.x()), scale_(move.start_position.y())));
+                    polyline.append(Point(scale_(move.end_position.x()), scale_(move.end_position.y())));
+
+                    // update current values
+                    data = move.data;
+                    z = (float)move.start_position.z();
+                    volumetric_rate = move.data.feedrate * (float)move.data.mm3_per_mm;
+                    chunk.height_range.update_from(move.data.height);
+                    chunk.width_range.update_from(move.data.width);
+                    chunk.feedrate_range.update_from(move.data.feedrate, GCodePreviewData::FeedrateKind::EXTRUSION);
+                    chunk.volumetric_rate_range.update_from(volumetric_rate);
+                    chunk.fan_speed_range.update_from(move.data.fan_speed);
+                }
+                else
+                    // append end vertex of the move to current polyline
+                    polyline.append(Point(scale_(move.end_position.x()), scale_(move.end_position.y())));
 
-    // constructs the polylines while traversing the moves
-    for (const GCodeMove& move : extrude_moves->second)
-    {
-        // to avoid to call the callback too often
-        cancel_callback_curr = (cancel_callback_curr + 1) % cancel_callback_threshold;
-        if (cancel_callback_curr == 0)
-            cancel_callback();
+                // update current values
+                position = move.end_position;
+            });
 
-        if ((data != move.data) || (z != move.start_position.z()) || (position != move.start_position) || (volumetric_rate != move.data.feedrate * (float)move.data.mm3_per_mm))
-        {
-            // store current polyline
+            // store last polyline
             polyline.remove_duplicate_points();
-            Helper::store_polyline(polyline, data, z, preview_data);
-
-            // reset current polyline
-            polyline = Polyline();
-
-            // add both vertices of the move
-            polyline.append(Point(scale_(move.start_position.x()), scale_(move.start_position.y())));
-            polyline.append(Point(scale_(move.end_position.x()), scale_(move.end_position.y())));
-
-            // update current values
-            data = move.data;
-            z = (float)move.start_position.z();
-            volumetric_rate = move.data.feedrate * (float)move.data.mm3_per_mm;
-            height_range.update_from(move.data.height);
-            width_range.update_from(move.data.width);
-            feedrate_range.update_from(move.data.feedrate, GCodePreviewData::FeedrateKind::EXTRUSION);
-            volumetric_rate_range.update_from(volumetric_rate);
-            fan_speed_range.update_from(move.data.fan_speed);
+            chunk.store_polyline(polyline, data, z);
         }
-        else
-            // append end vertex of the move to current polyline
-            polyline.append(Point(scale_(move.end_position.x()), scale_(move.end_position.y())));
+    });
 
-        // update current values
-        position = move.end_position;
+    // merges the chunks in their order, so the paths of each layer keep the order of the moves
+    GCodePreviewData::Extrusion::LayersList &layers = preview_data.extrusion.layers;
+    std::unordered_map<float, size_t> layer_of_z;
+    for (Chunk &chunk : chunks)
+    {
+        for (GCodePreviewData::Extrusion::Layer &layer : chunk.layers)
+        {
+            auto it = layer_of_z.find(layer.z);
+            if (it == layer_of_z.end())
+            {
+                layer_of_z.emplace(layer.z, layers.size());
+                layers.emplace_back(std::move(layer));
+            }
+            else
+            {
+                GCodePreviewData::Extrusion::Paths &paths = layers[it->second].paths;
+                paths.insert(paths.end(), std::make_move_iterator(layer.paths.begin()), std::make_move_iterator(layer.paths.end()));
+            }
+        }
+        ranges.height.update_from(chunk.height_range);
+        ranges.width.update_from(chunk.width_range);
+        ranges.feedrate.update_from(chunk.feedrate_range);
+        ranges.volumetric_rate.update_from(chunk.volumetric_rate_range);
+        ranges.fan_speed.update_from(chunk.fan_speed_range);
     }
 
-    // store last polyline
-    polyline.remove_duplicate_points();
-    Helper::store_polyline(polyline, data, z, preview_data);
-
-    // updates preview ranges data
-    preview_data.ranges.height.update_from(height_range);
-    preview_data.ranges.width.update_from(width_range);
-    preview_data.ranges.feedrate.update_from(feedrate_range);
-    preview_data.ranges.volumetric_rate.update_from(volumetric_rate_range);
-    preview_data.ranges.fan_speed.update_from(fan_speed_range);
-
     // we need to sort the layers by their z as they can be shuffled in case of sequential prints
-    std::sort(preview_data.extrusion.layers.begin(), preview_data.extrusion.layers.end(), [](const GCodePreviewData::Extrusion::Layer& l1, const GCodePreviewData::Extrusion::Layer& l2)->bool { return l1.z < l2.z; });
+    std::sort(layers.begin(), layers.end(), [](const GCodePreviewData::Extrusion::Layer& l1, const GCodePreviewData::Extrusion::Layer& l2)->bool { return l1.z < l2.z; });
 }
 
-void GCodeAnalyzer::_calc_gcode_preview_travel(GCodePreviewData& preview_data, std::function<void()> cancel_callback)
+void GCodeAnalyzer::_calc_gcode_preview_travel(GCodePreviewData& preview_data, GCodePreviewData::Ranges& ranges, std::function<void()> cancel_callback)
 {
-    struct Helper
+    // Polylines and ranges produced by a single task.
+    struct Chunk
     {
-        static void store_polyline(const Polyline3& polyline, GCodePreviewData::Travel::EType type, GCodePreviewData::Travel::Polyline::EDirection direction, 
-            float feedrate, unsigned int extruder_id, GCodePreviewData& preview_data)
+        std::vector<GCodePreviewData::Travel::Polyline> polylines;
+        GCodePreviewData::Range height_range;
+        GCodePreviewData::Range width_range;
+        GCodePreviewData::MultiRange<GCodePreviewData::FeedrateKind> feedrate_range;
+
+        void store_polyline(const Polyline3& polyline, GCodePreviewData::Travel::EType type, GCodePreviewData::Travel::Polyline::EDirection direction,
+            float feedrate, unsigned int extruder_id)
         {
             // if the polyline is valid, store it
             if (polyline.is_valid())
-                preview_data.travel.polylines.emplace_back(type, direction, feedrate, extruder_id, polyline);
+                polylines.emplace_back(type, direction, feedrate, extruder_id, polyline);
         }
     };
 
-    TypeToMovesMap::iterator travel_moves = m_moves_map.find(GCodeMove::Move);
-    if (travel_moves == m_moves_map.end())
+    const GCodeMovesList &travel_moves = m_moves[GCodeMove::Move];
+    if (travel_moves.empty())
         return;
 
-    Polyline3 polyline;
-    Vec3d position(FLT_MAX, FLT_MAX, FLT_MAX);
-    GCodePreviewData::Travel::EType type = GCodePreviewData::Travel::Num_Types;
-    GCodePreviewData::Travel::Polyline::EDirection direction = GCodePreviewData::Travel::Polyline::Num_Directions;
-    float feedrate = FLT_MAX;
-    unsigned int extruder_id = -1;
-
-    GCodePreviewData::Range height_range;
-    GCodePreviewData::Range width_range;
-    GCodePreviewData::MultiRange<GCodePreviewData::FeedrateKind> feedrate_range;
+    // The direction of the current polyline is not tracked, thus a polyline is started by every move
+    // and the chunks produce the same polylines as a single pass over all the moves.
+    std::vector<std::pair<size_t, size_t>> move_ranges = split_moves_by_layers(travel_moves, m_preview_min_moves_per_task);
+    std::vector<Chunk> chunks(move_ranges.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1),
+        [&travel_moves, &move_ranges, &chunks, &cancel_callback](const tbb::blocked_range<size_t>& range) {
+        for (size_t chunk_id = range.begin(); chunk_id < range.end(); ++ chunk_id)
+        {
+            Chunk &chunk = chunks[chunk_id];
+            Polyline3 polyline;
+            Vec3d position(FLT_MAX, FLT_MAX, FLT_MAX);
+            GCodePreviewData::Travel::EType type = GCodePreviewData::Travel::Num_Types;
+            GCodePreviewData::Travel::Polyline::EDirection direction = GCodePreviewData::Travel::Polyline::Num_Directions;
+            float feedrate = FLT_MAX;
+            unsigned int extruder_id = -1;
+
+            // to avoid to call the callback too often
+            unsigned int cancel_callback_threshold = (unsigned int)std::max((int)(move_ranges[chunk_id].second - move_ranges[chunk_id].first) / 25, 1);
+            unsigned int cancel_callback_curr = 0;
+
+            // constructs the polylines while traversing the moves
+            travel_moves.for_each(move_ranges[chunk_id].first, move_ranges[chunk_id].second, [&](const GCodeMove& move)
+            {
+                cancel_callback_curr = (cancel_callback_curr + 1) % cancel_callback_threshold;
+                if (cancel_callback_curr == 0)
+                    cancel_callback();
 
-    // to avoid to call the callback too often
-    unsigned int cancel_callback_threshold = (unsigned int)std::max((int)travel_moves->second.size() / 25, 1);
-    unsigned int cancel_callback_curr = 0;
+                GCodePreviewData::Travel::EType move_type = (move.delta_extruder < 0.0f) ? GCodePreviewData::Travel::Retract : ((move.delta_extruder > 0.0f) ? GCodePreviewData::Travel::Extrude : GCodePreviewData::Travel::Move);
+                GCodePreviewData::Travel::Polyline::EDirection move_direction = ((move.start_position.x() != move.end_position.x()) || (move.start_position.y() != move.end_position.y())) ? GCodePreviewData::Travel::Polyline::Generic : GCodePreviewData::Travel::Polyline::Vertical;
 
-    // constructs the polylines while traversing the moves
-    for (const GCodeMove& move : travel_moves->second)
-    {
-        cancel_callback_curr = (cancel_callback_curr + 1) % cancel_callback_threshold;
-        if (cancel_callback_curr == 0)
-            cancel_callback();
+                if ((type != move_type) || (direction != move_direction) || (feedrate != move.data.feedrate) || (position != move.start_position) || (extruder_id != move.data.extruder_id))
+                {
+                    // store current polyline
+                    polyline.remove_duplicate_points();
+                    chunk.store_polyline(polyline, type, direction, feedrate, extruder_id);
 
-        GCodePreviewData::Travel::EType move_type = (move.delta_extruder < 0.0f) ? GCodePreviewData::Travel::Retract : ((move.delta_extruder > 0.0f) ? GCodePreviewData::Travel::Extrude : GCodePreviewData::Travel::Move);
-        GCodePreviewData::Travel::Polyline::EDirection move_direction = ((move.start_position.x() != move.end_position.x()) || (move.start_position.y() != move.end_position.y())) ? GCodePreviewData::Travel::Polyline::Generic : GCodePreviewData::Travel::Polyline::Vertical;
+                    // reset current polyline
+                    polyline = Polyline3();
 
-        if ((type != move_type) || (direction != move_direction) || (feedrate != move.data.feedrate) || (position != move.start_position) || (extruder_id != move.data.extruder_id))
-        {
-            // store current polyline
+                    // add both vertices of the move
+                    polyline.append(Vec3crd((int)scale_(move.start_position.x()), (int)scale_(move.start_position.y()), (int)scale_(move.start_position.z())));
+                    polyline.append(Vec3crd((int)scale_(move.end_position.x()), (int)scale_(move.end_position.y()), (int)scale_(move.end_position.z())));
+                }
+                else
+                    // append end vertex of the move to current polyline
+                    polyline.append(Vec3crd((int)scale_(move.end_position.x()), (int)scale_(move.end_position.y()), (int)scale_(move.end_position.z())));
+
+                // update current values
+                position = move.end_position;
+                type = move_type;
+                feedrate = move.data.feedrate;
+                extruder_id = move.data.extruder_id;
+                chunk.height_range.update_from(move.data.height);
+                chunk.width_range.update_from(move.data.width);
+                chunk.feedrate_range.update_from(move.data.feedrate, GCodePreviewData::FeedrateKind::TRAVEL);
+            });
+
+            // store last polyline
             polyline.remove_duplicate_points();
-            Helper::store_polyline(polyline, type, direction, feedrate, extruder_id, preview_data);
-
-            // reset current polyline
-            polyline = Polyline3();
-
-            // add both vertices of the move
-            polyline.append(Vec3crd((int)scale_(move.start_position.x()), (int)scale_(move.start_position.y()), (int)scale_(move.start_position.z())));
-            polyline.append(Vec3crd((int)scale_(move.end_position.x()), (int)scale_(move.end_position.y()), (int)scale_(move.end_position.z())));
+            chunk.store_polyline(polyline, type, direction, feedrate, extruder_id);
         }
-        else
-            // append end vertex of the move to current polyline
-            polyline.append(Vec3crd((int)scale_(move.end_position.x()), (int)scale_(move.end_position.y()), (int)scale_(move.end_position.z())));
-
-        // update current values
-        position = move.end_position;
-        type = move_type;
-        feedrate = move.data.feedrate;
-        extruder_id = move.data.extruder_id;
-        height_range.update_from(move.data.height);
-        width_range.update_from(move.data.width);
-        feedrate_range.update_from(move.data.feedrate, GCodePreviewData::FeedrateKind::TRAVEL);
+    });
+
+    // merges the chunks in their order
+    std::vector<GCodePreviewData::Travel::Polyline> &polylines = preview_data.travel.polylines;
+    size_t num_polylines = 0;
+    for (const Chunk &chunk : chunks)
+        num_polylines += chunk.polylines.size();
+    polylines.reserve(polylines.size() + num_polylines);
+    for (Chunk &chunk : chunks)
+    {
+        polylines.insert(polylines.end(), std::make_move_iterator(chunk.polylines.begin()), std::make_move_iterator(chunk.polylines.end()));
+        ranges.height.update_from(chunk.height_range);
+        ranges.width.update_from(chunk.width_range);
+        ranges.feedrate.update_from(chunk.feedrate_range);
     }
 
-    // store last polyline
-    polyline.remove_duplicate_points();
-    Helper::store_polyline(polyline, type, direction, feedrate, extruder_id, preview_data);
-
-    // updates preview ranges data
-    preview_data.ranges.height.update_from(height_range);
-    preview_data.ranges.width.update_from(width_range);
-    preview_data.ranges.feedrate.update_from(feedrate_range);
-
     // we need to sort the polylines by their min z as they can be shuffled in case of sequential prints
-    std::sort(preview_data.travel.polylines.begin(), preview_data.travel.polylines.end(),
+    std::sort(polylines.begin(), polylines.end(),
         [](const GCodePreviewData::Travel::Polyline& p1, const GCodePreviewData::Travel::Polyline& p2)->bool
     { return unscale<double>(p1.polyline.bounding_box().min(2)) < unscale<double>(p2.polyline.bounding_box().min(2)); });
 }
 
 void GCodeAnalyzer::_calc_gcode_preview_retractions(GCodePreviewData& preview_data, std::function<void()> cancel_callback)
 {
-    TypeToMovesMap::iterator retraction_moves = m_moves_map.find(GCodeMove::Retract);
-    if (retraction_moves == m_moves_map.end())
+    const GCodeMovesList &retraction_moves = m_moves[GCodeMove::Retract];
+    if (retraction_moves.empty())
         return;
 
     // to avoid to call the callback too often
-    unsigned int cancel_callback_threshold = (unsigned int)std::max((int)retraction_moves->second.size() / 25, 1);
+    unsigned int cancel_callback_threshold = (unsigned int)std::max((int)retraction_moves.size() / 25, 1);
     unsigned int cancel_callback_curr = 0;
 
-    for (const GCodeMove& move : retraction_moves->second)
+    retraction_moves.for_each([&](const GCodeMove& move)
     {
         cancel_callback_curr = (cancel_callback_curr + 1) % cancel_callback_threshold;
         if (cancel_callback_curr == 0)
@@ -1145,7 +1322,7 @@ void GCodeAnalyzer::_calc_gcode_preview_retractions(GCodePreviewData& preview_da
         // store position
         Vec3crd position((int)scale_(move.start_position.x()), (int)scale_(move.start_position.y()), (int)scale_(move.start_position.z()));
         preview_data.retraction.positions.emplace_back(position, move.data.width, move.data.height);
-    }
+    });
 
     // we need to sort the positions by their z as they can be shuffled in case of sequential prints
     std::sort(preview_data.retraction.positions.begin(), preview_data.retraction.positions.end(),
@@ -1155,15 +1332,15 @@ void GCodeAnalyzer::_calc_gcode_preview_retractions(GCodePreviewData& preview_da
 
 void GCodeAnalyzer::_calc_gcode_preview_unretractions(GCodePreviewData& preview_data, std::function<void()> cancel_callback)
 {
-    TypeToMovesMap::iterator unretraction_moves = m_moves_map.find(GCodeMove::Unretract);
-    if (unretraction_moves == m_moves_map.end())
+    const GCodeMovesList &unretraction_moves = m_moves[GCodeMove::Unretract];
+    if (unretraction_moves.empty())
         return;
 
     // to avoid to call the callback too often
-    unsigned int cancel_callback_threshold = (unsigned int)std::max((int)unretraction_moves->second.size() / 25, 1);
+    unsigned int cancel_callback_threshold = (unsigned int)std::max((int)unretraction_moves.size() / 25, 1);
     unsigned int cancel_callback_curr = 0;
 
-    for (const GCodeMove& move : unretraction_moves->second)
+    unretraction_moves.for_each([&](const GCodeMove& move)
     {
         cancel_callback_curr = (cancel_callback_curr + 1) % cancel_callback_threshold;
         if (cancel_callback_curr == 0)
@@ -1172,7 +1349,7 @@ void GCodeAnalyzer::_calc_gcode_preview_unretractions(GCodePreviewData& preview_
         // store position
         Vec3crd position((int)scale_(move.start_position.x()), (int)scale_(move.start_position.y()), (int)scale_(move.start_position.z()));
         preview_data.unretraction.positions.emplace_back(position, move.data.width, move.data.height);
-    }
+    });
 
     // we need to sort the positions by their z as they can be shuffled in case of sequential prints
     std::sort(preview_data.unretraction.positions.begin(), preview_data.unretraction.positions.end(),
@@ -1184,8 +1361,8 @@ void GCodeAnalyzer::_calc_gcode_preview_unretractions(GCodePreviewData& preview_
 size_t GCodeAnalyzer::memory_used() const
 {
     size_t out = sizeof(*this);
-    for (const std::pair<GCodeMove::EType, GCodeMovesList> &kvp : m_moves_map)
-        out += sizeof(kvp) + SLIC3R_STDVEC_MEMSIZE(kvp.second, GCodeMove);
+    for (const GCodeMovesList &moves : m_moves)
+        out += moves.memory_used() - sizeof(moves);
     out += m_process_output.size();
     return out;
 }
@@ -1211,7 +1388,7 @@ const std::string& FanMover::process_gcode(const std::string& gcode) {
 void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCodeLine& line)
 {
     // processes 'normal' gcode lines
-    std::string cmd = line.cmd();
+    std::string_view cmd = line.cmd();
     double time = 0;
     float fan_speed = -1;
     if (cmd.length() > 1) {
@@ -1257,9 +1434,11 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                             if (with_D_option) {
                                 std::stringstream ss;
                                 ss << " D" << (uint32_t)(buffer_time_size * 1000) << "\n";
-                                m_process_output += line.raw() + ss.str();
+                                m_process_output += line.raw();
+                                m_process_output += ss.str();
                             } else {
-                                m_process_output += line.raw() + "\n";
+                                m_process_output += line.raw();
+                                m_process_output += '\n';
                             }
                             current_fan_speed = fan_speed;
                         }
@@ -1275,7 +1454,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
     }
 
     if (time >= 0) {
-        buffer.emplace_front(BufferData(line.raw(), time, fan_speed));
+        buffer.emplace_front(BufferData(std::string(line.raw()), time, fan_speed));
         buffer_time_size += time;
     }
     // puts the line back into the gcode
@@ -7,12 +7,11 @@
 
 #include "../Point.hpp"
 #include "../GCodeReader.hpp"
+#include "PreviewData.hpp"
 #include <regex>
 
 namespace Slic3r {
 
-class GCodePreviewData;
-
 class GCodeAnalyzer
 {
 public:
@@ -24,6 +23,7 @@ public:
     static const std::string Pause_Print_Tag;
     static const std::string Custom_Code_Tag;
     static const std::string End_Pause_Print_Or_Custom_Code_Tag;
+    static const std::string Extrusion_Params_Tag;
 
     static const double Default_mm3_per_mm;
     static const float Default_Width;
@@ -90,8 +90,68 @@ public:
         GCodeMove(EType type, const Metadata& data, const Vec3d& start_position, const Vec3d& end_position, float delta_extruder);
     };
 
-    typedef std::vector<GCodeMove> GCodeMovesList;
-    typedef std::map<GCodeMove::EType, GCodeMovesList> TypeToMovesMap;
+    // Parameters of the extrusions known to GCode::_extrude(), handed over to the analyzer together with the gcode
+    // without formatting and parsing them. The gcode only marks with Extrusion_Params_Tag where they apply.
+    struct ExtrusionParams
+    {
+        ExtrusionRole extrusion_role;
+        double mm3_per_mm;
+        float width;     // mm
+        float height;    // mm
+    };
+
+    // Moves of a single type stored as a structure of arrays, as a large print produces tens of millions of them.
+    // The positions are stored as floats before the extruder offset is applied, which is lossless as the analyzer
+    // tracks the axes as floats. The extruder offset is stored with the metadata and added when a move is reconstructed.
+    // A start position is only stored if it differs from the end position of the previous move of the same type,
+    // the metadata is stored once per run of moves sharing the same metadata and extruder offset.
+    class GCodeMovesList
+    {
+    public:
+        // Run of consecutive moves starting at the same z, for random access to the layers.
+        struct LayerOffset
+        {
+            float z;
+            size_t first_move;
+        };
+
+        explicit GCodeMovesList(GCodeMove::EType type = GCodeMove::Noop) : m_type(type) {}
+
+        // The positions are passed without the extruder offset, the reconstructed moves have it applied.
+        void append(const Metadata& data, const Vec2d& extruder_offset, const Vec3d& start_position, const Vec3d& end_position, float delta_extruder);
+        void clear();
+
+        size_t size() const { return m_end_positions.size(); }
+        bool empty() const { return m_end_positions.empty(); }
+        const std::vector<LayerOffset>& layers() const { return m_layers; }
+
+        // Reconstructs a single move.
+        GCodeMove operator[](size_t idx) const;
+
+        // Calls fn(const GCodeMove&) for the moves in <begin, end) in their order.
+        template<typename Fn> void for_each(size_t begin, size_t end, Fn fn) const;
+        template<typename Fn> void for_each(Fn fn) const { this->for_each(0, this->size(), fn); }
+
+        size_t memory_used() const;
+
+    private:
+        // Index of the metadata run of the move idx.
+        size_t metadata_run(size_t idx) const;
+        // Index of the first stored start position at or after the move idx.
+        size_t start_position_lower_bound(size_t idx) const;
+
+        GCodeMove::EType m_type;
+        std::vector<Vec3f> m_end_positions;
+        std::vector<float> m_delta_extruder;
+        // Start positions of the moves not starting at the end of the previous move, sorted by the move index.
+        using StartPosition = std::pair<size_t, Vec3f>;
+        std::vector<StartPosition> m_start_positions;
+        // Runs of metadata, m_metadata[i] and m_extruder_offsets[i] apply to the moves starting with m_metadata_first_move[i].
+        std::vector<Metadata> m_metadata;
+        std::vector<Vec2d> m_extruder_offsets;
+        std::vector<size_t> m_metadata_first_move;
+        std::vector<LayerOffset> m_layers;
+    };
     typedef std::map<unsigned int, Vec2d> ExtruderOffsetsMap;
     typedef std::map<unsigned int, unsigned int> ExtruderToColorMap;
 
@@ -113,7 +173,7 @@ private:
 private:
     State m_state;
     GCodeReader m_parser;
-    TypeToMovesMap m_moves_map;
+    GCodeMovesList m_moves[GCodeMove::Num_Types];
     ExtruderOffsetsMap m_extruder_offsets;
     unsigned int m_extruders_count;
     GCodeFlavor m_gcode_flavor;
@@ -123,6 +183,13 @@ private:
     // The output of process_layer()
     std::string m_process_output;
 
+    // Extrusion parameters passed to the running process_gcode() and the next one to be applied.
+    const std::vector<ExtrusionParams> *m_extrusion_params = nullptr;
+    size_t m_extrusion_params_next = 0;
+
+    // Minimum number of moves of whole layers processed by a single task of calc_gcode_preview_data().
+    size_t m_preview_min_moves_per_task = 50000;
+
 public:
     GCodeAnalyzer() { reset(); }
 
@@ -137,11 +204,15 @@ public:
     void reset();
 
     // Adds the gcode contained in the given string to the analysis and returns it after removing the workcodes
-    const std::string& process_gcode(const std::string& gcode);
+    // The n-th Extrusion_Params_Tag of the gcode applies extrusion_params[n].
+    const std::string& process_gcode(const std::string& gcode, const std::vector<ExtrusionParams>& extrusion_params = std::vector<ExtrusionParams>());
 
     // Calculates all data needed for gcode visualization
     // throws CanceledException through print->throw_if_canceled() (sent by the caller as callback).
     void calc_gcode_preview_data(GCodePreviewData& preview_data, std::function<void()> cancel_callback = std::function<void()>());
+    // The extrusion and travel moves are split into chunks of whole layers with at least min_moves moves, processed in parallel.
+    // The preview data do not depend on the chunk size.
+    void set_preview_min_moves_per_task(size_t min_moves) { m_preview_min_moves_per_task = min_moves; }
 
     // Return an estimate of the memory consumed by the time estimator.
     size_t memory_used() const;
@@ -209,16 +280,19 @@ private:
     bool _process_tags(const GCodeReader::GCodeLine& line);
 
     // Processes extrusion role tag
-    void _process_extrusion_role_tag(const std::string& comment, size_t pos);
+    void _process_extrusion_role_tag(std::string_view comment, size_t pos);
 
     // Processes mm3_per_mm tag
-    void _process_mm3_per_mm_tag(const std::string& comment, size_t pos);
+    void _process_mm3_per_mm_tag(std::string_view comment, size_t pos);
 
     // Processes width tag
-    void _process_width_tag(const std::string& comment, size_t pos);
+    void _process_width_tag(std::string_view comment, size_t pos);
 
     // Processes height tag
-    void _process_height_tag(const std::string& comment, size_t pos);
+    void _process_height_tag(std::string_view comment, size_t pos);
+
+    // Processes the tag of the extrusion parameters passed to process_gcode()
+    void _process_extrusion_params_tag();
 
     // Processes color change tag
     void _process_color_change_tag(int extruder);
@@ -295,12 +369,40 @@ private:
     bool _is_valid_extrusion_role(int value) const;
 
     // All the following methods throw CanceledException through print->throw_if_canceled() (sent by the caller as callback).
-    void _calc_gcode_preview_extrusion_layers(GCodePreviewData& preview_data, std::function<void()> cancel_callback);
-    void _calc_gcode_preview_travel(GCodePreviewData& preview_data, std::function<void()> cancel_callback);
+    // The extrusion and travel passes run in parallel, they update their own copy of the preview ranges.
+    void _calc_gcode_preview_extrusion_layers(GCodePreviewData& preview_data, GCodePreviewData::Ranges& ranges, std::function<void()> cancel_callback);
+    void _calc_gcode_preview_travel(GCodePreviewData& preview_data, GCodePreviewData::Ranges& ranges, std::function<void()> cancel_callback);
     void _calc_gcode_preview_retractions(GCodePreviewData& preview_data, std::function<void()> cancel_callback);
     void _calc_gcode_preview_unretractions(GCodePreviewData& preview_data, std::function<void()> cancel_callback);
 };
 
+template<typename Fn> void GCodeAnalyzer::GCodeMovesList::for_each(size_t begin, size_t end, Fn fn) const
+{
+    if (begin >= end)
+        return;
+    size_t run = this->metadata_run(begin);
+    size_t next_run_first = (run + 1 < m_metadata.size()) ? m_metadata_first_move[run + 1] : size_t(-1);
+    size_t start_idx = this->start_position_lower_bound(begin);
+    GCodeMove move = (*this)[begin];
+    Vec3d offset(m_extruder_offsets[run].x(), m_extruder_offsets[run].y(), 0.);
+    for (size_t idx = begin;;) {
+        fn(move);
+        if (++ idx == end)
+            break;
+        if (idx == next_run_first) {
+            move.data = m_metadata[++ run];
+            offset = Vec3d(m_extruder_offsets[run].x(), m_extruder_offsets[run].y(), 0.);
+            next_run_first = (run + 1 < m_metadata.size()) ? m_metadata_first_move[run + 1] : size_t(-1);
+        }
+        while (start_idx < m_start_positions.size() && m_start_positions[start_idx].first < idx)
+            ++ start_idx;
+        move.start_position = ((start_idx < m_start_positions.size() && m_start_positions[start_idx].first == idx) ?
+            m_start_positions[start_idx].second : m_end_positions[idx - 1]).cast<double>() + offset;
+        move.end_position = m_end_positions[idx].cast<double>() + offset;
+        move.delta_extruder = m_delta_extruder[idx];
+    }
+}
+
 class BufferData {
 public:
     std::string raw;
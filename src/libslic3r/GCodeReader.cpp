@@ -1,9 +1,15 @@
 #include "GCodeReader.hpp"
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <memory>
 
 #include <Shiny/Shiny.h>
 
@@ -21,6 +27,35 @@ void GCodeReader::apply_config(const DynamicPrintConfig &config)
     m_extrusion_axis = m_config.get_extrusion_axis()[0];
 }
 
+// Parse a plain decimal number ("-12.345") as found in the G-code, bypassing the locale handling and the generic code paths of strtod().
+// The mantissa fits into the 53 bits of a double and the power of 10 is exact, thus the single division is correctly rounded
+// and the result is identical to the result of strtod(). Anything else (exponents, hexadecimal numbers, inf / nan,
+// long mantissas, leading whitespaces) is passed to strtod().
+static inline double parse_number(const char *c, char **pend)
+{
+    static constexpr double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+    const char *p        = c;
+    bool        negative = false;
+    if (*p == '-') {
+        negative = true;
+        ++ p;
+    } else if (*p == '+')
+        ++ p;
+    uint64_t mantissa    = 0;
+    int      digits      = 0;
+    int      frac_digits = 0;
+    for (; *p >= '0' && *p <= '9'; ++ p, ++ digits)
+        mantissa = mantissa * 10 + (*p - '0');
+    if (*p == '.')
+        for (++ p; *p >= '0' && *p <= '9'; ++ p, ++ digits, ++ frac_digits)
+            mantissa = mantissa * 10 + (*p - '0');
+    if (digits == 0 || digits > 15 || *p == 'e' || *p == 'E' || *p == 'x' || *p == 'X')
+        return strtod(c, pend);
+    *pend = const_cast<char*>(p);
+    double v = double(mantissa) / pow10[frac_digits];
+    return negative ? - v : v;
+}
+
 const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline, std::pair<const char*, const char*> &command)
 {
     PROFILE_FUNC();
@@ -57,7 +92,7 @@ const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline,
             if (axis != NUM_AXES_WITH_UNKNOWN) {
                 // Try to parse the numeric value.
                 char   *pend = nullptr;
-                double  v = strtod(++ c, &pend);
+                double  v = parse_number(++ c, &pend);
                 if (pend != nullptr && is_end_of_word(*pend)) {
                     // The axis value has been parsed correctly.
                     if (axis != UNKNOWN_AXIS)
@@ -79,11 +114,8 @@ const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline,
     // Skip the rest of the line.
     for (; ! is_end_of_line(*c); ++ c);
 
-    // Copy the raw string including the comment, without the trailing newlines.
-    if (c > ptr) {
-        PROFILE_BLOCK(copy_raw_string);
-        gline.m_raw.assign(ptr, c);
-    }
+    // Reference the raw string including the comment, without the trailing newlines.
+    gline.m_raw = std::string_view(ptr, c - ptr);
 
     // Skip the trailing newlines.
 	if (*c == '\r')
@@ -113,15 +145,45 @@ void GCodeReader::update_coordinates(GCodeLine &gline, std::pair<const char*, co
 
 void GCodeReader::parse_file(const std::string &file, callback_t callback)
 {
-    std::ifstream f(file);
-    std::string line;
-    while (std::getline(f, line))
-        this->parse_line(line, callback);
+    boost::system::error_code ec;
+    uintmax_t file_size = boost::filesystem::file_size(file, ec);
+    if (ec || file_size == 0)
+        return;
+
+    // Map the file into memory and parse it in place. The mapping may fail, for example for a path
+    // not representable in the local code page on Windows, then read the file into memory.
+    std::unique_ptr<boost::interprocess::mapped_region> region;
+    std::string                                         data;
+    try {
+        boost::interprocess::file_mapping mapping(file.c_str(), boost::interprocess::read_only);
+        region = std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_only);
+    } catch (const boost::interprocess::interprocess_exception &) {
+        boost::nowide::ifstream f(file, std::ios::in | std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+    const char *begin = region ? static_cast<const char*>(region->get_address()) : data.data();
+    const char *end   = begin + (region ? region->get_size() : data.size());
+
+    // The mapped memory is not zero terminated. The parser stops at the end of line characters, therefore
+    // only an unterminated last line needs to be parsed from a zero terminated copy.
+    const char *last = end;
+    while (last > begin && last[-1] != '\n')
+        -- last;
+    GCodeLine gline;
+    for (const char *ptr = begin; ptr < last;) {
+        gline.reset();
+        ptr = this->parse_line(ptr, gline, callback);
+        if (ptr < last && *ptr == 0)
+            // The rest of a line after a zero character is ignored.
+            ptr = static_cast<const char*>(memchr(ptr, '\n', last - ptr)) + 1;
+    }
+    if (last < end)
+        this->parse_line(std::string(last, end), callback);
 }
 
 bool GCodeReader::GCodeLine::has(char axis) const
 {
-    const char *c = m_raw.c_str();
+    const char *c = m_raw.data();
     // Skip the whitespaces.
     c = skip_whitespaces(c);
     // Skip the command.
@@ -143,7 +205,7 @@ bool GCodeReader::GCodeLine::has(char axis) const
 
 bool GCodeReader::GCodeLine::has_value(char axis, float &value) const
 {
-    const char *c = m_raw.c_str();
+    const char *c = m_raw.data();
     // Skip the whitespaces.
     c = skip_whitespaces(c);
     // Skip the command.
@@ -158,7 +220,7 @@ bool GCodeReader::GCodeLine::has_value(char axis, float &value) const
         if (*c == axis) {
             // Try to parse the numeric value.
             char   *pend = nullptr;
-            double  v = strtod(++ c, &pend);
+            double  v = parse_number(++ c, &pend);
             if (pend != nullptr && is_end_of_word(*pend)) {
                 // The axis value has been parsed correctly.
                 value = float(v);
@@ -186,17 +248,19 @@ void GCodeReader::GCodeLine::set(const GCodeReader &reader, const Axis axis, con
         match[1] = reader.extrusion_axis();
     }
 
+    std::string raw(m_raw);
     if (this->has(axis)) {
-        size_t pos = m_raw.find(match)+2;
-        size_t end = m_raw.find(' ', pos+1);
-        m_raw = m_raw.replace(pos, end-pos, ss.str());
+        size_t pos = raw.find(match)+2;
+        size_t end = raw.find(' ', pos+1);
+        raw.replace(pos, end-pos, ss.str());
     } else {
-        size_t pos = m_raw.find(' ');
+        size_t pos = raw.find(' ');
         if (pos == std::string::npos)
-            m_raw += std::string(match) + ss.str();
+            raw += std::string(match) + ss.str();
         else
-            m_raw = m_raw.replace(pos, 0, std::string(match) + ss.str());
+            raw.replace(pos, 0, std::string(match) + ss.str());
     }
+    this->set_raw(std::move(raw));
     m_axis[axis] = new_value;
     m_mask |= 1 << int(axis);
 }
@@ -6,24 +6,37 @@
 #include <cstdlib>
 #include <functional>
 #include <string>
+#include <string_view>
 #include "PrintConfig.hpp"
 
 namespace Slic3r {
 
 class GCodeReader {
 public:
+    // A parsed G-code line. The raw line is not copied, it references the parsed buffer (or file mapping), therefore
+    // raw(), cmd() and comment() are only valid inside the parser callback. A GCodeLine copied or modified by set()
+    // owns a copy of its raw line.
+    // The character following the raw line is always an end of line character ('\r', '\n' or 0), so the raw line may be scanned
+    // by the C string functions up to an end of word / end of line.
     class GCodeLine {
     public:
         GCodeLine() { reset(); }
-        void reset() { m_mask = 0; memset(m_axis, 0, sizeof(m_axis)); m_raw.clear(); }
+        GCodeLine(const GCodeLine &rhs) { *this = rhs; }
+        GCodeLine& operator=(const GCodeLine &rhs) {
+            memcpy(m_axis, rhs.m_axis, sizeof(m_axis));
+            m_mask = rhs.m_mask;
+            this->set_raw(std::string(rhs.m_raw));
+            return *this;
+        }
+        void reset() { m_mask = 0; memset(m_axis, 0, sizeof(m_axis)); m_raw = std::string_view("", 0); }
 
-        const std::string&  raw() const { return m_raw; }
-        const std::string   cmd() const { 
-            const char *cmd = GCodeReader::skip_whitespaces(m_raw.c_str());
-            return std::string(cmd, GCodeReader::skip_word(cmd));
+        std::string_view    raw() const { return m_raw; }
+        std::string_view    cmd() const { 
+            const char *cmd = GCodeReader::skip_whitespaces(m_raw.data());
+            return std::string_view(cmd, GCodeReader::skip_word(cmd) - cmd);
         }
-        const std::string   comment() const
-            { size_t pos = m_raw.find(';'); return (pos == std::string::npos) ? "" : m_raw.substr(pos + 1); }
+        std::string_view    comment() const
+            { size_t pos = m_raw.find(';'); return (pos == std::string_view::npos) ? std::string_view() : m_raw.substr(pos + 1); }
 
         bool  has(Axis axis) const { return (m_mask & (1 << int(axis))) != 0; }
         float value(Axis axis) const { return m_axis[axis]; }
@@ -44,7 +57,7 @@ public:
             return sqrt(x*x + y*y);
         }
         bool cmd_is(const char *cmd_test) const {
-            const char *cmd = GCodeReader::skip_whitespaces(m_raw.c_str());
+            const char *cmd = GCodeReader::skip_whitespaces(m_raw.data());
             size_t len = strlen(cmd_test); 
             return strncmp(cmd, cmd_test, len) == 0 && GCodeReader::is_end_of_word(cmd[len]);
         }
@@ -66,7 +79,11 @@ public:
         float f() const { return m_axis[F]; }
 
     private:
-        std::string      m_raw;
+        void set_raw(std::string &&raw) { m_raw_storage = std::move(raw); m_raw = m_raw_storage; }
+
+        std::string_view m_raw;
+        // Owned copy of the raw line, if copied or modified.
+        std::string      m_raw_storage;
         float            m_axis[NUM_AXES];
         uint32_t         m_mask;
         friend class GCodeReader;
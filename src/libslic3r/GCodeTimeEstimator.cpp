@@ -1,6 +1,7 @@
 #include "GCodeTimeEstimator.hpp"
 #include "Utils.hpp"
 #include <boost/bind.hpp>
+#include <algorithm>
 #include <cmath>
 
 #include <Shiny/Shiny.h>
@@ -221,6 +222,11 @@ namespace Slic3r {
 #endif // ENABLE_MOVE_STATS
     }
 
+    void GCodeTimeEstimator::resolve_times()
+    {
+        _simulate_st_synchronize();
+    }
+
     void GCodeTimeEstimator::calculate_time_from_text(const std::string& gcode)
     {
         reset();
@@ -274,7 +280,7 @@ namespace Slic3r {
 
     bool GCodeTimeEstimator::post_process(const std::string& filename, float interval_sec, const PostProcessData* const normal_mode, const PostProcessData* const silent_mode)
     {
-        boost::nowide::ifstream in(filename);
+        boost::nowide::ifstream in(filename, std::ios::binary);
         if (!in.good())
             throw std::runtime_error(std::string("Time estimator post process export failed.\nCannot open file for reading.\n"));
 
@@ -284,131 +290,220 @@ namespace Slic3r {
         if (out == nullptr)
             throw std::runtime_error(std::string("Time estimator post process export failed.\nCannot open file for writing.\n"));
 
-        std::string normal_time_mask = "M73 P%s R%s\n";
-        std::string silent_time_mask = "M73 Q%s S%s\n";
-        char line_M73[64];
+        try {
+            RemainingTimesWriter writer(normal_mode, silent_mode, interval_sec);
+            // read and write in blocks of 64K to reduce reading and writing calls
+            std::vector<char> buffer(65536);
+            while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0)
+                writer.write(out, buffer.data(), size_t(in.gcount()));
+            if (in.bad())
+                throw std::runtime_error(std::string("Time estimator post process export failed.\nError while reading from file.\n"));
+            writer.finalize(out, (normal_mode != nullptr) ? normal_mode->time : 0.0f, (silent_mode != nullptr) ? silent_mode->time : 0.0f);
+        } catch (...) {
+            in.close();
+            fclose(out);
+            boost::nowide::remove(path_tmp.c_str());
+            throw;
+        }
 
-        std::string gcode_line;
-        // buffer line to export only when greater than 64K to reduce writing calls
-        std::string export_line;
+        fclose(out);
+        in.close();
 
-        // helper function to write to disk
-        auto write_string = [&](const std::string& str) {
-            fwrite((const void*)export_line.c_str(), 1, export_line.length(), out);
-            if (ferror(out))
-            {
-                in.close();
-                fclose(out);
-                boost::nowide::remove(path_tmp.c_str());
-                throw std::runtime_error(std::string("Time estimator post process export failed.\nIs the disk full?\n"));
-            }
-            export_line.clear();
-        };
+        if (rename_file(path_tmp, filename))
+            throw std::runtime_error(std::string("Failed to rename the output G-code file from ") + path_tmp + " to " + filename + '\n' +
+                "Is " + path_tmp + " locked?" + '\n');
 
-        GCodeReader parser;
-        unsigned int g1_lines_count = 0;
-        int normal_g1_line_id = 0;
-        float normal_last_recorded_time = 0.0f;
-        int silent_g1_line_id = 0;
-        float silent_last_recorded_time = 0.0f;
-
-        // helper function to process g1 lines
-        auto process_g1_line = [&](const PostProcessData* const data, const GCodeReader::GCodeLine& line, int& g1_line_id, float& last_recorded_time, const std::string& time_mask) {
-            if (data == nullptr)
-                return;
-
-            assert((g1_line_id >= (int)data->g1_line_ids.size()) || (data->g1_line_ids[g1_line_id].first >= g1_lines_count));
-            const Block* block = nullptr;
-            if (g1_line_id < (int)data->g1_line_ids.size())
-            {
-                const G1LineIdToBlockId& map_item = data->g1_line_ids[g1_line_id];
-                if (map_item.first == g1_lines_count)
-                {
-                    if (line.has_e() && (map_item.second < (unsigned int)data->blocks.size()))
-                        block = &data->blocks[map_item.second];
-                    ++g1_line_id;
-                }
-            }
+        return true;
+    }
 
-            if ((block != nullptr) && (block->elapsed_time != -1.0f))
-            {
-                float block_remaining_time = data->time - block->elapsed_time;
-                if (std::abs(last_recorded_time - block_remaining_time) > interval_sec)
-                {
-                    sprintf(line_M73, time_mask.c_str(), std::to_string((int)(100.0f * block->elapsed_time / data->time)).c_str(), _get_time_minutes(block_remaining_time).c_str());
-                    gcode_line += line_M73;
+    // 64 bit file offsets, the G-code may get larger than 2GB.
+    static int64_t ftell64(FILE* file)
+    {
+#ifdef _WIN32
+        return _ftelli64(file);
+#else
+        return int64_t(ftello(file));
+#endif
+    }
 
-                    last_recorded_time = block_remaining_time;
-                }
-            }
-        };
+    static int fseek64(FILE* file, int64_t offset, int origin)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, offset, origin);
+#else
+        return fseeko(file, off_t(offset), origin);
+#endif
+    }
 
-        while (std::getline(in, gcode_line))
+    GCodeTimeEstimator::RemainingTimesWriter::RemainingTimesWriter(const PostProcessData* const normal_mode, const PostProcessData* const silent_mode, float interval_sec) :
+        m_interval_sec(interval_sec)
+    {
+        m_normal.mask = "M73 P%d R%s";
+        m_silent.mask = "M73 Q%d S%s";
+        if (normal_mode != nullptr)
         {
-            if (!in.good())
-            {
-                fclose(out);
-                throw std::runtime_error(std::string("Time estimator post process export failed.\nError while reading from file.\n"));
-            }
+            m_normal.g1_line_ids = &normal_mode->g1_line_ids;
+            m_normal.blocks = &normal_mode->blocks;
+        }
+        if (silent_mode != nullptr)
+        {
+            m_silent.g1_line_ids = &silent_mode->g1_line_ids;
+            m_silent.blocks = &silent_mode->blocks;
+        }
+    }
 
-            // check tags
-            // remove Color_Change_Tag and Pause_Print_Tag
-            if (gcode_line == "; " + Color_Change_Tag || gcode_line == "; " + Pause_Print_Tag)
-                continue;
+    void GCodeTimeEstimator::RemainingTimesWriter::write(FILE* out, const char* gcode, size_t len)
+    {
+        if (m_offset == -1)
+            m_offset = ftell64(out);
 
-            // replaces placeholders for initial line M73 with the real lines
-            if ((normal_mode != nullptr) && (gcode_line == Normal_First_M73_Output_Placeholder_Tag))
-            {
-                sprintf(line_M73, normal_time_mask.c_str(), "0", _get_time_minutes(normal_mode->time).c_str());
-                gcode_line = line_M73;
-            }
-            else if ((silent_mode != nullptr) && (gcode_line == Silent_First_M73_Output_Placeholder_Tag))
-            {
-                sprintf(line_M73, silent_time_mask.c_str(), "0", _get_time_minutes(silent_mode->time).c_str());
-                gcode_line = line_M73;
-            }
-            // replaces placeholders for final line M73 with the real lines
-            else if ((normal_mode != nullptr) && (gcode_line == Normal_Last_M73_Output_Placeholder_Tag))
-            {
-                sprintf(line_M73, normal_time_mask.c_str(), "100", "0");
-                gcode_line = line_M73;
-            }
-            else if ((silent_mode != nullptr) && (gcode_line == Silent_Last_M73_Output_Placeholder_Tag))
-            {
-                sprintf(line_M73, silent_time_mask.c_str(), "100", "0");
-                gcode_line = line_M73;
-            }
-            else
-                gcode_line += "\n";
+        const char* end = gcode + len;
+        while (gcode != end)
+        {
+            const char* eol = std::find(gcode, end, '\n');
+            m_line.append(gcode, eol);
+            if (eol == end)
+                // keep the unterminated last line, it continues with the next block of G-code
+                break;
+            _process_line();
+            gcode = eol + 1;
+        }
+        _flush(out);
+    }
+
+    void GCodeTimeEstimator::RemainingTimesWriter::finalize(FILE* out, float normal_time, float silent_time)
+    {
+        if (m_offset == -1)
+            m_offset = ftell64(out);
+
+        if (!m_line.empty())
+        {
+            _process_line();
+            _flush(out);
+        }
+
+        if (m_M73_lines.empty())
+            return;
+
+        // fill in the values of the M73 lines, their length is fixed
+        std::string line_M73;
+        for (const M73Line& line : m_M73_lines)
+        {
+            _format_M73(line_M73, line.silent ? m_silent : m_normal, line.silent ? silent_time : normal_time, line.elapsed_time);
+            if (fseek64(out, line.offset, SEEK_SET) != 0 || fwrite(line_M73.data(), 1, line_M73.size(), out) != line_M73.size())
+                throw std::runtime_error(std::string("Time estimator post process export failed.\nCannot update the remaining times.\n"));
+        }
+        if (fseek64(out, 0, SEEK_END) != 0 || ftell64(out) != m_offset)
+            throw std::runtime_error(std::string("Time estimator post process export failed.\nCannot update the remaining times.\n"));
+        m_M73_lines.clear();
+    }
+
+    void GCodeTimeEstimator::RemainingTimesWriter::_process_line()
+    {
+        // check tags
+        // remove Color_Change_Tag and Pause_Print_Tag
+        if (m_line == "; " + Color_Change_Tag || m_line == "; " + Pause_Print_Tag)
+        {
+            m_line.clear();
+            return;
+        }
+
+        // replaces placeholders for initial line M73 with the real lines, their values are filled in by finalize()
+        if ((m_normal.blocks != nullptr) && (m_line == Normal_First_M73_Output_Placeholder_Tag))
+            _add_M73(false, 0.0f);
+        else if ((m_silent.blocks != nullptr) && (m_line == Silent_First_M73_Output_Placeholder_Tag))
+            _add_M73(true, 0.0f);
+        // replaces placeholders for final line M73 with the real lines
+        else if ((m_normal.blocks != nullptr) && (m_line == Normal_Last_M73_Output_Placeholder_Tag))
+            _add_M73(false, -1.0f);
+        else if ((m_silent.blocks != nullptr) && (m_line == Silent_Last_M73_Output_Placeholder_Tag))
+            _add_M73(true, -1.0f);
+        else
+        {
+            m_line += "\n";
+            m_output += m_line;
 
             // add remaining time lines where needed
-            parser.parse_line(gcode_line,
-                [&](GCodeReader& reader, const GCodeReader::GCodeLine& line)
+            m_parser.parse_line(m_line,
+                [this](GCodeReader& reader, const GCodeReader::GCodeLine& line)
                 {
                     if (line.cmd_is("G1"))
                     {
-                        ++g1_lines_count;
-                        process_g1_line(silent_mode, line, silent_g1_line_id, silent_last_recorded_time, silent_time_mask);
-                        process_g1_line(normal_mode, line, normal_g1_line_id, normal_last_recorded_time, normal_time_mask);
+                        ++m_g1_lines_count;
+                        _process_G1_line(true, line);
+                        _process_G1_line(false, line);
                     }
                 });
+        }
+        m_line.clear();
+    }
+
+    void GCodeTimeEstimator::RemainingTimesWriter::_process_G1_line(bool silent, const GCodeReader::GCodeLine& line)
+    {
+        Mode& mode = silent ? m_silent : m_normal;
+        if (mode.blocks == nullptr)
+            return;
 
-            export_line += gcode_line;
-            if (export_line.length() > 65535)
-                write_string(export_line);
+        assert((mode.g1_line_id >= mode.g1_line_ids->size()) || ((*mode.g1_line_ids)[mode.g1_line_id].first >= m_g1_lines_count));
+        const Block* block = nullptr;
+        if (mode.g1_line_id < mode.g1_line_ids->size())
+        {
+            const G1LineIdToBlockId& map_item = (*mode.g1_line_ids)[mode.g1_line_id];
+            if (map_item.first == m_g1_lines_count)
+            {
+                if (line.has_e() && (map_item.second < (unsigned int)mode.blocks->size()))
+                    block = &(*mode.blocks)[map_item.second];
+                ++mode.g1_line_id;
+            }
         }
 
-        if (!export_line.empty())
-            write_string(export_line);
+        if ((block != nullptr) && (block->elapsed_time != -1.0f) &&
+            ((mode.last_recorded_time == -1.0f) || (std::abs(block->elapsed_time - mode.last_recorded_time) > m_interval_sec)))
+        {
+            _add_M73(silent, block->elapsed_time);
+            mode.last_recorded_time = block->elapsed_time;
+        }
+    }
 
-        fclose(out);
-        in.close();
+    void GCodeTimeEstimator::RemainingTimesWriter::_add_M73(bool silent, float elapsed_time)
+    {
+        if (elapsed_time == -1.0f)
+        {
+            // the final line is known already
+            std::string line_M73;
+            _format_M73(line_M73, silent ? m_silent : m_normal, 0.0f, -1.0f);
+            m_output += line_M73;
+        }
+        else
+        {
+            m_M73_lines.push_back({ m_offset + (int64_t)m_output.size(), silent, elapsed_time });
+            m_output.append(M73_Line_Length, ' ');
+        }
+        m_output += "\n";
+    }
 
-        if (rename_file(path_tmp, filename))
-            throw std::runtime_error(std::string("Failed to rename the output G-code file from ") + path_tmp + " to " + filename + '\n' +
-                "Is " + path_tmp + " locked?" + '\n');
+    void GCodeTimeEstimator::RemainingTimesWriter::_format_M73(std::string& out, const Mode& mode, float time, float elapsed_time)
+    {
+        char line_M73[64];
+        if (elapsed_time == -1.0f)
+            sprintf(line_M73, mode.mask, 100, "0");
+        else
+            sprintf(line_M73, mode.mask, (time > 0.0f) ? (int)(100.0f * elapsed_time / time) : 0, _get_time_minutes(time - elapsed_time).c_str());
+        out = line_M73;
+        assert(out.size() <= M73_Line_Length);
+        // pad to the length reserved for the line
+        out.resize(M73_Line_Length, ' ');
+    }
 
-        return true;
+    void GCodeTimeEstimator::RemainingTimesWriter::_flush(FILE* out)
+    {
+        if (m_output.empty())
+            return;
+        fwrite((const void*)m_output.c_str(), 1, m_output.length(), out);
+        if (ferror(out))
+            throw std::runtime_error(std::string("Time estimator post process export failed.\nIs the disk full?\n"));
+        m_offset += (int64_t)m_output.size();
+        m_output.clear();
     }
 
     void GCodeTimeEstimator::set_axis_position(EAxis axis, float position)
@@ -880,7 +975,7 @@ namespace Slic3r {
         if (_process_tags(line))
             return;
 
-        std::string cmd = line.cmd();
+        std::string_view cmd = line.cmd();
         if (cmd.length() > 1)
         {
             switch (::toupper(cmd[0]))
@@ -1477,10 +1572,10 @@ namespace Slic3r {
 
     void GCodeTimeEstimator::_processT(const GCodeReader::GCodeLine& line)
     {
-        std::string cmd = line.cmd();
+        std::string_view cmd = line.cmd();
         if (cmd.length() > 1)
         {
-            unsigned int id = (unsigned int)::strtol(cmd.substr(1).c_str(), nullptr, 10);
+            unsigned int id = (unsigned int)::strtol(cmd.data() + 1, nullptr, 10);
             if (get_extruder_id() != id)
             {
                 // Specific to the MK3 MMU2: The initial extruder ID is set to -1 indicating
@@ -1495,7 +1590,7 @@ namespace Slic3r {
 
     bool GCodeTimeEstimator::_process_tags(const GCodeReader::GCodeLine& line)
     {
-        std::string comment = line.comment();
+        std::string_view comment = line.comment();
 
         // Color_Change_Tag
         size_t pos = comment.find(Color_Change_Tag);
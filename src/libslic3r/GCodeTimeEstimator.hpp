@@ -6,6 +6,8 @@
 #include "GCodeReader.hpp"
 #include "CustomGCode.hpp"
 
+#include <cstdio>
+
 #define ENABLE_MOVE_STATS 0
 
 namespace Slic3r {
@@ -229,6 +231,73 @@ namespace Slic3r {
             PostProcessData(const G1LineIdToBlockIdMap& g1_line_ids, const BlocksList& blocks, float time) : g1_line_ids(g1_line_ids), blocks(blocks), time(time) {}
         };
 
+        // Writes the gcode into a file,
+        // replacing placeholders with correspondent new lines M73
+        // placing new lines M73 (containing the remaining time) where needed (in dependence of the given interval in seconds)
+        // and removing working tags (as those used for color changes).
+        // The lines M73 are placed at the blocks of the G1 lines, whose times have to be calculated before their gcode is written
+        // (see resolve_times()), so that the gcode may be written while it is being generated.
+        // The lines M73 are written blank, padded to M73_Line_Length, and their values are filled in by finalize(),
+        // once the print time is known.
+        // if normal_mode == nullptr no M73 line will be added for normal mode
+        // if silent_mode == nullptr no M73 line will be added for silent mode
+        // Only the references to the g1 line ids and to the blocks are kept from the given PostProcessData.
+        class RemainingTimesWriter
+        {
+        public:
+            static constexpr const size_t M73_Line_Length = 24;
+
+            RemainingTimesWriter(const PostProcessData* const normal_mode, const PostProcessData* const silent_mode, float interval_sec);
+
+            // Writes the given block of gcode, which may end with an unterminated line. 
+            // All the gcode written into the file has to be passed through this function.
+            // Throws std::runtime_error if writing to the file fails.
+            void write(FILE* out, const char* gcode, size_t len);
+            // Writes the last unterminated line, fills in the lines M73 with the given print times and moves to the end of the file.
+            // Throws std::runtime_error if writing to the file fails.
+            void finalize(FILE* out, float normal_time, float silent_time);
+
+        private:
+            struct Mode
+            {
+                const G1LineIdToBlockIdMap* g1_line_ids{ nullptr };
+                const BlocksList* blocks{ nullptr };
+                const char* mask{ nullptr };
+                // Index into g1_line_ids of the next G1 line with a block.
+                size_t g1_line_id{ 0 };
+                // Elapsed time at the last line M73 placed, -1 if none was placed yet.
+                float last_recorded_time{ -1.0f };
+            };
+
+            // Line M73 written blank, to be filled in by finalize().
+            struct M73Line
+            {
+                int64_t offset;
+                bool silent;
+                float elapsed_time;
+            };
+
+            void _process_line();
+            void _process_G1_line(bool silent, const GCodeReader::GCodeLine& line);
+            // elapsed_time == -1 adds the final line M73.
+            void _add_M73(bool silent, float elapsed_time);
+            static void _format_M73(std::string& out, const Mode& mode, float time, float elapsed_time);
+            void _flush(FILE* out);
+
+            Mode m_normal;
+            Mode m_silent;
+            float m_interval_sec;
+            GCodeReader m_parser;
+            unsigned int m_g1_lines_count{ 0 };
+            // The gcode line being processed, or the unterminated last line of the gcode written so far.
+            std::string m_line;
+            // Processed gcode to be written into the file.
+            std::string m_output;
+            // File offset of m_output, -1 until the first write.
+            int64_t m_offset{ -1 };
+            std::vector<M73Line> m_M73_lines;
+        };
+
     private:
         EMode m_mode;
         GCodeReader m_parser;
@@ -266,6 +335,10 @@ namespace Slic3r {
         // if set to false only the blocks not yet processed will be used and the calculated time will be added to the current calculated time
         void calculate_time(bool start_from_beginning);
 
+        // Calculates the times of the blocks added since the last synchronization, as if the planner queue was flushed here
+        // (same as M400), so that the lines M73 may be placed into the gcode added so far (see RemainingTimesWriter)
+        void resolve_times();
+
         // Calculates the time estimate from the given gcode in string format
         void calculate_time_from_text(const std::string& gcode);
 
@@ -281,6 +354,7 @@ namespace Slic3r {
         // and removing working tags (as those used for color changes)
         // if normal_mode == nullptr no M73 line will be added for normal mode
         // if silent_mode == nullptr no M73 line will be added for silent mode
+        // The gcode is processed by RemainingTimesWriter, see there.
         static bool post_process(const std::string& filename, float interval_sec, const PostProcessData* const normal_mode, const PostProcessData* const silent_mode);
 
         // Set current position on the given axis with the given value
@@ -1,9 +1,12 @@
 #include "GCodeWriter.hpp"
 #include "CustomGCode.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <assert.h>
 #include <math.h> // need math for the sqrt function
 
@@ -24,6 +27,41 @@ namespace Slic3r {
 
     std::string GCodeWriter::PausePrintCode = "M601";
 
+void GCodeG1Formatter::append_fixed(std::string &out, double v, int digits)
+{
+    static constexpr const double pow10[] = { 1., 10., 100., 1000., 10000., 100000., 1000000. };
+    assert(digits >= 0 && digits <= 6);
+    const double scaled = std::abs(v) * pow10[digits];
+    // The product may be off by half an ulp. Only if the rounding of the exact product could differ from the rounding
+    // of the computed one (a tie or close to a tie), or if the value does not fit the integer, let the iostreams do the job.
+    const double frac = scaled - std::floor(scaled);
+    if (! (scaled < 1e15) || std::abs(frac - 0.5) <= scaled * 1e-15 + 1e-12) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(digits) << v;
+        out += ss.str();
+        return;
+    }
+    uint64_t n = uint64_t(scaled + 0.5);
+    // Digits are produced from the back.
+    char  buf[32];
+    char *end = buf + sizeof(buf);
+    char *ptr = end;
+    for (int i = 0; i < digits; ++ i) {
+        *(-- ptr) = char('0' + n % 10);
+        n /= 10;
+    }
+    if (digits > 0)
+        *(-- ptr) = '.';
+    do {
+        *(-- ptr) = char('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    // Also a negative value rounded to zero keeps its sign, as with printf().
+    if (std::signbit(v))
+        *(-- ptr) = '-';
+    out.append(ptr, end);
+}
+
 void GCodeWriter::apply_print_config(const PrintConfig &print_config)
 {
     this->config.apply(print_config, true);
@@ -325,32 +363,30 @@ std::string GCodeWriter::toolchange(unsigned int tool_id)
 
 std::string GCodeWriter::set_speed(double F, const std::string &comment, const std::string &cooling_marker) const
 {        
-    std::ostringstream gcode;
     // Convert mm per min to ticks per second
     // Divide 60,000 (ticks per second) by the feed rate divided by 60
     // The XY Move functions will multiply the XY distance by this number
     // The result will be the number of ticks between two X/Y points
 
+    // Remember the feed rate for all the flavors, the OpenFL moves derive their duration from it.
+    // (It used to be assigned to a local variable shadowing m_last_speed, leaving m_last_speed undefined.)
     //if (F > 0){ // if F is zero, we will use the travel speed instead.
-    int m_last_speed = XYZF_NUM(F);
+    m_last_speed = F;
     //} else {
         //m_last_speed = (m_laser_ticks / ((this->config.travel_speed.value)/60));
     //}
 
-    if (FLAVOR_IS(gcfopenfl)){
-        assert(F > 0.);
-        assert(F < 100000.);
-        gcode << "";
-        return gcode.str();
+    assert(F > 0.);
+    assert(F < 100000.);
+    if (FLAVOR_IS(gcfopenfl)) {
+        // OpenFL has no feed rate command.
+        return std::string();
     } else {
-        assert(F > 0.);
-        assert(F < 100000.);
-        std::ostringstream gcode;
-        gcode << "G1 F" << XYZF_NUM(F);
-        COMMENT(comment);
-        gcode << cooling_marker;
-        gcode << "\n";
-        return gcode.str();
+        GCodeG1Formatter gcode;
+        gcode.emit_f(F);
+        gcode.emit_comment(this->config.gcode_comments, comment);
+        gcode.emit_string(cooling_marker);
+        return gcode.string();
     }
 }
 
@@ -402,13 +438,11 @@ std::string GCodeWriter::travel_to_xy(const Vec2d &point, const std::string &com
         m_pos.x() = point.x();
         m_pos.y() = point.y();
     
-        std::ostringstream gcode;
-        gcode << "G1 X" << XYZF_NUM(point.x())
-            <<   " Y" << XYZF_NUM(point.y())
-            <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-        COMMENT(comment);
-        gcode << "\n";
-        return gcode.str();
+        GCodeG1Formatter gcode;
+        gcode.emit_xy(point);
+        gcode.emit_f(this->config.travel_speed.value * 60.0);
+        gcode.emit_comment(this->config.gcode_comments, comment);
+        return gcode.string();
     }
 }
 
@@ -472,14 +506,11 @@ std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &co
         m_pos = point;
 
     } else {
-        std::ostringstream gcode;
-        gcode << "G1 X" << XYZF_NUM(point.x())
-              <<   " Y" << XYZF_NUM(point.y())
-              <<   " Z" << XYZF_NUM(point.z())
-              <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-        COMMENT(comment);
-        gcode << "\n";
-        return gcode.str();
+        GCodeG1Formatter gcode;
+        gcode.emit_xyz(point);
+        gcode.emit_f(this->config.travel_speed.value * 60.0);
+        gcode.emit_comment(this->config.gcode_comments, comment);
+        return gcode.string();
     }
 }
 
@@ -552,12 +583,11 @@ std::string GCodeWriter::_travel_to_z(double z, const std::string &comment)
     } else {
         m_pos.z() = z;
         
-        std::ostringstream gcode;
-        gcode << "G1 Z" << XYZF_NUM(z)
-              <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-        COMMENT(comment);
-        gcode << "\n";
-        return gcode.str();
+        GCodeG1Formatter gcode;
+        gcode.emit_z(z);
+        gcode.emit_f(this->config.travel_speed.value * 60.0);
+        gcode.emit_comment(this->config.gcode_comments, comment);
+        return gcode.string();
 
     /* variable for storing the Z position at the end of the travel move,
     so we can subtract it from m_pos.z()  
@@ -625,14 +655,12 @@ std::string GCodeWriter::extrude_to_xy(const Vec2d &point, double dE, const std:
         m_pos.y() = point.y();
         bool is_extrude = m_tool->extrude(dE) != 0;
         
-        std::ostringstream gcode;
-        gcode << "G1 X" << XYZF_NUM(point.x())
-            << " Y" << XYZF_NUM(point.y());
+        GCodeG1Formatter gcode;
+        gcode.emit_xy(point);
         if(is_extrude)
-            gcode <<    " " << m_extrusion_axis << E_NUM(m_tool->E());
-        COMMENT(comment);
-        gcode << "\n";
-        return gcode.str();
+            gcode.emit_axis(m_extrusion_axis, m_tool->E(), GCodeG1Formatter::E_EXPORT_DIGITS);
+        gcode.emit_comment(this->config.gcode_comments, comment);
+        return gcode.string();
     }
 }
 
@@ -681,15 +709,12 @@ std::string GCodeWriter::extrude_to_xyz(const Vec3d &point, double dE, const std
             m_lifted = 0;
             bool is_extrude = m_tool->extrude(dE) != 0;
             
-            std::ostringstream gcode;
-            gcode << "G1 X" << XYZF_NUM(point.x())
-                << " Y" << XYZF_NUM(point.y())
-                << " Z" << XYZF_NUM(point.z() + m_pos.z());
+            GCodeG1Formatter gcode;
+            gcode.emit_xyz(Vec3d(point.x(), point.y(), point.z() + m_pos.z()));
             if (is_extrude)
-                    gcode <<    " " << m_extrusion_axis << E_NUM(m_tool->E());
-            COMMENT(comment);
-            gcode << "\n";
-            return gcode.str();
+                gcode.emit_axis(m_extrusion_axis, m_tool->E(), GCodeG1Formatter::E_EXPORT_DIGITS);
+            gcode.emit_comment(this->config.gcode_comments, comment);
+            return gcode.string();
         }
 }
 
@@ -740,10 +765,12 @@ std::string GCodeWriter::_retract(double length, double restart_extra, const std
             else
                 gcode << "G10 ; retract\n";
         } else {
-            gcode << "G1 " << m_extrusion_axis << E_NUM(m_tool->E())
-                           << " F" << float(m_tool->retract_speed() * 60.);
-            COMMENT(comment);
-            gcode << "\n";
+            GCodeG1Formatter g1;
+            g1.emit_axis(m_extrusion_axis, m_tool->E(), GCodeG1Formatter::E_EXPORT_DIGITS);
+            // The feed rate was always printed with the precision of the E axis.
+            g1.emit_axis('F', float(m_tool->retract_speed() * 60.), GCodeG1Formatter::E_EXPORT_DIGITS);
+            g1.emit_comment(this->config.gcode_comments, comment);
+            gcode << g1.string();
         }
     }
     
@@ -770,10 +797,11 @@ std::string GCodeWriter::unretract()
             gcode << this->reset_e();
         } else {
             // use G1 instead of G0 because G0 will blend the restart with the previous travel move
-            gcode << "G1 " << m_extrusion_axis << E_NUM(m_tool->E())
-                           << " F" << float(m_tool->deretract_speed() * 60.);
-            if (this->config.gcode_comments) gcode << " ; unretract";
-            gcode << "\n";
+            GCodeG1Formatter g1;
+            g1.emit_axis(m_extrusion_axis, m_tool->E(), GCodeG1Formatter::E_EXPORT_DIGITS);
+            g1.emit_axis('F', float(m_tool->deretract_speed() * 60.), GCodeG1Formatter::E_EXPORT_DIGITS);
+            g1.emit_comment(this->config.gcode_comments, "unretract");
+            gcode << g1.string();
         }
     }
     
@@ -10,6 +10,58 @@
 
 namespace Slic3r {
 
+// Builds a single G1 line of the GCodeWriter without going through the iostreams.
+// The numbers are written into a char buffer on the stack as scaled integers, exactly the way
+// std::fixed << std::setprecision(digits) would print them, thus the generated G-code stays byte-identical.
+class GCodeG1Formatter {
+public:
+    static constexpr int XYZF_EXPORT_DIGITS = 3;
+    static constexpr int E_EXPORT_DIGITS    = 5;
+
+    GCodeG1Formatter() { m_gcode.reserve(64); m_gcode = "G1"; }
+
+    // Append " <axis><value>".
+    void emit_axis(const char axis, const double v, const int digits) {
+        m_gcode += ' ';
+        m_gcode += axis;
+        append_fixed(m_gcode, v, digits);
+    }
+    void emit_axis(const std::string &axis, const double v, const int digits) {
+        m_gcode += ' ';
+        m_gcode += axis;
+        append_fixed(m_gcode, v, digits);
+    }
+    void emit_xy(const Vec2d &point) {
+        this->emit_axis('X', point.x(), XYZF_EXPORT_DIGITS);
+        this->emit_axis('Y', point.y(), XYZF_EXPORT_DIGITS);
+    }
+    void emit_xyz(const Vec3d &point) {
+        this->emit_xy(Vec2d(point.x(), point.y()));
+        this->emit_axis('Z', point.z(), XYZF_EXPORT_DIGITS);
+    }
+    void emit_z(const double z) { this->emit_axis('Z', z, XYZF_EXPORT_DIGITS); }
+    void emit_f(const double speed) { this->emit_axis('F', speed, XYZF_EXPORT_DIGITS); }
+    void emit_comment(const bool allow_comments, const std::string &comment) {
+        if (allow_comments && ! comment.empty()) {
+            m_gcode += " ; ";
+            m_gcode += comment;
+        }
+    }
+    void emit_string(const std::string &s) { m_gcode += s; }
+
+    // Terminate the line and hand over the G-code.
+    std::string string() {
+        m_gcode += '\n';
+        return std::move(m_gcode);
+    }
+
+    // Append v the same way as std::fixed << std::setprecision(digits) << v, that is the way printf("%.*f") prints it.
+    static void append_fixed(std::string &out, double v, int digits);
+
+private:
+    std::string m_gcode;
+};
+
 class GCodeWriter {
 public:
 
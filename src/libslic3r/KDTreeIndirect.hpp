@@ -31,6 +31,7 @@ public:
 	KDTreeIndirect(KDTreeIndirect &&rhs) : m_nodes(std::move(rhs.m_nodes)), coordinate(std::move(rhs.coordinate)) {}
 	KDTreeIndirect& operator=(KDTreeIndirect &&rhs) { m_nodes = std::move(rhs.m_nodes); coordinate = std::move(rhs.coordinate); return *this; }
 	void clear() { m_nodes.clear(); }
+	bool empty() const { return m_nodes.empty(); }
 
 	void build(size_t num_indices)
 	{
@@ -58,6 +59,8 @@ public:
 		CONTINUE_LEFT   = 1,
 		CONTINUE_RIGHT  = 2,
 		STOP 			= 4,
+		// Visit the right subtree before the left one.
+		RIGHT_FIRST		= 8,
 	};
 	template<typename CoordType> 
 	unsigned int descent_mask(const CoordType &point_coord, const CoordType &search_radius, size_t idx, size_t dimension) const
@@ -65,7 +68,10 @@ public:
 		CoordType dist = point_coord - this->coordinate(idx, dimension);
 		return (dist * dist < search_radius + CoordType(EPSILON)) ?
 			// The plane intersects a hypersphere centered at point_coord of search_radius.
-			((unsigned int)(VisitorReturnMask::CONTINUE_LEFT) | (unsigned int)(VisitorReturnMask::CONTINUE_RIGHT)) :
+			// Descend first into the half space containing point_coord, so that the search radius shrinks quickly
+			// and the other subtree is mostly pruned.
+			((unsigned int)(VisitorReturnMask::CONTINUE_LEFT) | (unsigned int)(VisitorReturnMask::CONTINUE_RIGHT) |
+			 ((dist > CoordType(0)) ? (unsigned int)(VisitorReturnMask::RIGHT_FIRST) : 0u)) :
 			// The plane does not intersect the hypersphere.
 			(dist > CoordType(0)) ? (unsigned int)(VisitorReturnMask::CONTINUE_RIGHT) : (unsigned int)(VisitorReturnMask::CONTINUE_LEFT);
 	}
@@ -180,10 +186,17 @@ private:
 		unsigned int mask = visitor(m_nodes[node], dimension);
 		if ((mask & (unsigned int)VisitorReturnMask::STOP) == 0) {
 			size_t next_dimension = (++ dimension == NumDimensions) ? 0 : dimension;
-			if (mask & (unsigned int)VisitorReturnMask::CONTINUE_LEFT)
-				visit_recursive(left,  next_dimension, visitor);
-			if (mask & (unsigned int)VisitorReturnMask::CONTINUE_RIGHT)
-				visit_recursive(right, next_dimension, visitor);
+			if (mask & (unsigned int)VisitorReturnMask::RIGHT_FIRST) {
+				if (mask & (unsigned int)VisitorReturnMask::CONTINUE_RIGHT)
+					visit_recursive(right, next_dimension, visitor);
+				if (mask & (unsigned int)VisitorReturnMask::CONTINUE_LEFT)
+					visit_recursive(left,  next_dimension, visitor);
+			} else {
+				if (mask & (unsigned int)VisitorReturnMask::CONTINUE_LEFT)
+					visit_recursive(left,  next_dimension, visitor);
+				if (mask & (unsigned int)VisitorReturnMask::CONTINUE_RIGHT)
+					visit_recursive(right, next_dimension, visitor);
+			}
 		}
 	}
 
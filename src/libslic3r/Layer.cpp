@@ -7,6 +7,8 @@
 
 #include <boost/log/trivial.hpp>
 
+#include <tbb/task_scheduler_init.h>
+
 namespace Slic3r {
 
 Layer::~Layer()
@@ -15,6 +17,7 @@ Layer::~Layer()
     for (LayerRegion *region : m_regions)
         delete region;
     m_regions.clear();
+    m_extrusion_arena->release();
 }
 
 // Test whether whether there are any slices assigned to this layer.
@@ -108,6 +111,7 @@ ExPolygons Layer::merged(float offset_scaled) const
 void Layer::make_perimeters()
 {
     BOOST_LOG_TRIVIAL(trace) << "Generating perimeters for layer " << this->id();
+    ExtrusionEntityArena::Scope arena_scope(m_extrusion_arena);
     
     // keep track of regions whose perimeters we have already generated
     std::vector<unsigned char> done(m_regions.size(), false);
@@ -224,6 +228,7 @@ void Layer::make_milling_post_process() {
     if (this->object()->print()->config().milling_diameter.empty()) return;
 
     BOOST_LOG_TRIVIAL(trace) << "Generating milling_post_process for layer " << this->id();
+    ExtrusionEntityArena::Scope arena_scope(m_extrusion_arena);
 
     // keep track of regions whose perimeters we have already generated
     std::vector<unsigned char> done(m_regions.size(), false);
@@ -291,6 +296,7 @@ void Layer::make_fills()
     #ifdef SLIC3R_DEBUG
     printf("Making fills for layer " PRINTF_ZU "\n", this->id());
     #endif
+    ExtrusionEntityArena::Scope arena_scope(m_extrusion_arena);
     for (LayerRegion *layerm : m_regions) {
         layerm->fills.clear();
         make_fill(*layerm, layerm->fills);
@@ -301,6 +307,12 @@ void Layer::make_fills()
     }
 }
 
+bool Layer::process_islands_in_parallel() const
+{
+    // The load is balanced by the layers alone if there are a few layers per thread.
+    return m_object != nullptr && m_object->layer_count() < 4 * size_t(std::max(1, tbb::task_scheduler_init::default_num_threads()));
+}
+
 void Layer::export_region_slices_to_svg(const char *path) const
 {
     BoundingBox bbox;
@@ -148,6 +148,11 @@ public:
     void                    make_perimeters();
     void                    make_milling_post_process();
     void                    make_fills();
+    // The layers are processed in parallel. If there are too few of them to keep all the threads busy,
+    // make_perimeters() and make_fills() split the islands / surfaces of this layer into parallel tasks as well.
+    bool                    process_islands_in_parallel() const;
+    // Memory of the ExtrusionEntities of this layer, to be made active by the tasks producing them.
+    ExtrusionEntityArena*   extrusion_arena() const { return m_extrusion_arena; }
 
     void                    export_region_slices_to_svg(const char *path) const;
     void                    export_region_fill_surfaces_to_svg(const char *path) const;
@@ -164,7 +169,7 @@ protected:
     Layer(size_t id, PrintObject *object, coordf_t height, coordf_t print_z, coordf_t slice_z) :
         upper_layer(nullptr), lower_layer(nullptr), slicing_errors(false),
         slice_z(slice_z), print_z(print_z), height(height),
-        m_id(id), m_object(object) {}
+        m_id(id), m_object(object), m_extrusion_arena(new ExtrusionEntityArena()) {}
     virtual ~Layer();
 
 private:
@@ -172,6 +177,8 @@ private:
     size_t              m_id;
     PrintObject        *m_object;
     LayerRegionPtrs     m_regions;
+    // Memory of the perimeter and infill ExtrusionEntities of this layer.
+    ExtrusionEntityArena *m_extrusion_arena;
 };
 
 class SupportLayer : public Layer 
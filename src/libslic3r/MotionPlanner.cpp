@@ -12,7 +12,7 @@ using boost::polygon::voronoi_diagram;
 
 namespace Slic3r {
 
-MotionPlanner::MotionPlanner(const ExPolygons &islands) : m_initialized(false)
+MotionPlanner::MotionPlanner(const ExPolygons &islands, MotionPlannerGraphCache *graph_cache) : m_initialized(false), m_graph_cache(graph_cache)
 {
     ExPolygons expp;
     for (const ExPolygon &island : islands) {
@@ -178,60 +178,152 @@ Polyline MotionPlanner::shortest_path(const Point &from, const Point &to)
     return polyline;
 }
 
+// Build a graph of the Voronoi edges of the boundaries of the environment, along which the travel moves are planned.
+std::shared_ptr<const MotionPlannerGraph> MotionPlanner::make_graph(const MotionPlannerEnv &env)
+{
+    auto graph = std::make_shared<MotionPlannerGraph>();
+
+    /*  We don't add polygon boundaries as graph edges, because we'd need to connect
+        them to the Voronoi-generated edges by recognizing coinciding nodes. */
+    
+    typedef voronoi_diagram<double> VD;
+    VD vd;
+    // Mapping between Voronoi vertices and graph nodes.
+    std::map<const VD::vertex_type*, size_t> vd_vertices;
+    // get boundaries as lines
+    Lines lines = env.m_env.lines();
+    boost::polygon::construct_voronoi(lines.begin(), lines.end(), &vd);
+    // traverse the Voronoi diagram and generate graph nodes and edges
+    for (const VD::edge_type &edge : vd.edges()) {
+        if (edge.is_infinite())
+            continue;
+        const VD::vertex_type* v0 = edge.vertex0();
+        const VD::vertex_type* v1 = edge.vertex1();
+        Point p0(v0->x(), v0->y());
+        Point p1(v1->x(), v1->y());
+        // Insert only Voronoi edges fully contained in the island.
+        //FIXME This test has a terrible O(n^2) time complexity.
+        if (env.island_contains_b(p0) && env.island_contains_b(p1)) {
+            // Find v0 in the graph, allocate a new node if v0 does not exist in the graph yet.
+            auto i_v0 = vd_vertices.find(v0);
+            size_t v0_idx;
+            if (i_v0 == vd_vertices.end())
+                vd_vertices[v0] = v0_idx = graph->add_node(p0);
+            else
+                v0_idx = i_v0->second;
+            // Find v1 in the graph, allocate a new node if v0 does not exist in the graph yet.
+            auto i_v1 = vd_vertices.find(v1);
+            size_t v1_idx;
+            if (i_v1 == vd_vertices.end())
+                vd_vertices[v1] = v1_idx = graph->add_node(p1);
+            else
+                v1_idx = i_v1->second;
+            // Euclidean distance is used as weight for the graph edge
+            graph->add_edge(v0_idx, v1_idx, (p1 - p0).cast<double>().norm());
+        }
+    }
+
+    return graph;
+}
+
 const MotionPlannerGraph& MotionPlanner::init_graph(int island_idx)
 {
     // 0th graph is the graph for m_outer. Other graphs are 1 indexed.
-    MotionPlannerGraph *graph = m_graphs[island_idx + 1].get();
+    std::shared_ptr<const MotionPlannerGraph> &graph = m_graphs[island_idx + 1];
     if (graph == nullptr) {
         // If this graph doesn't exist, initialize it.
-        m_graphs[island_idx + 1] = make_unique<MotionPlannerGraph>();
-        graph = m_graphs[island_idx + 1].get();
-        
-        /*  We don't add polygon boundaries as graph edges, because we'd need to connect
-            them to the Voronoi-generated edges by recognizing coinciding nodes. */
-        
-        typedef voronoi_diagram<double> VD;
-        VD vd;
-        // Mapping between Voronoi vertices and graph nodes.
-        std::map<const VD::vertex_type*, size_t> vd_vertices;
-        // get boundaries as lines
-        const MotionPlannerEnv &env = this->get_env(island_idx);
-        Lines lines = env.m_env.lines();
-        boost::polygon::construct_voronoi(lines.begin(), lines.end(), &vd);
-        // traverse the Voronoi diagram and generate graph nodes and edges
-        for (const VD::edge_type &edge : vd.edges()) {
-            if (edge.is_infinite())
-                continue;
-            const VD::vertex_type* v0 = edge.vertex0();
-            const VD::vertex_type* v1 = edge.vertex1();
-            Point p0(v0->x(), v0->y());
-            Point p1(v1->x(), v1->y());
-            // Insert only Voronoi edges fully contained in the island.
-            //FIXME This test has a terrible O(n^2) time complexity.
-            if (env.island_contains_b(p0) && env.island_contains_b(p1)) {
-                // Find v0 in the graph, allocate a new node if v0 does not exist in the graph yet.
-                auto i_v0 = vd_vertices.find(v0);
-                size_t v0_idx;
-                if (i_v0 == vd_vertices.end())
-                    vd_vertices[v0] = v0_idx = graph->add_node(p0);
-                else
-                    v0_idx = i_v0->second;
-                // Find v1 in the graph, allocate a new node if v0 does not exist in the graph yet.
-                auto i_v1 = vd_vertices.find(v1);
-                size_t v1_idx;
-                if (i_v1 == vd_vertices.end())
-                    vd_vertices[v1] = v1_idx = graph->add_node(p1);
-                else
-                    v1_idx = i_v1->second;
-                // Euclidean distance is used as weight for the graph edge
-                graph->add_edge(v0_idx, v1_idx, (p1 - p0).cast<double>().norm());
-            }
+        if (m_graph_cache == nullptr)
+            graph = make_graph(this->get_env(island_idx));
+        else {
+            // The graph of the space around the islands depends on all the islands.
+            ExPolygons islands;
+            if (island_idx == -1) {
+                islands.reserve(m_islands.size());
+                for (const MotionPlannerEnv &island : m_islands)
+                    islands.emplace_back(island.m_island);
+            } else
+                islands.emplace_back(m_islands[island_idx].m_island);
+            graph = m_graph_cache->find(island_idx == -1, islands);
+            if (graph == nullptr)
+                graph = m_graph_cache->insert(island_idx == -1, islands, make_graph(this->get_env(island_idx)));
         }
     }
 
     return *graph;
 }
 
+const MotionPlannerGraphPtrs& MotionPlanner::init_graphs()
+{
+    this->initialize();
+    if (m_initialized)
+        for (int island_idx = -1; island_idx < int(m_islands.size()); ++ island_idx)
+            this->init_graph(island_idx);
+    return m_graphs;
+}
+
+static size_t hash_islands(bool outer, const ExPolygons &islands)
+{
+    size_t seed = outer ? 1 : 0;
+    auto   hash_combine = [&seed](size_t v) { seed ^= v + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+    auto   hash_polygon = [&hash_combine](const Polygon &polygon) {
+        hash_combine(polygon.points.size());
+        for (const Point &pt : polygon.points) {
+            hash_combine(size_t(pt.x()));
+            hash_combine(size_t(pt.y()));
+        }
+    };
+    for (const ExPolygon &island : islands) {
+        hash_polygon(island.contour);
+        for (const Polygon &hole : island.holes)
+            hash_polygon(hole);
+    }
+    return seed;
+}
+
+std::shared_ptr<const MotionPlannerGraph> MotionPlannerGraphCache::find(bool outer, const ExPolygons &islands) const
+{
+    size_t                      hash = hash_islands(outer, islands);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto                        range = m_entries.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++ it)
+        if (it->second.outer == outer && it->second.islands == islands)
+            // May be null if the graph was already released.
+            return it->second.graph.lock();
+    return nullptr;
+}
+
+std::shared_ptr<const MotionPlannerGraph> MotionPlannerGraphCache::insert(bool outer, const ExPolygons &islands, std::shared_ptr<const MotionPlannerGraph> graph)
+{
+    size_t                      hash = hash_islands(outer, islands);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto                        range = m_entries.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++ it)
+        if (it->second.outer == outer && it->second.islands == islands) {
+            if (std::shared_ptr<const MotionPlannerGraph> other = it->second.graph.lock())
+                // Calculated by another thread in the meantime.
+                return other;
+            it->second.graph = graph;
+            return graph;
+        }
+    if (m_entries.size() >= m_purge_threshold) {
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+            if (it->second.graph.expired())
+                it = m_entries.erase(it);
+            else
+                ++ it;
+        m_purge_threshold = std::max<size_t>(64, m_entries.size() * 2);
+    }
+    m_entries.emplace(hash, Entry{ outer, islands, graph });
+    return graph;
+}
+
+void MotionPlannerGraphCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_purge_threshold = 64;
+}
+
 // Find a middle point on the path from start_point to end_point with the shortest path.
 static inline size_t nearest_waypoint_index(const Point &start_point, const Points &middle_points, const Point &end_point)
 {
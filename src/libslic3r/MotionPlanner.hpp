@@ -7,6 +7,8 @@
 #include "ExPolygonCollection.hpp"
 #include "Polyline.hpp"
 #include <map>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 #include <memory>
 #include <vector>
@@ -64,24 +66,56 @@ private:
     std::vector<std::vector<Neighbor>>  m_adjacency_list;
 };
 
+typedef std::vector<std::shared_ptr<const MotionPlannerGraph>> MotionPlannerGraphPtrs;
+
+// Graphs of the motion planners shared between the layers of the same islands, for example between the copies
+// of an object or between the layers of a prismatic object, so that the Voronoi diagram of an island is calculated once.
+// The graphs are looked up by the geometry of the islands. The cache does not own the graphs, a graph is released
+// together with the last motion planner referencing it. Thread safe, the graphs may be calculated in parallel.
+class MotionPlannerGraphCache
+{
+public:
+    // The graph of the space around the islands (outer == true) or of a single island.
+    std::shared_ptr<const MotionPlannerGraph> find(bool outer, const ExPolygons &islands) const;
+    // Store a newly calculated graph. If the same graph was stored in the meantime by another thread, that one is returned.
+    std::shared_ptr<const MotionPlannerGraph> insert(bool outer, const ExPolygons &islands, std::shared_ptr<const MotionPlannerGraph> graph);
+    void clear();
+
+private:
+    struct Entry {
+        bool                                    outer;
+        ExPolygons                              islands;
+        std::weak_ptr<const MotionPlannerGraph> graph;
+    };
+    mutable std::mutex                          m_mutex;
+    std::unordered_multimap<size_t, Entry>      m_entries;
+    // Number of entries, at which the entries of the released graphs are removed.
+    size_t                                      m_purge_threshold = 64;
+};
+
 class MotionPlanner
 {
 public:
-    MotionPlanner(const ExPolygons &islands);
+    MotionPlanner(const ExPolygons &islands, MotionPlannerGraphCache *graph_cache = nullptr);
     ~MotionPlanner() {}
 
     Polyline    shortest_path(const Point &from, const Point &to);
     size_t      islands_count() const { return m_islands.size(); }
 
+    // Calculate the graphs of all the islands and of the space around them in advance, not just when a path is first planned there.
+    const MotionPlannerGraphPtrs& init_graphs();
+
 private:
     bool                                m_initialized;
     std::vector<MotionPlannerEnv>       m_islands;
     MotionPlannerEnv                    m_outer;
     // 0th graph is the graph for m_outer. Other graphs are 1 indexed.
-    std::vector<std::unique_ptr<MotionPlannerGraph>> m_graphs;
+    MotionPlannerGraphPtrs              m_graphs;
+    MotionPlannerGraphCache            *m_graph_cache;
     
     void                      initialize();
     const MotionPlannerGraph& init_graph(int island_idx);
+    static std::shared_ptr<const MotionPlannerGraph> make_graph(const MotionPlannerEnv &env);
     const MotionPlannerEnv&   get_env(int island_idx) const
         { return (island_idx == -1) ? m_outer : m_islands[island_idx]; }
 };
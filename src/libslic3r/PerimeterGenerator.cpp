@@ -23,6 +23,9 @@
 #include <cassert>
 #include <list>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 namespace Slic3r {
 
     PerimeterGeneratorLoops get_all_Childs(PerimeterGeneratorLoop loop) {
@@ -299,12 +302,21 @@ void PerimeterGenerator::process()
         }
     }
 
-    surface_idx = 0;
     const int extra_odd_perimeter = (config->extra_perimeters_odd_layers && layer->id() % 2 == 1 ? 1:0);
-    for (const Surface &surface : all_surfaces) {
+    // The islands may be processed in parallel, each one into its own output. The outputs are then merged
+    // in the order of the islands, so that the result does not depend on the scheduling.
+    struct IslandOutput {
+        ExtrusionEntityCollection   loops;
+        ExtrusionEntityCollection   gap_fill;
+        ExPolygons                  fill_surfaces;
+        ExPolygons                  fill_no_overlap;
+    };
+    std::vector<IslandOutput> island_outputs(all_surfaces.size());
+    auto process_island = [&](size_t island_idx) {
+        const Surface &surface = all_surfaces[island_idx];
+        IslandOutput  &output  = island_outputs[island_idx];
         // detect how many perimeters must be generated for this island
         int        loop_number = this->config->perimeters + surface.extra_perimeters - 1 + extra_odd_perimeter;  // 0-indexed loops
-        surface_idx++;
 
         if (this->config->only_one_perimeter_top && this->upper_slices == NULL){
             loop_number = 0;
@@ -723,7 +735,7 @@ void PerimeterGenerator::process()
             }
             // append perimeters for this slice as a collection
             if (!entities.empty())
-                this->loops->append(entities);
+                output.loops.append(std::move(entities));
         } // for each loop of an island
 
         // fill gaps
@@ -800,7 +812,7 @@ void PerimeterGenerator::process()
             if (!polylines.empty()) {
                 ExtrusionEntityCollection gap_fill = thin_variable_width(polylines, 
                     erGapFill, this->solid_infill_flow);
-                this->gap_fill->append(gap_fill.entities);
+                output.gap_fill.append(gap_fill.entities);
                 /*  Make sure we don't infill narrow parts that are already gap-filled
                     (we only consider this surface's gaps to reduce the diff() complexity).
                     Growing actual extrusions ensures that gaps not filled by medial axis
@@ -842,16 +854,34 @@ void PerimeterGenerator::process()
         ExPolygons infill_exp = offset2_ex(not_filled_exp,
             -inset - min_perimeter_infill_spacing / 2 + overlap,
             (float)min_perimeter_infill_spacing / 2);
-        this->fill_surfaces->append(infill_exp, stPosInternal | stDensSparse);
+        output.fill_surfaces = std::move(infill_exp);
             
         if (overlap != 0) {
-            ExPolygons polyWithoutOverlap = offset2_ex(
+            output.fill_no_overlap = offset2_ex(
                 not_filled_exp,
                 -inset - min_perimeter_infill_spacing / 2,
                 (float) min_perimeter_infill_spacing / 2);
-            this->fill_no_overlap.insert(this->fill_no_overlap.end(), polyWithoutOverlap.begin(), polyWithoutOverlap.end());
         }
-    } // for each island
+    };
+
+    if (all_surfaces.size() > 1 && this->layer->process_islands_in_parallel())
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, all_surfaces.size()),
+            [this, &process_island](const tbb::blocked_range<size_t> &range) {
+                ExtrusionEntityArena::Scope arena_scope(this->layer->extrusion_arena());
+                for (size_t island_idx = range.begin(); island_idx < range.end(); ++ island_idx)
+                    process_island(island_idx);
+            });
+    else
+        for (size_t island_idx = 0; island_idx < all_surfaces.size(); ++ island_idx)
+            process_island(island_idx);
+
+    for (IslandOutput &output : island_outputs) {
+        this->loops->append(std::move(output.loops.entities));
+        this->gap_fill->append(std::move(output.gap_fill.entities));
+        this->fill_surfaces->append(std::move(output.fill_surfaces), stPosInternal | stDensSparse);
+        append(this->fill_no_overlap, std::move(output.fill_no_overlap));
+    }
 }
 
 
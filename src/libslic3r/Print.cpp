@@ -24,6 +24,8 @@
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
 
+#include <tbb/parallel_for.h>
+
 // Mark string for localization and translate.
 #define L(s) Slic3r::I18N::translate(s)
 
@@ -617,11 +619,13 @@ void Print::config_diffs(
     object_diff = m_default_object_config.diff(new_full_config);
     region_diff = m_default_region_config.diff(new_full_config);
     // Prepare for storing of the full print config into new_full_config to be exported into the G-code and to be used by the PlaceholderParser.
-    for (const t_config_option_key &opt_key : new_full_config.keys()) {
-        const ConfigOption *opt_old = m_full_print_config.option(opt_key);
-        const ConfigOption *opt_new = new_full_config.option(opt_key);
-        if (opt_old == nullptr || *opt_new != *opt_old)
-            full_config_diff.emplace_back(opt_key);
+    // Both configs are sorted by the option key, they are merged in a single pass instead of looking up each key.
+    auto it_old = m_full_print_config.cbegin();
+    for (auto it_new = new_full_config.cbegin(); it_new != new_full_config.cend(); ++ it_new) {
+        while (it_old != m_full_print_config.cend() && it_old->first < it_new->first)
+            ++ it_old;
+        if (it_old == m_full_print_config.cend() || it_old->first != it_new->first || *it_new->second != *it_old->second)
+            full_config_diff.emplace_back(it_new->first);
     }
 }
 
@@ -1644,16 +1648,61 @@ void Print::auto_assign_extruders(ModelObject* model_object) const
 }
 
 // Slicing process, running at a background thread.
+void Print::release_volume_slicers_over_memory_limit()
+{
+    struct Entry {
+        PrintObject *object;
+        ObjectID     volume_id;
+        size_t       last_used;
+        size_t       memsize;
+    };
+    std::vector<Entry> entries;
+    size_t             memsize = 0;
+    for (PrintObject *object : m_objects) {
+        std::lock_guard<std::mutex> lock(object->m_volume_slicers_mutex);
+        for (const auto &kvp : object->m_volume_slicers) {
+            entries.push_back({ object, kvp.first, kvp.second->last_used, kvp.second->memsize() });
+            memsize += entries.back().memsize;
+        }
+    }
+    const size_t max_memory = PrintObject::max_volume_slicers_memory();
+    if (memsize <= max_memory)
+        return;
+    std::sort(entries.begin(), entries.end(), [](const Entry &l, const Entry &r) { return l.last_used < r.last_used; });
+    size_t num_released = 0;
+    for (const Entry &entry : entries) {
+        if (memsize <= max_memory)
+            break;
+        std::lock_guard<std::mutex> lock(entry.object->m_volume_slicers_mutex);
+        entry.object->m_volume_slicers.erase(entry.volume_id);
+        memsize -= entry.memsize;
+        ++ num_released;
+    }
+    BOOST_LOG_TRIVIAL(debug) << "Slicing objects - released " << num_released << " least recently used volume slicers, " <<
+        memsize / (1024 * 1024) << " MB left";
+}
+
 void Print::process()
 {
     BOOST_LOG_TRIVIAL(info) << "Staring the slicing process." << log_memory_info();
-    for (PrintObject *obj : m_objects)
-        obj->make_perimeters();
-    this->set_status(70, L("Infilling layers"));
-    for (PrintObject *obj : m_objects)
-        obj->infill();
-    for (PrintObject *obj : m_objects)
-        obj->generate_support_material();
+    // The objects do not depend on each other until the skirt / brim / wipe tower are generated.
+    // Run the object steps of all objects concurrently, so that the cores are not left idle at the tail
+    // of each step of a small object (each step is parallelized over the layers of a single object only).
+    // The object steps don't report their progress, the steps of the objects run interleaved, therefore the progress
+    // is reported once for the whole stage.
+    this->set_status(10, L("Slicing and generating the perimeters, infill and support material"));
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, m_objects.size(), 1),
+        [this](const tbb::blocked_range<size_t> &range) {
+            for (size_t idx_object = range.begin(); idx_object < range.end(); ++ idx_object) {
+                PrintObject *obj = m_objects[idx_object];
+                obj->make_perimeters();
+                obj->infill();
+                obj->generate_support_material();
+            }
+        });
+    this->release_volume_slicers_over_memory_limit();
+    this->throw_if_canceled();
     if (this->set_started(psWipeTower)) {
         m_wipe_tower_data.clear();
         m_tool_ordering.clear();
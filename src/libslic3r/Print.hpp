@@ -17,6 +17,10 @@
 
 #include "libslic3r.h"
 
+#include <map>
+#include <memory>
+#include <mutex>
+
 namespace Slic3r {
 
 class Print;
@@ -108,6 +112,14 @@ struct PrintInstance
 
 typedef std::vector<PrintInstance> PrintInstances;
 
+// Steps invalidated by a change of a PrintObjectConfig or PrintRegionConfig option, see PrintObject::config_option_dependency().
+// The steps depending on the listed ones are invalidated as well by PrintObject::invalidate_step() and Print::invalidate_step().
+struct PrintObjectConfigDependency
+{
+    std::vector<PrintObjectStep> object_steps;
+    std::vector<PrintStep>       print_steps;
+};
+
 class PrintObject : public PrintObjectBaseWithState<Print, PrintObjectStep, posCount>
 {
 private: // Prevents erroneous use by other classes.
@@ -125,6 +137,9 @@ public:
     const Transform3d&      trafo() const           { return m_trafo; }
     const PrintInstances&   instances() const       { return m_instances; }
 
+    // Steps invalidated by a change of the option, nullptr if the option is not known, then all the steps are invalidated.
+    static const PrintObjectConfigDependency* config_option_dependency(const t_config_option_key &opt_key);
+
     // Bounding box is used to align the object infill patterns, and to calculate attractor for the rear seam.
     // The bounding box may not be quite snug.
     BoundingBox             bounding_box()    const { return BoundingBox(Point(- m_size.x() / 2, - m_size.y() / 2), Point(m_size.x() / 2, m_size.y() / 2)); }
@@ -273,6 +288,44 @@ private:
     std::vector<ExPolygons> slice_volumes(const std::vector<float> &z, SlicingMode mode, const std::vector<const ModelVolume*> &volumes) const;
     std::vector<ExPolygons> slice_volume(const std::vector<float> &z, SlicingMode mode, const ModelVolume &volume) const;
     std::vector<ExPolygons> slice_volume(const std::vector<float> &z, const std::vector<t_layer_height_range> &ranges, SlicingMode mode, const ModelVolume &volume) const;
+    std::vector<ExPolygons> slice_mesh(const std::string &mesh_hash, const std::vector<float> &z, SlicingMode mode, const std::function<const TriangleMeshSlicer*()> &get_slicer) const;
+
+    // Mesh of a ModelVolume transformed into the coordinate system of this PrintObject together with its initialized slicer.
+    // Kept between the slicing runs, so that a change of the layer heights or of a non-geometric setting
+    // only reruns the z dependent part of the slicing, not the transformation and the edge topology of the mesh.
+    // Each entry holds a copy of the transformed mesh with its shared vertices and the edge topology of the slicer,
+    // that is a few times the size of the source mesh. The entries are kept for the life time of the PrintObject,
+    // unless the entries of all the objects of the Print exceed max_volume_slicers_memory() after slicing,
+    // then the least recently used ones are dropped, see Print::release_volume_slicers_over_memory_limit().
+    struct VolumeSlicer {
+        // The entry is rebuilt if any of the inputs changes.
+        std::shared_ptr<const TriangleMesh> source_mesh;
+        Transform3d                         volume_matrix;
+        Transform3d                         object_trafo;
+        Point                               center_offset;
+        float                               closing_radius;
+        float                               model_precision;
+
+        TriangleMesh                        mesh;
+        TriangleMeshSlicer                  slicer { 0.f, 0.f };
+        // SliceCache::mesh_hash() of the mesh before require_shared_vertices(), empty if the slice cache was disabled.
+        std::string                         mesh_hash;
+        // Time stamp of the last use, ordering the entries of all objects for eviction. Guarded by m_volume_slicers_mutex.
+        mutable size_t                      last_used { 0 };
+
+        size_t                              memsize() const { return sizeof(*this) + mesh.memsize() + slicer.memsize(); }
+    };
+    // Slicer of the volume kept from the previous slicing run if still valid, otherwise null.
+    std::shared_ptr<const VolumeSlicer> cached_volume_slicer(const ModelVolume &volume) const;
+    // Transformed mesh of the volume with its mesh_hash, the slicer is initialized by init_volume_slicer() only if needed.
+    std::shared_ptr<VolumeSlicer>       new_volume_slicer(const ModelVolume &volume) const;
+    void                                init_volume_slicer(const ModelVolume &volume, const std::shared_ptr<VolumeSlicer> &volume_slicer) const;
+    // Drop the slicers of the volumes no longer present in the ModelObject.
+    void                    release_unused_volume_slicers();
+    // A tenth of the physical memory, shared by the slicers of all the objects of a Print.
+    static size_t           max_volume_slicers_memory();
+    mutable std::map<ObjectID, std::shared_ptr<const VolumeSlicer>> m_volume_slicers;
+    mutable std::mutex                      m_volume_slicers_mutex;
 
 
 };
@@ -469,6 +522,8 @@ private:
     void                _make_brim_interior(const Flow &flow, const PrintObjectPtrs &objects, ExPolygons &unbrimmable, ExtrusionEntityCollection &out);
     Polylines           _reorder_brim_polyline(Polylines lines, ExtrusionEntityCollection &out, const Flow &flow);
     void                _make_wipe_tower();
+    // Drop the least recently used volume slicers of all objects until they occupy at most PrintObject::max_volume_slicers_memory().
+    void                release_volume_slicers_over_memory_limit();
 
     // Declared here to have access to Model / ModelObject / ModelInstance
     static void         model_volume_list_update_supports(ModelObject &model_object_dst, const ModelObject &model_object_src);
@@ -37,6 +37,8 @@ The resulting files are FLP files. This flavor does not use g-code.
 #include "libslic3r.h"
 #include "Config.hpp"
 
+#include <unordered_map>
+
 // #define HAS_PRESSURE_EQUALIZER
 
 namespace Slic3r {
@@ -379,7 +381,8 @@ protected:
         }
 
     protected:
-        std::map<std::string, ptrdiff_t>    m_map_name_to_offset;
+        // Hashed, as the lookup by name is performed for each option of each config applied or compared.
+        std::unordered_map<std::string, ptrdiff_t> m_map_name_to_offset;
     };
 
     // Parametrized by the type of the topmost class owning the options.
@@ -408,6 +411,14 @@ protected:
         const std::vector<std::string>& keys()      const { return m_keys; }
         const T&                        defaults()  const { return *m_defaults; }
 
+        // Collect the keys of the options differing between lhs and rhs, walking the options by their offsets.
+        void                diff(const T *lhs, const T *rhs, t_config_option_keys &diff) const
+        {
+            for (size_t i = 0; i < m_offsets.size(); ++ i)
+                if (*reinterpret_cast<const ConfigOption*>((const char*)lhs + m_offsets[i]) != *reinterpret_cast<const ConfigOption*>((const char*)rhs + m_offsets[i]))
+                    diff.emplace_back(m_keys[i]);
+        }
+
         // To be called during the StaticCache setup.
         // Collect option keys from m_map_name_to_offset,
         // assign default values to m_defaults.
@@ -417,6 +428,8 @@ protected:
             m_defaults = defaults;
             m_keys.clear();
             m_keys.reserve(m_map_name_to_offset.size());
+            m_offsets.clear();
+            m_offsets.reserve(m_map_name_to_offset.size());
             for (const auto &kvp : defs->options) {
                 // Find the option given the option name kvp.first by an offset from (char*)m_defaults.
                 ConfigOption *opt = this->optptr(kvp.first, m_defaults);
@@ -424,6 +437,7 @@ protected:
                     // This option is not defined by the ConfigBase of type T.
                     continue;
                 m_keys.emplace_back(kvp.first);
+                m_offsets.emplace_back((const char*)opt - (const char*)m_defaults);
                 const ConfigOptionDef *def = defs->get(kvp.first);
                 assert(def != nullptr);
                 if (def->default_value)
@@ -434,6 +448,8 @@ protected:
     private:
         T                                  *m_defaults;
         std::vector<std::string>            m_keys;
+        // Offsets of the options from (char*)this, in the order of m_keys.
+        std::vector<ptrdiff_t>              m_offsets;
     };
 };
 
@@ -454,6 +470,15 @@ public: \
     t_config_option_keys     keys() const override { return s_cache_##CLASS_NAME.keys(); } \
     const t_config_option_keys& keys_ref() const override { return s_cache_##CLASS_NAME.keys(); } \
     static const CLASS_NAME& defaults() { initialize_cache(); return s_cache_##CLASS_NAME.defaults(); } \
+protected: \
+    /* Overrides ConfigBase::diff_same_type(). Compare the options of two configs of this type by their offsets. */ \
+    bool                     diff_same_type(const ConfigBase &other, t_config_option_keys &diff) const override \
+        {   const CLASS_NAME *rhs = dynamic_cast<const CLASS_NAME*>(&other); \
+            if (rhs == nullptr) \
+                return false; \
+            s_cache_##CLASS_NAME.diff(this, rhs, diff); \
+            return true; \
+        } \
 private: \
     static void initialize_cache() \
     { \
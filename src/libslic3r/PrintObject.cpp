@@ -4,11 +4,13 @@
 #include "ElephantFootCompensation.hpp"
 #include "Geometry.hpp"
 #include "I18N.hpp"
+#include "SliceCache.hpp"
 #include "SupportMaterial.hpp"
 #include "Surface.hpp"
 #include "Slicing.hpp"
 #include "Utils.hpp"
 
+#include <unordered_map>
 #include <utility>
 #include <boost/log/trivial.hpp>
 #include <float.h>
@@ -108,7 +110,6 @@ void PrintObject::slice()
 {
     if (! this->set_started(posSlice))
         return;
-    m_print->set_status(10, L("Processing triangulated mesh"));
     std::vector<coordf_t> layer_height_profile;
     this->update_layer_height_profile(*this->model_object(), m_slicing_params, layer_height_profile);
     m_print->throw_if_canceled();
@@ -270,7 +271,6 @@ void PrintObject::make_perimeters()
     if (! this->set_started(posPerimeters))
         return;
 
-    m_print->set_status(20, L("Generating perimeters"));
     BOOST_LOG_TRIVIAL(info) << "Generating perimeters..." << log_memory_info();
     
     // merge slices if they were split into types
@@ -388,8 +388,6 @@ void PrintObject::prepare_infill()
     if (! this->set_started(posPrepareInfill))
         return;
 
-    m_print->set_status(30, L("Preparing infill"));
-
     // This will assign a type (top/bottom/internal) to $layerm->slices.
     // Then the classifcation of $layerm->slices is transfered onto 
     // the $layerm->fill_surfaces by clipping $layerm->fill_surfaces
@@ -553,7 +551,6 @@ void PrintObject::generate_support_material()
     if (this->set_started(posSupportMaterial)) {
         this->clear_support_layers();
         if ((m_config.support_material || m_config.raft_layers > 0) && m_layers.size() > 1) {
-            m_print->set_status(85, L("Generating support material"));    
             this->_generate_support_material();
             m_print->throw_if_canceled();
         } else {
@@ -600,6 +597,180 @@ SupportLayerPtrs::const_iterator PrintObject::insert_support_layer(SupportLayerP
     return m_support_layers.insert(pos, new SupportLayer(id, this, height, print_z, slice_z));
 }
 
+// Declarative table of the steps invalidated by a change of a PrintObjectConfig or PrintRegionConfig option.
+const PrintObjectConfigDependency* PrintObject::config_option_dependency(const t_config_option_key &opt_key)
+{
+    static const std::unordered_map<t_config_option_key, PrintObjectConfigDependency> dependencies = []() {
+        std::unordered_map<t_config_option_key, PrintObjectConfigDependency> out;
+        auto add = [&out](std::initializer_list<const char*> opt_keys, std::vector<PrintObjectStep> object_steps, std::vector<PrintStep> print_steps) {
+            for (const char *opt_key : opt_keys) {
+                assert(out.find(opt_key) == out.end());
+                out[opt_key] = PrintObjectConfigDependency{ object_steps, print_steps };
+            }
+        };
+        add({
+            "perimeters",
+            "extra_perimeters",
+            "extra_perimeters_odd_layers",
+            "extra_perimeters_overhangs",
+            "external_perimeter_overlap",
+            "gap_fill",
+            "gap_fill_min_area",
+            "gap_fill_speed",
+            "overhangs",
+            "overhangs_width",
+            "overhangs_reverse",
+            "overhangs_reverse_threshold",
+            "perimeter_extrusion_width",
+            "infill_overlap",
+            "thin_perimeters",
+            "thin_walls",
+            "thin_walls_min_width",
+            "thin_walls_overlap",
+            "external_perimeters_first",
+            "external_perimeters_vase",
+            "external_perimeters_nothole",
+            "external_perimeters_hole",
+            "perimeter_loop",
+            "perimeter_loop_seam",
+            "only_one_perimeter_top",
+            "no_perimeter_unsupported_algo",
+            // The milling post-process is generated together with the perimeters.
+            "milling_after_z",
+            "milling_extra_size",
+            "milling_post_process",
+        }, { posPerimeters }, {});
+        add({
+            "layer_height",
+            "first_layer_height",
+            "exact_last_layer_height",
+            "raft_layers",
+            "slice_closing_radius",
+            "model_precision",
+            "clip_multipart_objects",
+            "curve_smoothing_precision",
+            "curve_smoothing_cutoff_dist",
+            "curve_smoothing_angle_convex",
+            "curve_smoothing_angle_concave",
+            "elefant_foot_compensation",
+            // The elephant foot compensation is derived from the external perimeter flow, which may fall back to extrusion_width.
+            "extrusion_width",
+            "support_material_contact_distance_type",
+            "support_material_contact_distance_top",
+            "support_material_contact_distance_bottom",
+            "xy_size_compensation",
+            "hole_size_compensation",
+            "hole_to_polyhole",
+        }, { posSlice }, {});
+        add({
+            // Enabling / disabling supports may reset everything, see invalidate_state_by_config_options().
+            "support_material",
+            "support_material_auto",
+            "support_material_angle",
+            "support_material_buildplate_only",
+            "support_material_enforce_layers",
+            "support_material_extruder",
+            "support_material_extrusion_width",
+            "support_material_interface_layers",
+            "support_material_interface_contact_loops",
+            "support_material_interface_extruder",
+            "support_material_interface_spacing",
+            "support_material_pattern",
+            "support_material_interface_pattern",
+            "support_material_xy_spacing",
+            "support_material_spacing",
+            "support_material_synchronize_layers",
+            "support_material_threshold",
+            "support_material_with_sheath",
+            "dont_support_bridges",
+            "support_material_solid_first_layer",
+        }, { posSupportMaterial }, {});
+        add({
+            "interface_shells",
+            "infill_only_where_needed",
+            "infill_every_layers",
+            "solid_infill_every_layers",
+            "infill_dense",
+            "infill_not_connected",
+            "infill_dense_algo",
+            "bottom_solid_layers",
+            "bottom_solid_min_thickness",
+            "top_solid_layers",
+            "top_solid_min_thickness",
+            "solid_infill_below_area",
+            "infill_extruder",
+            "solid_infill_extruder",
+            "infill_extrusion_width",
+            "ensure_vertical_shell_thickness",
+            "bridged_infill_margin",
+            "bridge_angle",
+            // Applied by bridge_over_infill().
+            "over_bridge_flow_ratio",
+        }, { posPrepareInfill }, {});
+        add({
+            "top_fill_pattern",
+            "bottom_fill_pattern",
+            "solid_fill_pattern",
+            "enforce_full_fill_volume",
+            "fill_angle",
+            "fill_pattern",
+            "fill_top_flow_ratio",
+            "fill_smooth_width",
+            "fill_smooth_distribution",
+            "top_infill_extrusion_width",
+            "bridge_overlap",
+        }, { posInfill }, {});
+        add({
+            "fill_density",
+            "external_infill_margin",
+            "solid_infill_extrusion_width",
+        }, { posPerimeters, posPrepareInfill }, {});
+        add({
+            "external_perimeter_extrusion_width",
+            "perimeter_extruder",
+        }, { posPerimeters, posSupportMaterial }, {});
+        add({
+            "bridge_flow_ratio",
+        }, { posPerimeters, posInfill, posSupportMaterial }, {});
+        add({
+            "brim_inside_holes",
+            "brim_width",
+            "brim_width_interior",
+            "brim_ears",
+            "brim_ears_max_angle",
+            "brim_offset",
+        }, {}, { psBrim, psSkirt });
+        add({
+            // Only influencing the G-code export.
+            "seam_position",
+            "seam_travel",
+            "seam_preferred_direction",
+            "seam_preferred_direction_jitter",
+            "support_material_speed",
+            "support_material_interface_speed",
+            "bridge_speed",
+            "external_perimeter_cut_corners",
+            "external_perimeter_speed",
+            "infill_speed",
+            "milling_speed",
+            "perimeter_speed",
+            "print_extrusion_multiplier",
+            "small_perimeter_speed",
+            "solid_infill_speed",
+            "thin_walls_speed",
+            "top_solid_infill_speed",
+        }, {}, { psGCodeExport });
+        add({
+            "infill_first",
+            "wipe_into_infill",
+            "wipe_into_objects",
+        }, {}, { psWipeTower, psGCodeExport });
+        return out;
+    }();
+    auto it = dependencies.find(opt_key);
+    return it == dependencies.end() ? nullptr : &it->second;
+}
+
 // Called by Print::apply().
 // This method only accepts PrintObjectConfig and PrintRegionConfig option keys.
 bool PrintObject::invalidate_state_by_config_options(const std::vector<t_config_option_key> &opt_keys)
@@ -608,162 +779,34 @@ bool PrintObject::invalidate_state_by_config_options(const std::vector<t_config_
         return false;
 
     std::vector<PrintObjectStep> steps;
+    std::vector<PrintStep>       print_steps;
     bool invalidated = false;
     for (const t_config_option_key &opt_key : opt_keys) {
-        if (   opt_key == "perimeters"
-            || opt_key == "extra_perimeters"
-            || opt_key == "extra_perimeters_odd_layers"
-            || opt_key == "gap_fill"
-            || opt_key == "gap_fill_speed"
-            || opt_key == "overhangs"
-            || opt_key == "overhangs_width"
-            || opt_key == "overhangs_reverse"
-            || opt_key == "overhangs_reverse_threshold"
-            || opt_key == "first_layer_extrusion_width"
-            || opt_key == "perimeter_extrusion_width"
-            || opt_key == "infill_overlap"
-            || opt_key == "thin_perimeters"
-            || opt_key == "thin_walls"
-            || opt_key == "thin_walls_min_width"
-            || opt_key == "thin_walls_overlap"
-            || opt_key == "external_perimeters_first"
-            || opt_key == "external_perimeters_vase"
-            || opt_key == "external_perimeters_nothole"
-            || opt_key == "external_perimeters_hole"
-            || opt_key == "perimeter_loop"
-            || opt_key == "perimeter_loop_seam"
-            || opt_key == "only_one_perimeter_top"
-            || opt_key == "no_perimeter_unsupported_algo") {
-            steps.emplace_back(posPerimeters);
-        } else if (
-               opt_key == "layer_height"
-            || opt_key == "first_layer_height"
-            || opt_key == "exact_last_layer_height"
-            || opt_key == "raft_layers"
-            || opt_key == "slice_closing_radius"
-            || opt_key == "clip_multipart_objects"
-            || opt_key == "elefant_foot_compensation"
-            || opt_key == "support_material_contact_distance_type" 
-            || opt_key == "support_material_contact_distance_top" 
-            || opt_key == "support_material_contact_distance_bottom" 
-            || opt_key == "xy_size_compensation"
-            || opt_key == "hole_size_compensation"
-            || opt_key == "hole_to_polyhole") {
-            steps.emplace_back(posSlice);
-        } else if (opt_key == "support_material") {
-            steps.emplace_back(posSupportMaterial);
-            if (m_config.support_material_contact_distance_top == 0. || m_config.support_material_contact_distance_bottom == 0.) {
-                // Enabling / disabling supports while soluble support interface is enabled.
-                // This changes the bridging logic (bridging enabled without supports, disabled with supports).
-                // Reset everything.
-                // See GH #1482 for details.
-                steps.emplace_back(posSlice);
-            }
-        } else if (
-               opt_key == "support_material_auto"
-            || opt_key == "support_material_angle"
-            || opt_key == "support_material_buildplate_only"
-            || opt_key == "support_material_enforce_layers"
-            || opt_key == "support_material_extruder"
-            || opt_key == "support_material_extrusion_width"
-            || opt_key == "support_material_interface_layers"
-            || opt_key == "support_material_interface_contact_loops"
-            || opt_key == "support_material_interface_extruder"
-            || opt_key == "support_material_interface_spacing"
-            || opt_key == "support_material_pattern"
-            || opt_key == "support_material_interface_pattern"
-            || opt_key == "support_material_xy_spacing"
-            || opt_key == "support_material_spacing"
-            || opt_key == "support_material_synchronize_layers"
-            || opt_key == "support_material_threshold"
-            || opt_key == "support_material_with_sheath"
-            || opt_key == "dont_support_bridges"
-            || opt_key == "first_layer_extrusion_width"
-            || opt_key == "support_material_solid_first_layer") {
-            steps.emplace_back(posSupportMaterial);
-        } else if (
-               opt_key == "interface_shells"
-            || opt_key == "infill_only_where_needed"
-            || opt_key == "infill_every_layers"
-            || opt_key == "solid_infill_every_layers"
-            || opt_key == "infill_dense"
-            || opt_key == "infill_not_connected"
-            || opt_key == "infill_dense_algo"
-            || opt_key == "bottom_solid_layers"
-            || opt_key == "bottom_solid_min_thickness"
-            || opt_key == "top_solid_layers"
-            || opt_key == "top_solid_min_thickness"
-            || opt_key == "solid_infill_below_area"
-            || opt_key == "infill_extruder"
-            || opt_key == "solid_infill_extruder"
-            || opt_key == "infill_extrusion_width"
-            || opt_key == "ensure_vertical_shell_thickness"
-            || opt_key == "bridged_infill_margin"
-            || opt_key == "bridge_angle") {
-            steps.emplace_back(posPrepareInfill);
-        } else if (
-            opt_key == "top_fill_pattern"
-            || opt_key == "bottom_fill_pattern"
-            || opt_key == "solid_fill_pattern"
-            || opt_key == "enforce_full_fill_volume"
-            || opt_key == "fill_angle"
-            || opt_key == "fill_pattern"
-            || opt_key == "fill_top_flow_ratio"
-            || opt_key == "fill_smooth_width"
-            || opt_key == "fill_smooth_distribution"
-            || opt_key == "top_infill_extrusion_width"
-            || opt_key == "first_layer_extrusion_width") {
-            steps.emplace_back(posInfill);
-        } else if (
-               opt_key == "fill_density"
-            || opt_key == "external_infill_margin"
-            || opt_key == "solid_infill_extrusion_width") {
-            steps.emplace_back(posPerimeters);
-            steps.emplace_back(posPrepareInfill);
-        } else if (
-               opt_key == "external_perimeter_extrusion_width"
-            || opt_key == "perimeter_extruder") {
-            steps.emplace_back(posPerimeters);
-            steps.emplace_back(posSupportMaterial);
-        } else if (opt_key == "bridge_flow_ratio") {
-            //if (m_config.support_material_contact_distance > 0.) {
-                // Only invalidate due to bridging if bridging is enabled.
-                // If later "support_material_contact_distance" is modified, the complete PrintObject is invalidated anyway.
-                steps.emplace_back(posPerimeters);
-                steps.emplace_back(posInfill);
-                steps.emplace_back(posSupportMaterial);
-            //}
-        } else if (
-               opt_key == "seam_position"
-            || opt_key == "seam_travel"
-            || opt_key == "seam_preferred_direction"
-            || opt_key == "seam_preferred_direction_jitter"
-            || opt_key == "support_material_speed"
-            || opt_key == "support_material_interface_speed"
-            || opt_key == "bridge_speed"
-            || opt_key == "external_perimeter_speed"
-            || opt_key == "external_perimeters_vase"
-            || opt_key == "infill_speed"
-            || opt_key == "perimeter_speed"
-            || opt_key == "small_perimeter_speed"
-            || opt_key == "solid_infill_speed"
-            || opt_key == "top_solid_infill_speed") {
-            invalidated |= m_print->invalidate_step(psGCodeExport);
-        } else if (
-               opt_key == "wipe_into_infill"
-            || opt_key == "wipe_into_objects") {
-            invalidated |= m_print->invalidate_step(psWipeTower);
-            invalidated |= m_print->invalidate_step(psGCodeExport);
-        } else {
+        const PrintObjectConfigDependency *dependency = config_option_dependency(opt_key);
+        if (dependency == nullptr) {
             // for legacy, if we can't handle this option let's invalidate all steps
             this->invalidate_all_steps();
             invalidated = true;
+            continue;
+        }
+        append(steps, dependency->object_steps);
+        append(print_steps, dependency->print_steps);
+        if (opt_key == "support_material" &&
+            (m_config.support_material_contact_distance_top == 0. || m_config.support_material_contact_distance_bottom == 0.)) {
+            // Enabling / disabling supports while soluble support interface is enabled.
+            // This changes the bridging logic (bridging enabled without supports, disabled with supports).
+            // Reset everything.
+            // See GH #1482 for details.
+            steps.emplace_back(posSlice);
         }
     }
 
     sort_remove_duplicates(steps);
     for (PrintObjectStep step : steps)
         invalidated |= this->invalidate_step(step);
+    sort_remove_duplicates(print_steps);
+    for (PrintStep step : print_steps)
+        invalidated |= m_print->invalidate_step(step);
     return invalidated;
 }
 
@@ -2084,6 +2127,7 @@ void PrintObject::_slice(const std::vector<coordf_t> &layer_height_profile)
     BOOST_LOG_TRIVIAL(info) << "Slicing objects..." << log_memory_info();
 
     m_typed_slices = false;
+    this->release_unused_volume_slicers();
 
 #ifdef SLIC3R_PROFILE
     // Disable parallelization so the Shiny profiler works
@@ -2743,13 +2787,15 @@ std::vector<ExPolygons> PrintObject::slice_volumes(const std::vector<float> &z,
             mesh.translate(- unscale<float>(m_center_offset.x()), - unscale<float>(m_center_offset.y()), 0);
             // perform actual slicing
             const Print *print = this->print();
-            auto callback = TriangleMeshSlicer::throw_on_cancel_callback_type([print](){print->throw_if_canceled();});
-            // TriangleMeshSlicer needs shared vertices, also this calls the repair() function.
-            mesh.require_shared_vertices();
             TriangleMeshSlicer mslicer(float(m_config.slice_closing_radius.value), float(m_config.model_precision.value));
-            mslicer.init(&mesh, callback);
-            mslicer.slice(z, mode, &layers, callback);
-            m_print->throw_if_canceled();
+            // The cache key is calculated before require_shared_vertices() possibly repairs the mesh, the same as in new_volume_slicer().
+            const std::string mesh_hash = SliceCache::get() == nullptr ? std::string() : SliceCache::mesh_hash(mesh);
+            layers = this->slice_mesh(mesh_hash, z, mode, [print, &mesh, &mslicer]() {
+                // TriangleMeshSlicer needs shared vertices, also this calls the repair() function.
+                mesh.require_shared_vertices();
+                mslicer.init(&mesh, [print](){print->throw_if_canceled();});
+                return &mslicer;
+            });
         }
     }
     return layers;
@@ -2759,29 +2805,135 @@ std::vector<ExPolygons> PrintObject::slice_volume(const std::vector<float> &z, S
 {
     std::vector<ExPolygons> layers;
     if (! z.empty()) {
-        // Compose mesh.
-        //FIXME better to split the mesh into separate shells, perform slicing over each shell separately and then to use a Boolean operation to merge them.
-        TriangleMesh mesh(volume.mesh());
-        mesh.transform(volume.get_matrix(), true);
-        if (mesh.repaired) {
-            //FIXME The admesh repair function may break the face connectivity, rather refresh it here as the slicing code relies on it.
-            stl_check_facets_exact(&mesh.stl);
+        if (std::shared_ptr<const VolumeSlicer> volume_slicer = this->cached_volume_slicer(volume)) {
+            if (volume_slicer->mesh.stl.stats.number_of_facets > 0)
+                // perform actual slicing
+                layers = this->slice_mesh(volume_slicer->mesh_hash, z, mode, [&volume_slicer]() { return &volume_slicer->slicer; });
+        } else {
+            // Only transform the mesh to calculate the cache key, the slicer is initialized if the slices are not found in the slice cache.
+            std::shared_ptr<VolumeSlicer> new_slicer = this->new_volume_slicer(volume);
+            if (new_slicer->mesh.stl.stats.number_of_facets > 0)
+                // perform actual slicing
+                layers = this->slice_mesh(new_slicer->mesh_hash, z, mode, [this, &volume, &new_slicer]() {
+                    this->init_volume_slicer(volume, new_slicer);
+                    return &new_slicer->slicer;
+                });
         }
-        if (mesh.stl.stats.number_of_facets > 0) {
-            mesh.transform(m_trafo, true);
-            // apply XY shift
-            mesh.translate(- unscale<float>(m_center_offset.x()), - unscale<float>(m_center_offset.y()), 0);
-            // perform actual slicing
-            TriangleMeshSlicer mslicer(float(m_config.slice_closing_radius.value), float(m_config.model_precision.value));
-            const Print *print = this->print();
-            auto callback = TriangleMeshSlicer::throw_on_cancel_callback_type([print](){print->throw_if_canceled();});
-            // TriangleMeshSlicer needs the shared vertices.
-            mesh.require_shared_vertices();
-            mslicer.init(&mesh, callback);
-	        mslicer.slice(z, mode, &layers, callback);
-            m_print->throw_if_canceled();
+    }
+    return layers;
+}
+
+// Time stamps of the uses of the volume slicers, see VolumeSlicer::last_used.
+static tbb::atomic<size_t> volume_slicers_clock;
+
+// Returns the mesh of the volume transformed into the coordinate system of this PrintObject with its slicer initialized,
+// if it was sliced before and neither the mesh, the transformation nor the slicing precision changed since. Otherwise returns null.
+std::shared_ptr<const PrintObject::VolumeSlicer> PrintObject::cached_volume_slicer(const ModelVolume &volume) const
+{
+    const float closing_radius  = float(m_config.slice_closing_radius.value);
+    const float model_precision = float(m_config.model_precision.value);
+    std::lock_guard<std::mutex> lock(m_volume_slicers_mutex);
+    auto it = m_volume_slicers.find(volume.id());
+    if (it != m_volume_slicers.end()) {
+        const VolumeSlicer &cached = *it->second;
+        if (cached.source_mesh == volume.get_mesh_shared_ptr() && cached.volume_matrix.matrix() == volume.get_matrix().matrix() &&
+            cached.object_trafo.matrix() == m_trafo.matrix() && cached.center_offset == m_center_offset &&
+            cached.closing_radius == closing_radius && cached.model_precision == model_precision) {
+            BOOST_LOG_TRIVIAL(debug) << "Slicing objects - reusing the slicer of volume " << volume.id().id;
+            cached.last_used = ++ volume_slicers_clock;
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+// Transforms the mesh of the volume into the coordinate system of this PrintObject and calculates its SliceCache::mesh_hash().
+// The slicer is left uninitialized, see init_volume_slicer().
+std::shared_ptr<PrintObject::VolumeSlicer> PrintObject::new_volume_slicer(const ModelVolume &volume) const
+{
+    auto out = std::make_shared<VolumeSlicer>();
+    out->source_mesh     = volume.get_mesh_shared_ptr();
+    out->volume_matrix   = volume.get_matrix();
+    out->object_trafo    = m_trafo;
+    out->center_offset   = m_center_offset;
+    out->closing_radius  = float(m_config.slice_closing_radius.value);
+    out->model_precision = float(m_config.model_precision.value);
+    // Compose mesh.
+    //FIXME better to split the mesh into separate shells, perform slicing over each shell separately and then to use a Boolean operation to merge them.
+    TriangleMesh &mesh = out->mesh;
+    mesh = volume.mesh();
+    mesh.transform(out->volume_matrix, true);
+    if (mesh.repaired) {
+        //FIXME The admesh repair function may break the face connectivity, rather refresh it here as the slicing code relies on it.
+        stl_check_facets_exact(&mesh.stl);
+    }
+    if (mesh.stl.stats.number_of_facets > 0) {
+        mesh.transform(m_trafo, true);
+        // apply XY shift
+        mesh.translate(- unscale<float>(m_center_offset.x()), - unscale<float>(m_center_offset.y()), 0);
+        // The cache key is calculated before require_shared_vertices() possibly repairs the mesh, the same as in slice_volumes().
+        if (SliceCache::get() != nullptr)
+            out->mesh_hash = SliceCache::mesh_hash(mesh);
+    }
+    return out;
+}
+
+// Initializes the slicer of a mesh returned by new_volume_slicer() and keeps it for the next slicing runs.
+void PrintObject::init_volume_slicer(const ModelVolume &volume, const std::shared_ptr<VolumeSlicer> &volume_slicer) const
+{
+    // TriangleMeshSlicer needs shared vertices, also this calls the repair() function.
+    volume_slicer->mesh.require_shared_vertices();
+    const Print *print = this->print();
+    volume_slicer->slicer.closing_radius  = volume_slicer->closing_radius;
+    volume_slicer->slicer.model_precision = volume_slicer->model_precision;
+    volume_slicer->slicer.init(&volume_slicer->mesh, [print](){print->throw_if_canceled();});
+
+    std::lock_guard<std::mutex> lock(m_volume_slicers_mutex);
+    volume_slicer->last_used = ++ volume_slicers_clock;
+    m_volume_slicers[volume.id()] = volume_slicer;
+}
+
+void PrintObject::release_unused_volume_slicers()
+{
+    std::lock_guard<std::mutex> lock(m_volume_slicers_mutex);
+    for (auto it = m_volume_slicers.begin(); it != m_volume_slicers.end();) {
+        const std::vector<ModelVolume*> &volumes = this->model_object()->volumes;
+        if (std::find_if(volumes.begin(), volumes.end(), [&it](const ModelVolume *v) { return v->id() == it->first; }) == volumes.end())
+            it = m_volume_slicers.erase(it);
+        else
+            ++ it;
+    }
+}
+
+size_t PrintObject::max_volume_slicers_memory()
+{
+    static const size_t max_memory = total_physical_memory() / 10;
+    return max_memory;
+}
+
+// Slice a mesh already transformed into the coordinate system of this PrintObject.
+// If the slice cache is enabled and the SliceCache::mesh_hash() of the mesh is provided, the slices are looked up
+// in the cache first and stored there after slicing.
+// The slicer initialized with the mesh is only requested if the slices are not found in the cache.
+std::vector<ExPolygons> PrintObject::slice_mesh(const std::string &mesh_hash, const std::vector<float> &z, SlicingMode mode, const std::function<const TriangleMeshSlicer*()> &get_slicer) const
+{
+    std::vector<ExPolygons> layers;
+    // The hash may be missing if the cache was enabled after the volume slicer was created.
+    SliceCache *cache = mesh_hash.empty() ? nullptr : SliceCache::get();
+    std::string cache_key;
+    if (cache != nullptr) {
+        cache_key = SliceCache::make_key(mesh_hash, z, mode, float(m_config.slice_closing_radius.value), float(m_config.model_precision.value));
+        if (cache->load(cache_key, layers) && layers.size() == z.size()) {
+            BOOST_LOG_TRIVIAL(debug) << "Slicing objects - slices loaded from the cache " << cache_key;
+            return layers;
         }
+        layers.clear();
     }
+    const Print *print = this->print();
+    get_slicer()->slice(z, mode, &layers, [print](){print->throw_if_canceled();});
+    m_print->throw_if_canceled();
+    if (cache != nullptr)
+        cache->store(cache_key, layers);
     return layers;
 }
 
@@ -4,6 +4,10 @@
 #include <tbb/spin_mutex.h>
 #include <tbb/mutex.h>
 #include <tbb/parallel_for.h>
+#include <tbb/pipeline.h>
+
+#include <algorithm>
+#include <utility>
 
 namespace Slic3r {
 namespace sla {
@@ -29,6 +33,37 @@ template<> struct _ccr<true>
             fn(*(from + decltype(iN)(n)), n);
         });
     }
+
+    // Like enumerate, but the results of fn are handed over to consume in
+    // the order of the input, sequentially. At most max_in_flight items are
+    // being processed or waiting for consume at the same time.
+    template<class It, class Fn, class ConsumeFn>
+    static inline void enumerate_ordered(It from, It to, size_t max_in_flight, Fn fn, ConsumeFn consume)
+    {
+        using Result = decltype(fn(*from, size_t(0)));
+        
+        auto   iN = to - from;
+        size_t N  = iN < 0 ? 0 : size_t(iN);
+        size_t n  = 0;
+        
+        tbb::parallel_pipeline(std::max(max_in_flight, size_t(1)),
+            tbb::make_filter<void, size_t>(tbb::filter::serial_in_order,
+                [&n, N](tbb::flow_control &fc) -> size_t {
+                    if (n == N) {
+                        fc.stop();
+                        return n;
+                    }
+                    return n++;
+                }) &
+            tbb::make_filter<size_t, std::pair<size_t, Result>>(tbb::filter::parallel,
+                [from, &fn](size_t i) {
+                    return std::make_pair(i, fn(*(from + decltype(iN)(i)), i));
+                }) &
+            tbb::make_filter<std::pair<size_t, Result>, void>(tbb::filter::serial_in_order,
+                [&consume](std::pair<size_t, Result> r) {
+                    consume(std::move(r.second), r.first);
+                }));
+    }
 };
 
 template<> struct _ccr<false>
@@ -45,6 +80,15 @@ public:
     {
         for (auto it = from; it != to; ++it) fn(*it, size_t(it - from));
     }
+    
+    template<class It, class Fn, class ConsumeFn>
+    static inline void enumerate_ordered(It from, It to, size_t /* max_in_flight */, Fn fn, ConsumeFn consume)
+    {
+        for (auto it = from; it != to; ++it) {
+            size_t n = size_t(it - from);
+            consume(fn(*it, n), n);
+        }
+    }
 };
 
 using ccr = _ccr<USE_FULL_CONCURRENCY>;
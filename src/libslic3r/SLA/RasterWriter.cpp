@@ -11,6 +11,8 @@
 
 #include <boost/log/trivial.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/fstream.hpp>
 
 namespace Slic3r { namespace sla {
 
@@ -27,6 +29,48 @@ std::string RasterWriter::create_ini_content(const std::string& projectname) con
     return out;
 }
 
+struct RasterWriter::Spool
+{
+    boost::filesystem::path path;
+    boost::nowide::fstream  file;
+    // Offset and size of each spooled layer in the file.
+    std::vector<std::pair<std::streamoff, size_t>> layers;
+    std::streamoff          end = 0;
+
+    Spool() : path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("slic3r-sla-%%%%-%%%%-%%%%.tmp"))
+    {
+        file.open(path.string(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (! file)
+            throw std::runtime_error(std::string("Cannot create a temporary file for the SLA layers: ") + path.string());
+    }
+
+    ~Spool()
+    {
+        file.close();
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+    }
+
+    void write(const uint8_t *data, size_t size)
+    {
+        file.seekp(end);
+        file.write(reinterpret_cast<const char*>(data), std::streamsize(size));
+        if (! file)
+            throw std::runtime_error(std::string("Failed to write a temporary file for the SLA layers: ") + path.string());
+        layers.emplace_back(end, size);
+        end += std::streamoff(size);
+    }
+
+    void read(size_t layer_id, std::vector<uint8_t> &out)
+    {
+        out.resize(layers[layer_id].second);
+        file.seekg(layers[layer_id].first);
+        file.read(reinterpret_cast<char*>(out.data()), std::streamsize(out.size()));
+        if (! file)
+            throw std::runtime_error(std::string("Failed to read a temporary file for the SLA layers: ") + path.string());
+    }
+};
+
 RasterWriter::RasterWriter(const Raster::Resolution &res,
                            const Raster::PixelDim &  pixdim,
                            const Raster::Trafo &     trafo,
@@ -34,6 +78,23 @@ RasterWriter::RasterWriter(const Raster::Resolution &res,
     : m_res(res), m_pxdim(pixdim), m_trafo(trafo), m_gamma(gamma)
 {}
 
+RasterWriter::RasterWriter(RasterWriter &&m) = default;
+RasterWriter& RasterWriter::operator=(RasterWriter &&) = default;
+RasterWriter::~RasterWriter() = default;
+
+unsigned RasterWriter::layers() const
+{
+    return unsigned(m_spool ? m_spool->layers.size() : m_layers_rst.size());
+}
+
+void RasterWriter::append_layer(const PNGImage &png)
+{
+    assert(m_layers_rst.empty());
+    if (! m_spool)
+        m_spool = std::make_unique<Spool>();
+    m_spool->write(png.data(), png.size());
+}
+
 void RasterWriter::save(const std::string &fpath, const std::string &prjname)
 {
     try {
@@ -64,19 +125,33 @@ void RasterWriter::save(Zipper &zipper, const std::string &prjname)
         write_ini(m_slicer_config, prusaslicer_ini);
         zipper << prusaslicer_ini;
 
+        auto layer_filename = [&project](unsigned i) {
+            char lyrnum[6];
+            std::sprintf(lyrnum, "%.5d", i);
+            return project + lyrnum + ".png";
+        };
+
         for(unsigned i = 0; i < m_layers_rst.size(); i++)
         {
             if(m_layers_rst[i].rawbytes.size() > 0) {
-                char lyrnum[6];
-                std::sprintf(lyrnum, "%.5d", i);
-                auto zfilename = project + lyrnum + ".png";
-
                 // Add binary entry to the zipper
-                zipper.add_entry(zfilename,
+                zipper.add_entry(layer_filename(i),
                                  m_layers_rst[i].rawbytes.data(),
                                  m_layers_rst[i].rawbytes.size());
             }
         }
+
+        if (m_spool) {
+            // Copy the spooled layers one by one.
+            std::vector<uint8_t> buffer;
+            for(unsigned i = 0; i < m_spool->layers.size(); i++)
+            {
+                if(m_spool->layers[i].second > 0) {
+                    m_spool->read(i, buffer);
+                    zipper.add_entry(layer_filename(i), buffer.data(), buffer.size());
+                }
+            }
+        }
     } catch(std::exception& e) {
         BOOST_LOG_TRIVIAL(error) << e.what();
         // Rethrow the exception
@@ -8,6 +8,7 @@
 #include <vector>
 #include <map>
 #include <array>
+#include <memory>
 
 #include <libslic3r/SLA/Raster.hpp>
 #include <libslic3r/Zipper.hpp>
@@ -26,6 +27,8 @@ namespace sla {
 // each layer can be written and compressed independently (in parallel).
 // At the end when all layers where written, the save method can be used to 
 // write out the result into a zipped archive.
+// In the streaming mode (see append_layer()) the compressed layers are not
+// kept in memory, but spooled into a temporary file in the layer order.
 class RasterWriter
 {
 public:
@@ -67,6 +70,10 @@ private:
 
     std::map<std::string, std::string> m_config;
     std::map<std::string, std::string> m_slicer_config;
+
+    // Temporary file with the compressed layers written in the streaming mode.
+    struct Spool;
+    std::unique_ptr<Spool> m_spool;
     
     static void write_ini(const std::map<std::string, std::string> &m, std::string &ini);
     std::string create_ini_content(const std::string& projectname) const;
@@ -81,11 +88,28 @@ public:
 
     RasterWriter(const RasterWriter& ) = delete;
     RasterWriter& operator=(const RasterWriter&) = delete;
-    RasterWriter(RasterWriter&& m) = default;
-    RasterWriter& operator=(RasterWriter&&) = default;
+    RasterWriter(RasterWriter&& m);
+    RasterWriter& operator=(RasterWriter&&);
+    ~RasterWriter();
 
     inline void layers(unsigned cnt) { if(cnt > 0) m_layers_rst.resize(cnt); }
-    inline unsigned layers() const { return unsigned(m_layers_rst.size()); }
+    unsigned layers() const;
+
+    // Rasterize and compress a single layer without storing it into this
+    // writer. Thread safe, to be used together with append_layer().
+    template<class Polys> PNGImage rasterize_layer(const Polys &polygons) const
+    {
+        Raster raster(m_res, m_pxdim, m_trafo);
+        for (const auto &poly : polygons) raster.draw(poly);
+        PNGImage png;
+        png.serialize(raster);
+        return png;
+    }
+
+    // Streaming mode: append the next compressed layer. Layers have to be
+    // appended in their order, the data is written into a temporary file
+    // right away, so the caller may release the image. Not thread safe.
+    void append_layer(const PNGImage &png);
     
     template<class Poly> void draw_polygon(const Poly& p, unsigned lyr)
     {
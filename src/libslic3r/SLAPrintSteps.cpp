@@ -17,6 +17,8 @@
 
 #include <boost/log/trivial.hpp>
 
+#include <tbb/task_arena.h>
+
 #include "I18N.hpp"
 
 //! macro used to mark string used at localization,
@@ -823,12 +825,10 @@ void SLAPrint::Steps::rasterize()
     auto &print_statistics = m_print->m_print_statistics;
     auto &printer_input    = m_print->m_printer_input;
     
-    // Set up the printer, allocate space for all the layers
+    // Set up the printer. The layers are streamed into the printer in order,
+    // only the layers being rasterized are held in memory.
     sla::RasterWriter &printer = m_print->init_printer();
     
-    auto lvlcnt = unsigned(printer_input.size());
-    printer.layers(lvlcnt);
-    
     // coefficient to map the rasterization state (0-99) to the allocated
     // portion (slot) of the process state
     double sd = (100 - max_objstatus) / 100.0;
@@ -848,19 +848,12 @@ void SLAPrint::Steps::rasterize()
     // procedure to process one height level. This will run in parallel
     auto lvlfn =
         [this, &slck, &printer, increment, &dstatus, &pst]
-        (PrintLayer& printlayer, size_t idx)
+        (PrintLayer& printlayer, size_t /* idx */)
     {
-        if(canceled()) return;
-        auto level_id = unsigned(idx);
-        
-        // Switch to the appropriate layer in the printer
-        printer.begin_layer(level_id);
-        
-        for(const ClipperLib::Polygon& poly : printlayer.transformed_slices())
-            printer.draw_polygon(poly, level_id);
+        if(canceled()) return sla::PNGImage();
         
-        // Finish the layer for later saving it.
-        printer.finish_layer(level_id);
+        // Rasterize and compress the layer.
+        sla::PNGImage png = printer.rasterize_layer(printlayer.transformed_slices());
         
         // Status indication guarded with the spinlock
         {
@@ -872,16 +865,27 @@ void SLAPrint::Steps::rasterize()
                 pst = st;
             }
         }
+        
+        return png;
+    };
+    
+    // Hands the layers over to the printer in order, as soon as all the
+    // layers below are done.
+    auto writefn = [this, &printer](sla::PNGImage &&png, size_t /* idx */)
+    {
+        if(! canceled()) printer.append_layer(png);
     };
     
     // last minute escape
     if(canceled()) return;
     
     // Sequential version (for testing)
-    // for(unsigned l = 0; l < lvlcnt; ++l) lvlfn(l);
+    // sla::ccr_seq::enumerate_ordered(printer_input.begin(), printer_input.end(), 1, lvlfn, writefn);
     
-    // Print all the layers in parallel
-    sla::ccr::enumerate(printer_input.begin(), printer_input.end(), lvlfn);
+    // Print all the layers in parallel, limit the number of layers in flight.
+    sla::ccr::enumerate_ordered(printer_input.begin(), printer_input.end(),
+                                4 * size_t(std::max(1, tbb::this_task_arena::max_concurrency())),
+                                lvlfn, writefn);
     
     // Set statistics values to the printer
     sla::RasterWriter::PrintStatistics stats;
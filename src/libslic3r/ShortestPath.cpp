@@ -37,11 +37,26 @@ std::vector<std::pair<size_t, bool>> chain_segments_closest_point(std::vector<En
 	first_point.chain_id = 1;
 	//now switch to the other end of the segment
 	size_t this_idx = first_point_idx ^ 1;
+	// The taken points are only filtered out by the closest point search, they stay in the KD tree. With most of the points taken,
+	// the search would visit nearly all of them, making the chaining quadratic. Therefore the KD tree is rebuilt over the remaining
+	// points once half of the points indexed by the KD tree are taken, which keeps the total running time at O(n log n).
+	size_t num_indexed = end_points.size();
+	size_t num_taken   = 1;
 	//add all other segments
 	for (int iter = (int)num_segments - 2; iter >= 0; -- iter) {
 		EndPointType &this_point = end_points[this_idx];
 		//set the current point as taken
 		this_point.chain_id = 1;
+		if (++ num_taken * 2 > num_indexed && num_indexed > 64) {
+			std::vector<size_t> remaining;
+			remaining.reserve(num_indexed - num_taken);
+			for (size_t idx = 0; idx < end_points.size(); ++ idx)
+				if (end_points[idx].chain_id == 0)
+					remaining.emplace_back(idx);
+			num_indexed = remaining.size();
+			num_taken   = 0;
+			kdtree.build(std::move(remaining));
+		}
 		// Find the closest point to this end_point, which lies on a different extrusion path (filtered by the lambda).
 		// Ignore the starting point as the starting point is considered to be occupied, no end point coud connect to it.
 		size_t next_idx = find_closest_point(kdtree, this_point.pos,
@@ -58,6 +73,7 @@ std::vector<std::pair<size_t, bool>> chain_segments_closest_point(std::vector<En
 		EndPointType &end_point = end_points[next_idx];
 		//set the new entry point as taken
 		end_point.chain_id = 1;
+		++ num_taken;
 		out.emplace_back(next_idx / 2, (next_idx & 1) != 0);
 		//now switch to the other end of the segment
 		this_idx = next_idx ^ 1;
@@ -766,6 +782,12 @@ std::vector<std::pair<size_t, bool>> chain_segments_greedy_constrained_reversals
 		// required is higher than expected (it would be the number of links, num_segments - 1).
 		// The limit here may not be necessary, but it guards us against an endless loop if something goes wrong.
 		size_t num_iter = num_segments * 16;
+		// End points of segments inside a chain will never be connected again, but they stay in the KD tree, only filtered out
+		// by the closest point search. Once most of the segments are chained, the search would visit nearly all of them.
+		// Therefore the KD tree is rebuilt over the segments still open for a connection after each quarter of the indexed
+		// end points were connected, which keeps the total running time at O(n log n).
+		size_t num_indexed = end_points.size();
+		size_t num_connected_since_rebuild = 0;
 		for (size_t num_connections_to_end = num_segments - 1; num_iter > 0; -- num_iter) {
 			assert(validate_graph_and_queue());
 	    	// Take the first end point, for which the link points to the currently closest valid neighbor.
@@ -901,6 +923,16 @@ std::vector<std::pair<size_t, bool>> chain_segments_greedy_constrained_reversals
 #endif /* NDEBUG */
 					break;
 				} else {
+					if (++ num_connected_since_rebuild * 4 > num_indexed && num_indexed > 64) {
+						std::vector<size_t> open;
+						open.reserve(num_indexed);
+						for (size_t idx = 0; idx < end_points.size(); ++ idx)
+							if (end_points[idx].chain_id == 0 || end_points[idx ^ 1].chain_id == 0)
+								open.emplace_back(idx);
+						num_indexed = open.size();
+						num_connected_since_rebuild = 0;
+						kdtree.build(std::move(open));
+					}
 					//FIXME update the 2nd end points on the queue.
 					// Update end points of the flipped segments.
 					update_end_point_in_queue(queue, kdtree, chains, end_points, chain.begin->opposite(end_points), first_point_idx, first_point);
@@ -978,9 +1010,12 @@ std::vector<std::pair<size_t, bool>> chain_segments_greedy_constrained_reversals
 					} while (first_point != nullptr);
 				}
 			}
-			if (failed)
+			if (failed) {
 				// As a last resort, try a dumb algorithm, which is not sensitive to edge reversal constraints.
+				if (num_indexed < end_points.size())
+					kdtree.build(end_points.size());
 				out = chain_segments_closest_point<EndPoint, decltype(kdtree), CouldReverseFunc>(end_points, kdtree, could_reverse_func, (initial_point != nullptr) ? *initial_point : end_points.front());
+			}
 		} else {
 			assert(! failed);
 		}
@@ -1545,7 +1580,10 @@ static inline void do_crossover(const std::vector<FlipEdge> &edges_in, std::vect
 	assert(edges_in.size() == edges_out.size());
 }
 
-static inline void reorder_by_two_exchanges_with_segment_flipping(std::vector<FlipEdge> &edges)
+// Each pass looks for a pair of connections, which improves the total cost by a crossover. A pass visits O(n^2) pairs of
+// connections in the worst case and up to n passes are made, thus the search is limited by max_evaluations of the crossover cost.
+// The crossovers already applied when reaching the limit are kept, the ordering is improved, but not necessarily optimal.
+static inline void reorder_by_two_exchanges_with_segment_flipping(std::vector<FlipEdge> &edges, size_t max_evaluations = std::numeric_limits<size_t>::max())
 {
 	if (edges.size() < 2)
 		return;
@@ -1554,8 +1592,10 @@ static inline void reorder_by_two_exchanges_with_segment_flipping(std::vector<Fl
 	std::vector<FlipEdge> 					edges_tmp(edges);
 	std::vector<std::pair<double, size_t>>	connection_lengths(edges.size() - 1, std::pair<double, size_t>(0., 0));
 	std::vector<char>						connection_tried(edges.size(), false);
-	for (size_t iter = 0; iter < edges.size(); ++ iter) {
+	size_t num_evaluations = 0;
+	for (size_t iter = 0; iter < edges.size() && num_evaluations < max_evaluations; ++ iter) {
 		// Initialize connection costs and connection lengths.
+		num_evaluations += edges.size();
 		for (size_t i = 1; i < edges.size(); ++ i) {
 			const FlipEdge   	 &e1 = edges[i - 1];
 			const FlipEdge   	 &e2 = edges[i];
@@ -1572,6 +1612,10 @@ static inline void reorder_by_two_exchanges_with_segment_flipping(std::vector<Fl
 		size_t crossover2_pos_final = std::numeric_limits<size_t>::max();
 		size_t crossover_flip_final = 0;
 		for (const std::pair<double, size_t> &first_crossover_candidate : connection_lengths) {
+			if (num_evaluations >= max_evaluations)
+				// Out of the budget, keep the crossovers applied so far.
+				break;
+			num_evaluations += connections.size();
 			double longest_connection_length = first_crossover_candidate.first;
 			size_t longest_connection_idx    = first_crossover_candidate.second;
 			connection_tried[longest_connection_idx] = true;
@@ -1870,7 +1914,8 @@ static inline void reorder_by_three_exchanges_with_segment_flipping2(std::vector
 }
 
 // Flip the sequences of polylines to lower the total length of connecting lines.
-static inline void improve_ordering_by_two_exchanges_with_segment_flipping(Polylines &polylines, bool fixed_start)
+// The search is limited by max_evaluations of a crossover cost, see reorder_by_two_exchanges_with_segment_flipping().
+static inline void improve_ordering_by_two_exchanges_with_segment_flipping(Polylines &polylines, bool fixed_start, size_t max_evaluations = std::numeric_limits<size_t>::max())
 {
 #ifndef NDEBUG
 	auto cost = [&polylines]() {
@@ -1893,7 +1938,7 @@ static inline void improve_ordering_by_two_exchanges_with_segment_flipping(Polyl
     std::transform(polylines.begin(), polylines.end(), std::back_inserter(edges), 
     	[&polylines](const Polyline &pl){ return FlipEdge(pl.first_point().cast<double>(), pl.last_point().cast<double>(), &pl - polylines.data()); });
 #if 1
-	reorder_by_two_exchanges_with_segment_flipping(edges);
+	reorder_by_two_exchanges_with_segment_flipping(edges, max_evaluations);
 #else
 	// reorder_by_three_exchanges_with_segment_flipping(edges);
 	reorder_by_three_exchanges_with_segment_flipping2(edges);
@@ -1902,26 +1947,38 @@ static inline void improve_ordering_by_two_exchanges_with_segment_flipping(Polyl
 	out.reserve(polylines.size());
 	for (const FlipEdge &edge : edges) {
 		Polyline &pl = polylines[edge.source_index];
+		// Test the orientation before the polyline is moved out.
+		bool flipped = edge.p2 == pl.first_point().cast<double>();
+		assert(flipped || edge.p1 == pl.first_point().cast<double>());
 		out.emplace_back(std::move(pl));
-		if (edge.p2 == pl.first_point().cast<double>()) {
-			// Polyline is flipped.
+		if (flipped)
 			out.back().reverse();
-		} else {
-			// Polyline is not flipped.
-			assert(edge.p1 == pl.first_point().cast<double>());
-		}
 	}
+	polylines = std::move(out);
 
 #ifndef NDEBUG
 	double cost_final = cost();
 #ifdef DEBUG_SVG_OUTPUT
-	svg_draw_polyline_chain("improve_ordering_by_two_exchanges_with_segment_flipping-final", iRun, out);
+	svg_draw_polyline_chain("improve_ordering_by_two_exchanges_with_segment_flipping-final", iRun, polylines);
 #endif /* DEBUG_SVG_OUTPUT */
 	assert(cost_final <= cost_initial);
 #endif /* NDEBUG */
 }
 
+// The improvement by two exchanges is cubic in the number of polylines. Up to chain_polylines_uncapped polylines, the chain is improved
+// until no crossover lowers its cost, which takes up to about 30 * n^2 crossover cost evaluations. For more polylines, the work is limited
+// to that of chain_polylines_uncapped polylines, so that dense infill with thousands of lines does not take minutes per layer.
+// The limit is a number of operations instead of a time, so that the G-code does not depend on the machine load.
+static constexpr size_t chain_polylines_uncapped = 256;
+
 Polylines chain_polylines(Polylines &&polylines, const Point *start_near)
+{
+	size_t max_evaluations = polylines.size() <= chain_polylines_uncapped ?
+		std::numeric_limits<size_t>::max() : 32 * chain_polylines_uncapped * chain_polylines_uncapped;
+	return chain_polylines(std::move(polylines), start_near, max_evaluations);
+}
+
+Polylines chain_polylines(Polylines &&polylines, const Point *start_near, size_t max_evaluations)
 {
 #ifdef DEBUG_SVG_OUTPUT
 	static int iRun = 0;
@@ -1940,7 +1997,7 @@ Polylines chain_polylines(Polylines &&polylines, const Point *start_near)
 				out.back().reverse();
 		}
 		if (out.size() > 1 && start_near == nullptr) {
-			improve_ordering_by_two_exchanges_with_segment_flipping(out, start_near != nullptr);
+			improve_ordering_by_two_exchanges_with_segment_flipping(out, start_near != nullptr, max_evaluations);
 			//improve_ordering_by_segment_flipping(out, start_near != nullptr);
 		}
 	}
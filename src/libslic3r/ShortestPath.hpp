@@ -23,6 +23,9 @@ void                                 reorder_extrusion_paths(std::vector<Extrusi
 void                                 chain_and_reorder_extrusion_paths(std::vector<ExtrusionPath> &extrusion_paths, const Point *start_near = nullptr);
 
 Polylines 							 chain_polylines(Polylines &&src, const Point *start_near = nullptr);
+// Without start_near, the chain is improved by two exchanges with segment flipping, limited to max_evaluations of a crossover cost.
+// The limit of the above chain_polylines() only applies to large numbers of polylines.
+Polylines 							 chain_polylines(Polylines &&src, const Point *start_near, size_t max_evaluations);
 inline Polylines 					 chain_polylines(const Polylines& src, const Point* start_near = nullptr) { Polylines tmp(src); return chain_polylines(std::move(tmp), start_near); }
 
 std::vector<ClipperLib::PolyNode*>	 chain_clipper_polynodes(const Points &points, const std::vector<ClipperLib::PolyNode*> &items);
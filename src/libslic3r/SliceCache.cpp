@@ -0,0 +1,293 @@
+#include "SliceCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <boost/uuid/detail/sha1.hpp>
+
+namespace Slic3r {
+
+// Bump the version whenever the file format or the slicing algorithm changes.
+static constexpr const uint32_t SLICE_CACHE_VERSION = 1;
+static constexpr const char     SLICE_CACHE_MAGIC[4] = { 'S', 'L', 'C', 'C' };
+static constexpr const char    *SLICE_CACHE_EXTENSION = ".slices";
+
+std::unique_ptr<SliceCache> SliceCache::s_instance;
+
+void SliceCache::setup(const std::string &dir, size_t max_size)
+{
+    if (dir.empty()) {
+        s_instance.reset();
+        return;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(dir, ec);
+    if (ec) {
+        BOOST_LOG_TRIVIAL(error) << "Slice cache disabled, failed to create directory " << dir << ": " << ec.message();
+        s_instance.reset();
+        return;
+    }
+    s_instance = std::make_unique<SliceCache>(dir, max_size);
+    BOOST_LOG_TRIVIAL(info) << "Slice cache enabled at " << dir << ", limited to " << max_size / (1024 * 1024) << " MB";
+}
+
+SliceCache::SliceCache(const std::string &dir, size_t max_size) : m_dir(dir), m_max_size(max_size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    this->evict();
+}
+
+static std::string sha1_to_hex(boost::uuids::detail::sha1 &sha1)
+{
+    boost::uuids::detail::sha1::digest_type digest;
+    sha1.get_digest(digest);
+    // The digest is an array of either 32bit integers or bytes depending on the Boost version, either way print all its bytes.
+    static constexpr const char hex[] = "0123456789abcdef";
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&digest[0]);
+    std::string out;
+    out.reserve(2 * sizeof(digest));
+    for (size_t i = 0; i < sizeof(digest); ++ i) {
+        out += hex[bytes[i] >> 4];
+        out += hex[bytes[i] & 0x0f];
+    }
+    return out;
+}
+
+std::string SliceCache::mesh_hash(const TriangleMesh &mesh)
+{
+    boost::uuids::detail::sha1 sha1;
+    size_t num_facets = mesh.stl.facet_start.size();
+    sha1.process_bytes(&num_facets, sizeof(num_facets));
+    for (const stl_facet &facet : mesh.stl.facet_start)
+        sha1.process_bytes(facet.vertex, sizeof(facet.vertex));
+    return sha1_to_hex(sha1);
+}
+
+std::string SliceCache::make_key(const std::string &mesh_hash, const std::vector<float> &z, SlicingMode mode, float closing_radius, float model_precision)
+{
+    boost::uuids::detail::sha1 sha1;
+    auto process = [&sha1](const void *data, size_t size) { sha1.process_bytes(data, size); };
+    process(SLIC3R_BUILD_ID, strlen(SLIC3R_BUILD_ID));
+    process(&SLICE_CACHE_VERSION, sizeof(SLICE_CACHE_VERSION));
+    process(&mode, sizeof(mode));
+    process(&closing_radius, sizeof(closing_radius));
+    process(&model_precision, sizeof(model_precision));
+    size_t num_z = z.size();
+    process(&num_z, sizeof(num_z));
+    process(z.data(), z.size() * sizeof(float));
+    process(mesh_hash.data(), mesh_hash.size());
+    return sha1_to_hex(sha1);
+}
+
+std::string SliceCache::path(const std::string &key) const
+{
+    return (boost::filesystem::path(m_dir) / (key + SLICE_CACHE_EXTENSION)).string();
+}
+
+namespace {
+    template<typename T> void write_pod(std::string &out, const T &value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void write_polygon(std::string &out, const Polygon &polygon)
+    {
+        write_pod(out, uint64_t(polygon.points.size()));
+        for (const Point &pt : polygon.points) {
+            write_pod(out, int64_t(pt.x()));
+            write_pod(out, int64_t(pt.y()));
+        }
+    }
+
+    // Bounds checked reader of the cache file, a truncated or otherwise damaged file is detected by the failed flag.
+    struct Reader
+    {
+        const char *ptr;
+        const char *end;
+        bool        failed = false;
+
+        template<typename T> T read_pod()
+        {
+            T value = T();
+            if (size_t(end - ptr) < sizeof(T))
+                failed = true;
+            else {
+                memcpy(&value, ptr, sizeof(T));
+                ptr += sizeof(T);
+            }
+            return value;
+        }
+
+        // Counts are validated against the remaining data, so that a damaged file does not trigger a huge allocation.
+        size_t read_count(size_t min_item_size)
+        {
+            uint64_t n = this->read_pod<uint64_t>();
+            if (n > uint64_t(end - ptr) / min_item_size) {
+                failed = true;
+                n = 0;
+            }
+            return size_t(n);
+        }
+
+        void read_polygon(Polygon &polygon)
+        {
+            size_t n = this->read_count(2 * sizeof(int64_t));
+            polygon.points.reserve(n);
+            for (size_t i = 0; i < n; ++ i) {
+                int64_t x = this->read_pod<int64_t>();
+                int64_t y = this->read_pod<int64_t>();
+                polygon.points.emplace_back(coord_t(x), coord_t(y));
+            }
+        }
+    };
+}
+
+bool SliceCache::load(const std::string &key, std::vector<ExPolygons> &out)
+{
+    const std::string file_path = this->path(key);
+    std::string       data;
+    {
+        FILE *f = boost::nowide::fopen(file_path.c_str(), "rb");
+        if (f == nullptr)
+            return false;
+        char buf[65536];
+        for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;)
+            data.append(buf, n);
+        fclose(f);
+    }
+
+    Reader reader { data.data(), data.data() + data.size() };
+    std::vector<ExPolygons> slices;
+    if (data.size() < sizeof(SLICE_CACHE_MAGIC) || memcmp(data.data(), SLICE_CACHE_MAGIC, sizeof(SLICE_CACHE_MAGIC)) != 0)
+        reader.failed = true;
+    else {
+        reader.ptr += sizeof(SLICE_CACHE_MAGIC);
+        if (reader.read_pod<uint32_t>() != SLICE_CACHE_VERSION)
+            reader.failed = true;
+        else {
+            // Minimum sizes: an empty layer has just the count, an ExPolygon has at least the contour and the hole count.
+            slices.assign(reader.read_count(sizeof(uint64_t)), ExPolygons());
+            for (ExPolygons &layer : slices) {
+                layer.assign(reader.read_count(2 * sizeof(uint64_t)), ExPolygon());
+                for (ExPolygon &expoly : layer) {
+                    reader.read_polygon(expoly.contour);
+                    expoly.holes.assign(reader.read_count(sizeof(uint64_t)), Polygon());
+                    for (Polygon &hole : expoly.holes)
+                        reader.read_polygon(hole);
+                }
+                if (reader.failed)
+                    break;
+            }
+        }
+    }
+    if (reader.failed || reader.ptr != reader.end) {
+        BOOST_LOG_TRIVIAL(warning) << "Slice cache: removing damaged entry " << file_path;
+        boost::system::error_code ec;
+        if (boost::filesystem::remove(file_path, ec))
+            this->update_size(- intmax_t(data.size()));
+        return false;
+    }
+
+    // Mark the entry as recently used.
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(file_path, std::time(nullptr), ec);
+    out = std::move(slices);
+    return true;
+}
+
+void SliceCache::store(const std::string &key, const std::vector<ExPolygons> &slices)
+{
+    std::string data;
+    data.append(SLICE_CACHE_MAGIC, sizeof(SLICE_CACHE_MAGIC));
+    write_pod(data, SLICE_CACHE_VERSION);
+    write_pod(data, uint64_t(slices.size()));
+    for (const ExPolygons &layer : slices) {
+        write_pod(data, uint64_t(layer.size()));
+        for (const ExPolygon &expoly : layer) {
+            write_polygon(data, expoly.contour);
+            write_pod(data, uint64_t(expoly.holes.size()));
+            for (const Polygon &hole : expoly.holes)
+                write_polygon(data, hole);
+        }
+    }
+    if (data.size() > m_max_size)
+        return;
+
+    // Write into a temporary file first and rename it, so that a concurrent load() never sees a partially written entry.
+    const std::string file_path = this->path(key);
+    const std::string tmp_path  = file_path + boost::filesystem::unique_path(".%%%%-%%%%.tmp").string();
+    FILE *f = boost::nowide::fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr) {
+        BOOST_LOG_TRIVIAL(warning) << "Slice cache: failed to create " << tmp_path;
+        return;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    boost::system::error_code ec;
+    // An entry of the same key may already be there, if stored by another thread or process in the meantime.
+    uintmax_t old_size = 0;
+    if (ok) {
+        old_size = boost::filesystem::file_size(file_path, ec);
+        if (ec)
+            old_size = 0;
+        boost::filesystem::rename(tmp_path, file_path, ec);
+    }
+    if (! ok || ec) {
+        BOOST_LOG_TRIVIAL(warning) << "Slice cache: failed to write " << file_path;
+        boost::filesystem::remove(tmp_path, ec);
+        return;
+    }
+    this->update_size(intmax_t(data.size()) - intmax_t(old_size));
+}
+
+void SliceCache::update_size(intmax_t delta)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_total_size = (delta < 0 && uintmax_t(- delta) > m_total_size) ? 0 : uintmax_t(intmax_t(m_total_size) + delta);
+    if (m_total_size > m_max_size)
+        this->evict();
+}
+
+void SliceCache::evict()
+{
+    struct Entry {
+        boost::filesystem::path path;
+        uintmax_t               size;
+        std::time_t             last_used;
+    };
+    std::vector<Entry> entries;
+    uintmax_t          total_size = 0;
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(m_dir, ec), end; ! ec && it != end; it.increment(ec)) {
+        const boost::filesystem::path &p = it->path();
+        if (p.extension() != SLICE_CACHE_EXTENSION || ! boost::filesystem::is_regular_file(it->status()))
+            continue;
+        boost::system::error_code ec2;
+        uintmax_t   size      = boost::filesystem::file_size(p, ec2);
+        std::time_t last_used = boost::filesystem::last_write_time(p, ec2);
+        if (! ec2) {
+            entries.push_back({ p, size, last_used });
+            total_size += size;
+        }
+    }
+    if (total_size > m_max_size) {
+        // Evict a bit more than necessary, so that a full cache is not scanned again by the very next store().
+        const uintmax_t target_size = m_max_size - m_max_size / 10;
+        std::sort(entries.begin(), entries.end(), [](const Entry &l, const Entry &r) { return l.last_used < r.last_used; });
+        for (const Entry &entry : entries) {
+            if (total_size <= target_size)
+                break;
+            if (boost::filesystem::remove(entry.path, ec))
+                total_size -= entry.size;
+        }
+        BOOST_LOG_TRIVIAL(debug) << "Slice cache: evicted down to " << total_size << " bytes";
+    }
+    m_total_size = total_size;
+}
+
+} // namespace Slic3r
@@ -0,0 +1,72 @@
+#ifndef slic3r_SliceCache_hpp_
+#define slic3r_SliceCache_hpp_
+
+#include "libslic3r.h"
+#include "ExPolygon.hpp"
+#include "TriangleMesh.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Slic3r {
+
+// Content addressed on-disk cache of the sliced volumes.
+//
+// A production queue slices the same parts with the same profiles over and over again. The slices of a mesh
+// (already transformed into the coordinate system of the PrintObject) are stored into a file named by the hash
+// of the mesh and of all the parameters influencing TriangleMeshSlicer: the slicing planes (thus the layer
+// height profile), slice_closing_radius, model_precision and the slicing mode. The next time the same volume
+// is sliced, the slices are loaded from the file instead.
+//
+// The total size of the cache is limited, the least recently used files are removed first.
+// The cache is disabled unless enabled by SliceCache::setup(), see the --slice-cache command line option.
+class SliceCache
+{
+public:
+    // Enable the cache stored in the directory dir, limited to max_size bytes. An empty dir disables the cache.
+    static void         setup(const std::string &dir, size_t max_size);
+    // Returns nullptr if the cache is disabled.
+    static SliceCache*  get() { return s_instance.get(); }
+
+    // Hash of the facets of a mesh, to be passed to make_key().
+    static std::string  mesh_hash(const TriangleMesh &mesh);
+    // Hash of the slicing input, used as the file name of the cache entry.
+    static std::string  make_key(const std::string &mesh_hash, const std::vector<float> &z, SlicingMode mode, float closing_radius, float model_precision);
+    static std::string  make_key(const TriangleMesh &mesh, const std::vector<float> &z, SlicingMode mode, float closing_radius, float model_precision)
+        { return make_key(mesh_hash(mesh), z, mode, closing_radius, model_precision); }
+
+    // Returns false if there is no valid entry for the key, out is left unchanged in that case.
+    bool                load(const std::string &key, std::vector<ExPolygons> &out);
+    // Store the slices and evict the least recently used entries exceeding the size limit.
+    void                store(const std::string &key, const std::vector<ExPolygons> &slices);
+
+    const std::string&  dir() const { return m_dir; }
+    size_t              max_size() const { return m_max_size; }
+
+    // Scans the cache directory to find out its size, evicting the entries exceeding max_size.
+    SliceCache(const std::string &dir, size_t max_size);
+
+private:
+    std::string         path(const std::string &key) const;
+    // Account for a stored (positive delta) or removed (negative delta) entry, evict if the cache grew over max_size.
+    void                update_size(intmax_t delta);
+    // Scan the cache directory. If the cache exceeds max_size, remove the least recently used entries until it fits
+    // 90% of max_size. Update m_total_size with the size found. Called with m_mutex locked.
+    void                evict();
+
+    static std::unique_ptr<SliceCache> s_instance;
+
+    std::string         m_dir;
+    size_t              m_max_size;
+    // Size of the cache entries as accounted by this process. The cache directory is only scanned at startup and
+    // when this size exceeds m_max_size, which also resynchronizes it with entries added or removed by other processes.
+    uintmax_t           m_total_size { 0 };
+    // Serializes the size accounting and the eviction of the threads slicing in parallel.
+    std::mutex          m_mutex;
+};
+
+} // namespace Slic3r
+
+#endif /* slic3r_SliceCache_hpp_ */
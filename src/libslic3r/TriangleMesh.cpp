@@ -19,6 +19,7 @@
 #include <boost/log/trivial.hpp>
 
 #include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
 
 #include <Eigen/Core>
 #include <Eigen/Dense>
@@ -810,19 +811,10 @@ void TriangleMeshSlicer::slice(const std::vector<float> &z, SlicingMode mode, st
     
     BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::_slice_do";
     std::vector<IntersectionLines> lines(z.size());
-    {
-        boost::mutex lines_mutex;
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0,this->mesh->stl.stats.number_of_facets),
-            [&lines, &lines_mutex, &z, throw_on_cancel, this](const tbb::blocked_range<int>& range) {
-                for (int facet_idx = range.begin(); facet_idx < range.end(); ++ facet_idx) {
-                    if ((facet_idx & 0x0ffff) == 0)
-                        throw_on_cancel();
-                    this->_slice_do(facet_idx, &lines, &lines_mutex, z);
-                }
-            }
-        );
-    }
+    if (this->algorithm == Algorithm::Sweep)
+        this->_slice_sweep(z, lines, throw_on_cancel);
+    else
+        this->_slice_facet_parallel(z, lines, throw_on_cancel);
     throw_on_cancel();
 
     // v_scaled_shared could be freed here
@@ -903,8 +895,142 @@ void TriangleMeshSlicer::slice(const std::vector<float> &z, SlicingMode mode, st
 #endif
 }
 
-void TriangleMeshSlicer::_slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, 
-    const std::vector<float> &z) const
+void TriangleMeshSlicer::_slice_facet_parallel(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const
+{
+    // The facets are split into fixed chunks, each chunk collects its intersection lines into its own buckets,
+    // so that the threads do not contend for a lock. The buckets are merged per layer in the chunk order,
+    // therefore the lines of each layer are ordered by their facet index independently of the thread scheduling.
+    const size_t num_facets = this->mesh->stl.stats.number_of_facets;
+    const size_t chunk_size = std::max<size_t>(4096, num_facets / (4 * std::max(1, tbb::task_scheduler_init::default_num_threads())) + 1);
+    std::vector<std::vector<IntersectionLines>> lines_per_chunk((num_facets + chunk_size - 1) / chunk_size);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, lines_per_chunk.size(), 1),
+        [&lines_per_chunk, &z, num_facets, chunk_size, throw_on_cancel, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t chunk_idx = range.begin(); chunk_idx < range.end(); ++ chunk_idx) {
+                std::vector<IntersectionLines> &chunk_lines = lines_per_chunk[chunk_idx];
+                chunk_lines.assign(z.size(), IntersectionLines());
+                for (size_t facet_idx = chunk_idx * chunk_size; facet_idx < std::min(num_facets, (chunk_idx + 1) * chunk_size); ++ facet_idx) {
+                    if ((facet_idx & 0x0ffff) == 0)
+                        throw_on_cancel();
+                    this->_slice_do(facet_idx, &chunk_lines, z);
+                }
+            }
+        }
+    );
+    throw_on_cancel();
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, z.size()),
+        [&lines, &lines_per_chunk](const tbb::blocked_range<size_t>& range) {
+            for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
+                size_t num_lines = 0;
+                for (const std::vector<IntersectionLines> &chunk_lines : lines_per_chunk)
+                    num_lines += chunk_lines[layer_idx].size();
+                IntersectionLines &layer_lines = lines[layer_idx];
+                layer_lines.reserve(num_lines);
+                for (std::vector<IntersectionLines> &chunk_lines : lines_per_chunk) {
+                    layer_lines.insert(layer_lines.end(), chunk_lines[layer_idx].begin(), chunk_lines[layer_idx].end());
+                    // Release the chunk memory early.
+                    chunk_lines[layer_idx] = IntersectionLines();
+                }
+            }
+        }
+    );
+}
+
+void TriangleMeshSlicer::_slice_sweep(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const
+{
+    const size_t num_facets = this->mesh->stl.stats.number_of_facets;
+    const size_t num_layers = z.size();
+    if (num_facets == 0 || num_layers == 0)
+        return;
+
+    // Z extents of the facets and the range of layers [first_layer, last_layer) each facet spans.
+    struct FacetInterval {
+        float    min_z;
+        float    max_z;
+        uint32_t first_layer;
+        uint32_t last_layer;
+    };
+    std::vector<FacetInterval> intervals(num_facets);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_facets),
+        [&intervals, &z, throw_on_cancel, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t facet_idx = range.begin(); facet_idx < range.end(); ++ facet_idx) {
+                if ((facet_idx & 0x0ffff) == 0)
+                    throw_on_cancel();
+                const stl_facet &facet = m_use_quaternion ? (this->mesh->stl.facet_start.data() + facet_idx)->rotated(m_quaternion) : *(this->mesh->stl.facet_start.data() + facet_idx);
+                FacetInterval   &interval = intervals[facet_idx];
+                interval.min_z = fminf(facet.vertex[0](2), fminf(facet.vertex[1](2), facet.vertex[2](2)));
+                interval.max_z = fmaxf(facet.vertex[0](2), fmaxf(facet.vertex[1](2), facet.vertex[2](2)));
+                // Same layer extents as in _slice_do().
+                auto min_layer = std::lower_bound(z.begin(), z.end(), interval.min_z);
+                auto max_layer = std::upper_bound(min_layer, z.end(), interval.max_z);
+                interval.first_layer = uint32_t(min_layer - z.begin());
+                interval.last_layer  = uint32_t(max_layer - z.begin());
+            }
+        });
+    throw_on_cancel();
+
+    // The layers are split into chunks sliced in parallel.
+    const size_t num_chunks = std::min(num_layers, size_t(4 * std::max(1, tbb::task_scheduler_init::default_num_threads())));
+    auto chunk_begin = [num_layers, num_chunks](size_t chunk_idx) { return chunk_idx * num_layers / num_chunks; };
+    // Index of the first chunk starting at or above layer_idx.
+    auto chunk_of    = [num_layers, num_chunks](size_t layer_idx) { return (layer_idx * num_chunks + num_layers - 1) / num_layers; };
+
+    // Facet interval index: facets sorted by their first layer (counting sort, stable in facet index),
+    // facets_by_first_layer[first_facet[layer_idx] .. first_facet[layer_idx + 1]) start at layer_idx.
+    // Facets spanning a chunk boundary are collected into the active set the chunk starts with.
+    std::vector<uint32_t>              first_facet(num_layers + 1, 0);
+    std::vector<std::vector<uint32_t>> active_at_chunk_begin(num_chunks);
+    for (const FacetInterval &interval : intervals)
+        if (interval.first_layer < interval.last_layer)
+            ++ first_facet[interval.first_layer + 1];
+    for (size_t layer_idx = 0; layer_idx < num_layers; ++ layer_idx)
+        first_facet[layer_idx + 1] += first_facet[layer_idx];
+    std::vector<uint32_t> facets_by_first_layer(first_facet.back());
+    {
+        std::vector<uint32_t> next(first_facet.begin(), first_facet.end() - 1);
+        for (uint32_t facet_idx = 0; facet_idx < uint32_t(num_facets); ++ facet_idx) {
+            const FacetInterval &interval = intervals[facet_idx];
+            if (interval.first_layer < interval.last_layer) {
+                facets_by_first_layer[next[interval.first_layer] ++] = facet_idx;
+                for (size_t chunk_idx = chunk_of(interval.first_layer + 1); chunk_idx < num_chunks && chunk_begin(chunk_idx) < interval.last_layer; ++ chunk_idx)
+                    active_at_chunk_begin[chunk_idx].emplace_back(facet_idx);
+            }
+        }
+    }
+    throw_on_cancel();
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_chunks, 1),
+        [&lines, &z, &intervals, &first_facet, &facets_by_first_layer, &active_at_chunk_begin, chunk_begin, throw_on_cancel, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t chunk_idx = range.begin(); chunk_idx < range.end(); ++ chunk_idx) {
+                throw_on_cancel();
+                std::vector<uint32_t> active = std::move(active_at_chunk_begin[chunk_idx]);
+                for (size_t layer_idx = chunk_begin(chunk_idx); layer_idx < chunk_begin(chunk_idx + 1); ++ layer_idx) {
+                    active.insert(active.end(), facets_by_first_layer.begin() + first_facet[layer_idx], facets_by_first_layer.begin() + first_facet[layer_idx + 1]);
+                    const float        slice_z     = z[layer_idx] / SCALING_FACTOR;
+                    IntersectionLines &layer_lines = lines[layer_idx];
+                    size_t             num_active  = 0;
+                    for (uint32_t facet_idx : active) {
+                        const FacetInterval &interval = intervals[facet_idx];
+                        const stl_facet     &facet    = m_use_quaternion ? (this->mesh->stl.facet_start.data() + facet_idx)->rotated(m_quaternion) : *(this->mesh->stl.facet_start.data() + facet_idx);
+                        IntersectionLine     il;
+                        if (this->slice_facet(slice_z, facet, facet_idx, interval.min_z, interval.max_z, &il) == TriangleMeshSlicer::Slicing &&
+                            // Ignore horizontal triangles. Any valid horizontal triangle must have a vertical triangle connected, otherwise the part has zero volume.
+                            il.edge_type != feHorizontal)
+                            layer_lines.emplace_back(il);
+                        // Retire the facets above which the sweep is leaving.
+                        if (interval.last_layer > layer_idx + 1)
+                            active[num_active ++] = facet_idx;
+                    }
+                    active.resize(num_active);
+                }
+            }
+        });
+}
+
+void TriangleMeshSlicer::_slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, const std::vector<float> &z) const
 {
     const stl_facet &facet = m_use_quaternion ? (this->mesh->stl.facet_start.data() + facet_idx)->rotated(m_quaternion) : *(this->mesh->stl.facet_start.data() + facet_idx);
     
@@ -932,7 +1058,6 @@ void TriangleMeshSlicer::_slice_do(size_t facet_idx, std::vector<IntersectionLin
         std::vector<float>::size_type layer_idx = it - z.begin();
         IntersectionLine il;
         if (this->slice_facet(*it / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &il) == TriangleMeshSlicer::Slicing) {
-            boost::lock_guard<boost::mutex> l(*lines_mutex);
             if (il.edge_type == feHorizontal) {
                 // Ignore horizontal triangles. Any valid horizontal triangle must have a vertical triangle connected, otherwise the part has zero volume.
             } else
@@ -181,6 +181,17 @@ public:
     float closing_radius;
     float model_precision;
 
+    // How the intersections of the facets with the slicing planes are collected.
+    // Both algorithms produce the same intersection lines, they differ in the order of the lines inside a layer.
+    enum class Algorithm {
+        // Slice each facet with all the planes it spans, in parallel over chunks of facets.
+        FacetParallel,
+        // Index the facets by the first plane they span and sweep the planes bottom up with a set of active facets,
+        // in parallel over chunks of planes. Each thread writes into its own layers only, the facets are visited in z order.
+        Sweep,
+    };
+    Algorithm algorithm { Algorithm::FacetParallel };
+
     typedef std::function<void()> throw_on_cancel_callback_type;
     TriangleMeshSlicer(float closing_radius, float model_precision) : mesh(nullptr), closing_radius(closing_radius), model_precision(model_precision) {}
     TriangleMeshSlicer(const TriangleMesh* mesh) : mesh(mesh), closing_radius(0), model_precision(0) { this->init(mesh, []() {}); }
@@ -196,6 +207,8 @@ public:
         const float min_z, const float max_z, IntersectionLine *line_out) const;
     void cut(float z, TriangleMesh* upper, TriangleMesh* lower) const;
     void set_up_direction(const Vec3f& up);
+    // Estimate of the memory occupied by the edge topology and the scaled vertices, the mesh is not owned by the slicer.
+    size_t memsize() const { return sizeof(*this) + this->facets_edges.capacity() * sizeof(int) + this->v_scaled_shared.capacity() * sizeof(stl_vertex); }
     
 private:
     const TriangleMesh      *mesh;
@@ -208,7 +221,9 @@ private:
     // Whether or not the above quaterion should be used
     bool                     m_use_quaternion = false;
 
-    void _slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, const std::vector<float> &z) const;
+    void _slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, const std::vector<float> &z) const;
+    void _slice_facet_parallel(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const;
+    void _slice_sweep(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const;
     void make_loops(std::vector<IntersectionLine> &lines, Polygons* loops) const;
     void make_expolygons(const Polygons &loops, ExPolygons* slices) const;
     void make_expolygons_simple(std::vector<IntersectionLine> &lines, ExPolygons* slices) const;
@@ -83,3 +83,38 @@ SCENARIO("ExtrusionEntityCollection: Polygon flattening", "[ExtrusionEntity]") {
         }
     }
 }
+
+SCENARIO("ExtrusionEntityArena: entities allocated inside a scope", "[ExtrusionEntity]") {
+    srand(0xDEADBEEF);
+    Slic3r::ExtrusionPaths paths = random_paths();
+
+    GIVEN("An arena and a collection filled inside the arena scope") {
+        ExtrusionEntityArena *arena = new ExtrusionEntityArena();
+        ExtrusionEntityCollection collection;
+        {
+            ExtrusionEntityArena::Scope scope(arena);
+            collection.append(paths);
+        }
+        THEN("The entities are allocated from the arena") {
+            REQUIRE(arena->blocks_alive() == paths.size());
+        }
+        THEN("The entities are not modified") {
+            for (size_t i = 0; i < paths.size(); ++ i)
+                REQUIRE(static_cast<const ExtrusionPath*>(collection.entities[i])->polyline.points == paths[i].polyline.points);
+        }
+        WHEN("The collection is copied outside of the scope") {
+            ExtrusionEntityCollection copy(collection);
+            THEN("The copies are allocated on the heap") {
+                REQUIRE(arena->blocks_alive() == paths.size());
+            }
+        }
+        WHEN("The collection is cleared") {
+            collection.clear();
+            THEN("The blocks are returned to the arena") {
+                REQUIRE(arena->blocks_alive() == 0);
+            }
+        }
+        // The arena is released while its entities are still alive, it will be deleted together with the last entity.
+        arena->release();
+    }
+}
@@ -1,10 +1,16 @@
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <numeric>
 #include <sstream>
 
+#include <tbb/parallel_for.h>
+
 #include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/Fill/Fill.hpp"
+#include "libslic3r/Fill/FillGyroid.hpp"
+#include "libslic3r/Fill/FillHoneycomb.hpp"
 #include "libslic3r/Flow.hpp"
 #include "libslic3r/Geometry.hpp"
 #include "libslic3r/Print.hpp"
@@ -190,6 +196,336 @@ TEST_CASE("Fill: Pattern Path Length", "[Fill]") {
     }
 }
 
+// Exposes the protected Fill::connect_infill().
+class FillConnectInfill : public Fill
+{
+public:
+    using Fill::connect_infill;
+    Fill* clone() const override { return new FillConnectInfill(*this); }
+};
+
+// Horizontal lines 1mm apart filling a 10x10mm square with a 2x2mm hole in the middle, in zig-zag order.
+// The lowest line is split in two lines with a coincident end point. The lines are then permuted.
+static Polylines connect_infill_test_lines()
+{
+    Polylines lines;
+    for (int row = 0; row < 10; ++ row) {
+        const double y = 0.5 + row;
+        Polylines row_lines;
+        if (row == 0) {
+            row_lines.emplace_back(Point::new_scale(0., y), Point::new_scale(5., y));
+            row_lines.emplace_back(Point::new_scale(5., y), Point::new_scale(10., y));
+        } else if (y > 4. && y < 6.) {
+            row_lines.emplace_back(Point::new_scale(0., y), Point::new_scale(4., y));
+            row_lines.emplace_back(Point::new_scale(6., y), Point::new_scale(10., y));
+        } else
+            row_lines.emplace_back(Point::new_scale(0., y), Point::new_scale(10., y));
+        if (row & 1) {
+            std::reverse(row_lines.begin(), row_lines.end());
+            for (Polyline &pl : row_lines)
+                pl.reverse();
+        }
+        append(lines, std::move(row_lines));
+    }
+    // Deterministic permutation, 7 is coprime with the number of lines.
+    REQUIRE(lines.size() == 13);
+    Polylines shuffled;
+    for (size_t i = 0; i < lines.size(); ++ i)
+        shuffled.emplace_back(lines[(i * 7) % lines.size()]);
+    return shuffled;
+}
+
+TEST_CASE("Fill: connect_infill", "[Fill]") {
+    const ExPolygon boundary(
+        Points { Point::new_scale(0, 0), Point::new_scale(10, 0), Point::new_scale(10, 10), Point::new_scale(0, 10) },
+        Points { Point::new_scale(4, 6), Point::new_scale(6, 6), Point::new_scale(6, 4), Point::new_scale(4, 4) });
+    FillConnectInfill filler;
+    FillParams        params;
+    params.density = 1.f;
+    filler.init_spacing(1., params);
+    const Polylines lines = connect_infill_test_lines();
+
+    auto scaled = [](std::initializer_list<Vec2d> pts) {
+        Points out;
+        for (const Vec2d &pt : pts)
+            out.emplace_back(Point::new_scale(pt.x(), pt.y()));
+        return out;
+    };
+    // Output of the original implementation, which searched all the frontier polylines and all the line ends linearly.
+    const std::vector<Points> expected {
+        scaled({ {0, 0.5}, {5, 0.5} }),
+        scaled({ {10, 5.5}, {6, 5.5} }),
+        scaled({ {5, 0.5}, {10, 0.5}, {10, 1}, {10, 1.5}, {0, 1.5}, {0, 4}, {0, 6.5}, {10, 6.5} }),
+        scaled({ {4, 5.5}, {0, 5.5} }),
+        scaled({ {0, 2.5}, {10, 2.5}, {10, 5}, {10, 7.5}, {0, 7.5} }),
+        scaled({ {10, 3.5}, {0, 3.5} }),
+        scaled({ {0, 9}, {0, 8.5}, {10, 8.5}, {10, 9}, {10, 9.5}, {0, 9.5}, {0, 9} }),
+        scaled({ {0, 4.5}, {4, 4.5} }),
+        scaled({ {6, 4.5}, {10, 4.5} })
+    };
+
+    SECTION("The connected lines are pinned") {
+        Polylines out;
+        filler.connect_infill(lines, boundary, out, params);
+        REQUIRE(out.size() == expected.size());
+        for (size_t i = 0; i < out.size(); ++ i)
+            REQUIRE(out[i].points == expected[i]);
+    }
+    SECTION("An empty hole does not change the result") {
+        ExPolygon boundary_empty_hole = boundary;
+        boundary_empty_hole.holes.insert(boundary_empty_hole.holes.begin(), Polygon());
+        Polylines out;
+        filler.connect_infill(lines, boundary_empty_hole, out, params);
+        REQUIRE(out.size() == expected.size());
+        for (size_t i = 0; i < out.size(); ++ i)
+            REQUIRE(out[i].points == expected[i]);
+    }
+}
+
+// The gyroid waves as generated point by point before the periods were replicated with Eigen array expressions.
+namespace gyroid_scalar {
+
+static inline double f(double x, double z_sin, double z_cos, bool vertical, bool flip)
+{
+    if (vertical) {
+        double phase_offset = (z_cos < 0 ? M_PI : 0) + M_PI;
+        double a   = sin(x + phase_offset);
+        double b   = - z_cos;
+        double res = z_sin * cos(x + phase_offset + (flip ? M_PI : 0.));
+        double r   = sqrt(sqr(a) + sqr(b));
+        return asin(a/r) + asin(res/r) + M_PI;
+    }
+    else {
+        double phase_offset = z_sin < 0 ? M_PI : 0.;
+        double a   = cos(x + phase_offset);
+        double b   = - z_sin;
+        double res = z_cos * sin(x + phase_offset + (flip ? 0 : M_PI));
+        double r   = sqrt(sqr(a) + sqr(b));
+        return (asin(a/r) + asin(res/r) + 0.5 * M_PI);
+    }
+}
+
+static Polyline make_wave(
+    const std::vector<Vec2d>& one_period, double width, double height, double offset, double scaleFactor,
+    double z_cos, double z_sin, bool vertical, bool flip)
+{
+    std::vector<Vec2d> points = one_period;
+    double period = points.back()(0);
+    if (width != period) {
+        points.pop_back();
+        size_t n = points.size();
+        do {
+            points.emplace_back(Vec2d(points[points.size()-n](0) + period, points[points.size()-n](1)));
+        } while (points.back()(0) < width - EPSILON);
+        points.emplace_back(Vec2d(width, f(width, z_sin, z_cos, vertical, flip)));
+    }
+    Polyline polyline;
+    for (auto& point : points) {
+        point(1) += offset;
+        point(1) = clamp(0., height, double(point(1)));
+        if (vertical)
+            std::swap(point(0), point(1));
+        polyline.points.emplace_back((point * scaleFactor).cast<coord_t>());
+    }
+    return polyline;
+}
+
+static std::vector<Vec2d> make_one_period(double width, double z_cos, double z_sin, bool vertical, bool flip, double tolerance)
+{
+    std::vector<Vec2d> points;
+    double limit = std::min(2*M_PI, width);
+    for (double x = 0.; x < limit - EPSILON; x += M_PI_2)
+        points.emplace_back(Vec2d(x, f(x, z_sin, z_cos, vertical, flip)));
+    points.emplace_back(Vec2d(limit, f(limit, z_sin, z_cos, vertical, flip)));
+    for (;;) {
+        size_t size = points.size();
+        for (size_t i = 1; i < size; ++ i) {
+            Vec2d  lp = points[i-1];
+            Vec2d  rp = points[i];
+            double x  = lp(0) + (rp(0) - lp(0)) / 2;
+            Vec2d  ip = { x, f(x, z_sin, z_cos, vertical, flip) };
+            if (std::abs(cross2(Vec2d(ip - lp), Vec2d(ip - rp))) > sqr(tolerance))
+                points.emplace_back(ip);
+        }
+        if (size == points.size())
+            break;
+        std::sort(points.begin(), points.end(), [](const Vec2d &lhs, const Vec2d &rhs) { return lhs(0) < rhs(0); });
+    }
+    return points;
+}
+
+static Polylines make_waves(double gridZ, double density_adjusted, double line_spacing, double width, double height)
+{
+    const double scaleFactor = scale_(line_spacing) / density_adjusted;
+    const double tolerance   = std::min(line_spacing / 2, FillGyroid::PatternTolerance) / unscale<double>(scaleFactor);
+    const double z           = gridZ / scaleFactor;
+    const double z_sin       = sin(z);
+    const double z_cos       = cos(z);
+    bool   vertical    = (std::abs(z_sin) <= std::abs(z_cos));
+    double lower_bound = 0.;
+    double upper_bound = height;
+    bool   flip        = true;
+    if (vertical) {
+        flip = false;
+        lower_bound = -M_PI;
+        upper_bound = width - M_PI_2;
+        std::swap(width, height);
+    }
+    std::vector<Vec2d> one_period_odd = make_one_period(width, z_cos, z_sin, vertical, flip, tolerance);
+    flip = !flip;
+    std::vector<Vec2d> one_period_even = make_one_period(width, z_cos, z_sin, vertical, flip, tolerance);
+    Polylines result;
+    for (double y0 = lower_bound; y0 < upper_bound + EPSILON; y0 += M_PI) {
+        result.emplace_back(make_wave(one_period_odd, width, height, y0, scaleFactor, z_cos, z_sin, vertical, flip));
+        y0 += M_PI;
+        if (y0 < upper_bound + EPSILON)
+            result.emplace_back(make_wave(one_period_even, width, height, y0, scaleFactor, z_cos, z_sin, vertical, flip));
+    }
+    return result;
+}
+
+} // namespace gyroid_scalar
+
+TEST_CASE("Fill: gyroid waves", "[Fill]") {
+    // The periods are replicated with the same floating point operations as point by point,
+    // only the rounding of the scaled coordinates to integers is allowed to differ.
+    const coord_t tolerance = 1;
+    size_t        num_points = 0;
+    for (double z : { 0.2, 0.35, 1.05, 7.4, 33.33 })
+        for (double density : { 0.1, 0.2, 0.5, 1. })
+            for (double width : { 2., 9., 40. })
+                for (double height : { 3., 25. }) {
+                    const double density_adjusted = density * FillGyroid::DensityAdjust;
+                    Polylines waves    = FillGyroid::make_waves(scale_(z), density_adjusted, 0.45, width, height);
+                    Polylines expected = gyroid_scalar::make_waves(scale_(z), density_adjusted, 0.45, width, height);
+                    INFO("z " << z << ", density " << density << ", width " << width << ", height " << height);
+                    REQUIRE(waves.size() == expected.size());
+                    for (size_t i = 0; i < waves.size(); ++ i) {
+                        REQUIRE(waves[i].points.size() == expected[i].points.size());
+                        coord_t max_error = 0;
+                        for (size_t j = 0; j < waves[i].points.size(); ++ j)
+                            max_error = std::max(max_error, (waves[i].points[j] - expected[i].points[j]).cwiseAbs().maxCoeff());
+                        REQUIRE(max_error <= tolerance);
+                        num_points += waves[i].points.size();
+                    }
+                }
+    REQUIRE(num_points > 0);
+}
+
+static bool same_polylines(const Polylines &lhs, const Polylines &rhs)
+{
+    return lhs.size() == rhs.size() &&
+        std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](const Polyline &l, const Polyline &r) { return l.points == r.points; });
+}
+
+TEST_CASE("Fill: gyroid wave periods cache", "[Fill]") {
+    const double density_adjusted = 0.2 * FillGyroid::DensityAdjust;
+    // Waves of a few layers calculated without the cache. The narrow waves are shorter than a period, they are cached separately.
+    const std::vector<double> zs { 0.2, 0.4, 0.6, 0.8, 1.0, 1.2, 1.4, 1.6 };
+    const std::vector<double> widths { 3., 20. };
+    std::vector<Polylines>    uncached;
+    for (double z : zs)
+        for (double width : widths)
+            uncached.emplace_back(FillGyroid::make_waves(scale_(z), density_adjusted, 0.45, width, 20., false));
+
+    SECTION("The cached periods give the same waves as the calculated ones") {
+        for (int pass = 0; pass < 2; ++ pass)
+            for (size_t i = 0; i < zs.size(); ++ i)
+                for (size_t j = 0; j < widths.size(); ++ j)
+                    REQUIRE(same_polylines(FillGyroid::make_waves(scale_(zs[i]), density_adjusted, 0.45, widths[j], 20.), uncached[i * widths.size() + j]));
+    }
+    SECTION("The cache is bounded") {
+        for (size_t i = 0; i < FillGyroid::MaxPeriodsCached + 100; ++ i) {
+            FillGyroid::make_waves(scale_(0.01 * double(i + 1)), density_adjusted, 0.45, 2., 2.);
+            REQUIRE(FillGyroid::periods_cached() <= FillGyroid::MaxPeriodsCached);
+        }
+        REQUIRE(FillGyroid::periods_cached() > 0);
+        REQUIRE(same_polylines(FillGyroid::make_waves(scale_(zs.front()), density_adjusted, 0.45, widths.back(), 20.), uncached[widths.size() - 1]));
+    }
+    SECTION("The cache is shared by concurrent fills") {
+        std::atomic<size_t> num_different(0);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, 256, 1), [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t k = range.begin(); k < range.end(); ++ k) {
+                size_t idx = (k * 7) % uncached.size();
+                if (! same_polylines(FillGyroid::make_waves(scale_(zs[idx / widths.size()]), density_adjusted, 0.45, widths[idx % widths.size()], 20.), uncached[idx]))
+                    ++ num_different;
+            }
+        });
+        REQUIRE(num_different == 0);
+    }
+}
+
+// Exposes the protected hexagon math cache of FillHoneycomb.
+class FillHoneycombCache : public FillHoneycomb
+{
+public:
+    static void clear()
+    {
+        std::lock_guard<std::mutex> lock(FillHoneycomb::cache_mutex);
+        FillHoneycomb::cache.clear();
+    }
+    static size_t size()
+    {
+        std::lock_guard<std::mutex> lock(FillHoneycomb::cache_mutex);
+        return FillHoneycomb::cache.size();
+    }
+};
+
+// Sparse infill of a 40x40mm square with a 10x10mm hole.
+static Polylines fill_test_surface(const std::string &pattern, coordf_t z, float density)
+{
+    std::unique_ptr<Fill> filler(Fill::new_from_type(pattern));
+    const ExPolygon expolygon(
+        Points { Point::new_scale(0, 0), Point::new_scale(40, 0), Point::new_scale(40, 40), Point::new_scale(0, 40) },
+        Points { Point::new_scale(15, 25), Point::new_scale(25, 25), Point::new_scale(25, 15), Point::new_scale(15, 15) });
+    filler->z            = z;
+    filler->layer_id     = size_t(z / 0.2);
+    filler->angle        = float(M_PI / 4.);
+    filler->bounding_box = get_extents(expolygon.contour);
+    FillParams params;
+    params.density     = density;
+    params.dont_adjust = true;
+    filler->init_spacing(0.45, params);
+    Surface surface(stPosInternal | stDensSparse, expolygon);
+    return filler->fill_surface(&surface, params);
+}
+
+TEST_CASE("Fill: concurrent fills with the shared caches", "[Fill]") {
+    const std::vector<std::string> patterns  { "gyroid", "honeycomb" };
+    const std::vector<float>       densities { 0.1f, 0.2f, 0.35f };
+    const std::vector<double>      zs        { 0.2, 0.4, 0.6 };
+    auto fill = [&](size_t idx) {
+        return fill_test_surface(patterns[idx % patterns.size()], zs[(idx / patterns.size()) % zs.size()], densities[idx / (patterns.size() * zs.size())]);
+    };
+    const size_t num_fills = patterns.size() * zs.size() * densities.size();
+
+    // Fill serially, each fill with empty caches.
+    std::vector<Polylines> uncached;
+    for (size_t idx = 0; idx < num_fills; ++ idx) {
+        FillHoneycombCache::clear();
+        uncached.emplace_back(fill(idx));
+        REQUIRE(! uncached.back().empty());
+    }
+
+    SECTION("A cached fill is the same as an uncached one") {
+        FillHoneycombCache::clear();
+        for (int pass = 0; pass < 2; ++ pass)
+            for (size_t idx = 0; idx < num_fills; ++ idx)
+                REQUIRE(same_polylines(fill(idx), uncached[idx]));
+        REQUIRE(FillHoneycombCache::size() == densities.size());
+    }
+    SECTION("Concurrent fills are the same as the serial ones") {
+        FillHoneycombCache::clear();
+        std::atomic<size_t> num_different(0);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, 4 * num_fills, 1), [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t k = range.begin(); k < range.end(); ++ k)
+                if (! same_polylines(fill(k % num_fills), uncached[k % num_fills]))
+                    ++ num_different;
+        });
+        REQUIRE(num_different == 0);
+    }
+}
+
 /*
 {
     my $collection = Slic3r::Polyline::Collection->new(
@@ -0,0 +1,190 @@
+#include <catch2/catch.hpp>
+
+#include "libslic3r/GCode/Analyzer.hpp"
+#include "libslic3r/GCode/PreviewData.hpp"
+
+#include <limits>
+#include <sstream>
+
+using namespace Slic3r;
+
+SCENARIO("GCodeAnalyzer applies the extrusion parameters passed by GCode", "[GCodeAnalyzer]") {
+    GIVEN("An analyzer and the parameters of a perimeter and of an external perimeter") {
+        GCodeAnalyzer analyzer;
+        const std::string tag = ";" + GCodeAnalyzer::Extrusion_Params_Tag + "\n";
+        std::vector<GCodeAnalyzer::ExtrusionParams> params { { erPerimeter, 0.0234, 0.45f, 0.2f }, { erExternalPerimeter, 0.0211, 0.5f, 0.2f } };
+        WHEN("The gcode containing a tag for each of them is processed") {
+            std::string output = analyzer.process_gcode("G1 Z0.2 F7800\n" + tag + "G1 X10 Y0 E1 F1800\n" + tag + "G1 X10 Y10 E2\n", params);
+            THEN("The tags are removed from the gcode") {
+                REQUIRE(output == "G1 Z0.2 F7800\nG1 X10 Y0 E1 F1800\nG1 X10 Y10 E2\n");
+            }
+            THEN("The extrusions carry the exact parameters in the order of the tags") {
+                GCodePreviewData preview_data;
+                analyzer.calc_gcode_preview_data(preview_data);
+                REQUIRE(preview_data.extrusion.layers.size() == 1);
+                REQUIRE(preview_data.extrusion.layers.front().paths.size() == 2);
+                for (size_t i = 0; i < 2; ++ i) {
+                    const GCodePreviewData::Extrusion::Path &path = preview_data.extrusion.layers.front().paths[i];
+                    REQUIRE(path.extrusion_role == params[i].extrusion_role);
+                    REQUIRE(path.width == params[i].width);
+                    REQUIRE(path.height == params[i].height);
+                    REQUIRE(path.mm3_per_mm == float(params[i].mm3_per_mm));
+                }
+            }
+        }
+        WHEN("The gcode contains more tags than parameters") {
+            analyzer.process_gcode("G1 Z0.2 F7800\n" + tag + "G1 X10 Y0 E1 F1800\n", { params.back() });
+            THEN("The tags without parameters are removed and ignored") {
+                std::string output = analyzer.process_gcode(tag + "G1 X20 Y0 E2\n");
+                REQUIRE(output == "G1 X20 Y0 E2\n");
+                GCodePreviewData preview_data;
+                analyzer.calc_gcode_preview_data(preview_data);
+                REQUIRE(preview_data.extrusion.layers.size() == 1);
+                for (const GCodePreviewData::Extrusion::Path &path : preview_data.extrusion.layers.front().paths) {
+                    REQUIRE(path.extrusion_role == erExternalPerimeter);
+                    REQUIRE(path.width == 0.5f);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeMovesList reconstructs the stored moves", "[GCodeAnalyzer]") {
+    GIVEN("Moves with runs of metadata, extruder offsets, discontinuities and layer changes") {
+        using GCodeMove = GCodeAnalyzer::GCodeMove;
+        GCodeAnalyzer::GCodeMovesList list(GCodeMove::Extrude);
+        std::vector<GCodeMove>        moves;
+        Vec3d position(0., 0., double(0.2f));
+        for (size_t i = 0; i < 1000; ++ i) {
+            Vec3d start = (i % 7 == 0) ? Vec3d(double(float(i)), 5., position.z()) : position;
+            if (i % 100 == 0)
+                start.z() = double(float(0.2 + 0.2 * double(i / 100)));
+            Vec3d end(double(float(i % 13) * 0.5f), double(float(i % 17) * 0.25f), start.z());
+            unsigned int            extruder_id = (i / 150) % 2;
+            GCodeAnalyzer::Metadata data(erPerimeter, extruder_id, 0.03, (i % 50 < 25) ? 0.45f : 0.5f, 0.2f, 30.f, 0.f);
+            // The offset is not representable by a float, it has to be applied exactly.
+            Vec2d                   extruder_offset = extruder_id ? Vec2d(20.1, -0.3) : Vec2d::Zero();
+            Vec3d                   offset(extruder_offset.x(), extruder_offset.y(), 0.);
+            list.append(data, extruder_offset, start, end, float(i));
+            moves.emplace_back(GCodeMove::Extrude, data, start + offset, end + offset, float(i));
+            position = end;
+        }
+        auto same = [](const GCodeMove &l, const GCodeMove &r) {
+            return l.type == r.type && ! (l.data != r.data) && l.start_position == r.start_position &&
+                l.end_position == r.end_position && l.delta_extruder == r.delta_extruder;
+        };
+        THEN("Iterating over all the moves returns them in order") {
+            size_t idx = 0;
+            size_t num_different = 0;
+            list.for_each([&](const GCodeMove &move) { num_different += ! same(move, moves[idx ++]); });
+            REQUIRE(idx == moves.size());
+            REQUIRE(num_different == 0);
+        }
+        THEN("A range of moves and single moves are accessible randomly") {
+            size_t idx = 333;
+            size_t num_different = 0;
+            list.for_each(333, 777, [&](const GCodeMove &move) { num_different += ! same(move, moves[idx ++]); });
+            REQUIRE(idx == 777);
+            REQUIRE(num_different == 0);
+            for (size_t i : { 0, 1, 7, 99, 100, 101, 150, 151, 999 })
+                REQUIRE(same(list[i], moves[i]));
+        }
+        THEN("The layers are indexed") {
+            REQUIRE(list.layers().size() == 10);
+            REQUIRE(list.layers()[3].first_move == 300);
+        }
+    }
+}
+
+// G-code of a print with a few extrusions, travels, retractions and unretractions per layer.
+static std::string make_preview_test_gcode(size_t num_layers, std::vector<GCodeAnalyzer::ExtrusionParams> &extrusion_params)
+{
+    std::ostringstream gcode;
+    double e = 0.;
+    for (size_t layer = 0; layer < num_layers; ++ layer) {
+        const double z = 0.2 * double(layer + 1);
+        gcode << "G1 Z" << z << " F7800\n";
+        gcode << "G1 X" << 5 + layer % 3 << " Y" << 5 + layer % 4 << " F7800\n";
+        gcode << "G1 E" << e << " F2400\n";
+        gcode << ";" << GCodeAnalyzer::Extrusion_Params_Tag << "\n";
+        extrusion_params.push_back({ (layer & 1) ? erPerimeter : erInternalInfill, 0.02 + 0.001 * double(layer % 5), 0.4f + 0.01f * float(layer % 5), 0.2f });
+        for (size_t i = 0; i < 10; ++ i) {
+            e += 0.1;
+            gcode << "G1 X" << 10 + (i * 7 + layer) % 20 << " Y" << 10 + (i * 3 + layer) % 20 << " E" << e << " F" << 1200 + 60 * (i % 4) << "\n";
+        }
+        gcode << "G1 E" << e - 1. << " F2400\n";
+    }
+    return gcode.str();
+}
+
+// Calculates the preview data of the G-code, processing the moves in chunks of at least min_moves_per_task moves.
+static void calc_preview_test_data(size_t num_layers, size_t min_moves_per_task, GCodePreviewData &preview_data)
+{
+    GCodeAnalyzer analyzer;
+    analyzer.set_preview_min_moves_per_task(min_moves_per_task);
+    std::vector<GCodeAnalyzer::ExtrusionParams> extrusion_params;
+    std::string gcode = make_preview_test_gcode(num_layers, extrusion_params);
+    analyzer.process_gcode(gcode, extrusion_params);
+    analyzer.calc_gcode_preview_data(preview_data);
+}
+
+SCENARIO("GCodeAnalyzer preview does not depend on the task size", "[GCodeAnalyzer]") {
+    GIVEN("G-code of 30 layers") {
+        GCodePreviewData chunked;
+        GCodePreviewData single;
+        WHEN("The preview is calculated with a task per layer and with a single task") {
+            calc_preview_test_data(30, 1, chunked);
+            calc_preview_test_data(30, std::numeric_limits<size_t>::max(), single);
+            THEN("The extrusion layers are identical") {
+                REQUIRE(single.extrusion.layers.size() == 30);
+                REQUIRE(chunked.extrusion.layers.size() == single.extrusion.layers.size());
+                size_t num_different = 0;
+                for (size_t i = 0; i < single.extrusion.layers.size(); ++ i) {
+                    const GCodePreviewData::Extrusion::Layer &l = chunked.extrusion.layers[i];
+                    const GCodePreviewData::Extrusion::Layer &r = single.extrusion.layers[i];
+                    num_different += l.z != r.z || l.paths.size() != r.paths.size();
+                    for (size_t j = 0; j < std::min(l.paths.size(), r.paths.size()); ++ j) {
+                        const GCodePreviewData::Extrusion::Path &pl = l.paths[j];
+                        const GCodePreviewData::Extrusion::Path &pr = r.paths[j];
+                        num_different += pl.polyline.points != pr.polyline.points || pl.extrusion_role != pr.extrusion_role ||
+                            pl.mm3_per_mm != pr.mm3_per_mm || pl.width != pr.width || pl.height != pr.height || pl.feedrate != pr.feedrate ||
+                            pl.extruder_id != pr.extruder_id || pl.cp_color_id != pr.cp_color_id || pl.fan_speed != pr.fan_speed;
+                    }
+                }
+                REQUIRE(num_different == 0);
+            }
+            THEN("The travel polylines are identical") {
+                REQUIRE(! single.travel.polylines.empty());
+                REQUIRE(chunked.travel.polylines.size() == single.travel.polylines.size());
+                size_t num_different = 0;
+                for (size_t i = 0; i < single.travel.polylines.size(); ++ i) {
+                    const GCodePreviewData::Travel::Polyline &l = chunked.travel.polylines[i];
+                    const GCodePreviewData::Travel::Polyline &r = single.travel.polylines[i];
+                    num_different += l.type != r.type || l.direction != r.direction || l.feedrate != r.feedrate ||
+                        l.extruder_id != r.extruder_id || l.polyline.points != r.polyline.points;
+                }
+                REQUIRE(num_different == 0);
+            }
+            THEN("The retractions and unretractions are identical") {
+                REQUIRE(single.retraction.positions.size() == 30);
+                for (const GCodePreviewData::Retraction *retraction : { &single.retraction, &single.unretraction }) {
+                    const GCodePreviewData::Retraction &other = (retraction == &single.retraction) ? chunked.retraction : chunked.unretraction;
+                    REQUIRE(other.positions.size() == retraction->positions.size());
+                    size_t num_different = 0;
+                    for (size_t i = 0; i < retraction->positions.size(); ++ i)
+                        num_different += other.positions[i].position != retraction->positions[i].position ||
+                            other.positions[i].width != retraction->positions[i].width || other.positions[i].height != retraction->positions[i].height;
+                    REQUIRE(num_different == 0);
+                }
+            }
+            THEN("The ranges are identical") {
+                for (auto range : { &GCodePreviewData::Ranges::height, &GCodePreviewData::Ranges::width, &GCodePreviewData::Ranges::fan_speed, &GCodePreviewData::Ranges::volumetric_rate }) {
+                    REQUIRE((chunked.ranges.*range).min() == (single.ranges.*range).min());
+                    REQUIRE((chunked.ranges.*range).max() == (single.ranges.*range).max());
+                }
+                REQUIRE(chunked.ranges.feedrate.min() == single.ranges.feedrate.min());
+                REQUIRE(chunked.ranges.feedrate.max() == single.ranges.feedrate.max());
+            }
+        }
+    }
+}
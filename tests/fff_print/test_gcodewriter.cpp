@@ -1,6 +1,9 @@
 #include <catch2/catch.hpp>
 
+#include <iomanip>
 #include <memory>
+#include <random>
+#include <sstream>
 
 #include "libslic3r/GCodeWriter.hpp"
 
@@ -94,3 +97,88 @@ SCENARIO("set_speed emits values with fixed-point output.", "[GCodeWriter]") {
         }
     }
 }
+
+SCENARIO("set_speed sets the duration of the OpenFL moves.", "[GCodeWriter]") {
+
+    GIVEN("GCodeWriter instance with the OpenFL flavor") {
+        GCodeWriter writer;
+        writer.config.gcode_flavor.value = gcfopenfl;
+        // Moves starting at the origin are not emitted.
+        REQUIRE(writer.travel_to_xy(Vec2d(1., 1.)).empty());
+        WHEN("set_speed is called to set speed to 10") {
+            THEN("No G-code is emitted") {
+                REQUIRE(writer.set_speed(10.).empty());
+            }
+            AND_WHEN("the head travels by 5mm") {
+                writer.set_speed(10.);
+                std::string gcode = writer.travel_to_xy(Vec2d(4., 5.));
+                THEN("The move takes 0.5 time units") {
+                    REQUIRE(gcode.find("(4, 5), 0.5, mW=") != std::string::npos);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeG1Formatter prints numbers the same way as std::fixed.", "[GCodeWriter]") {
+    auto fixed = [](double v, int digits) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(digits) << v;
+        return ss.str();
+    };
+    auto formatted = [](double v, int digits) {
+        std::string out;
+        GCodeG1Formatter::append_fixed(out, v, digits);
+        return out;
+    };
+    GIVEN("Values at and close to the rounding ties, negative zeros and values out of the integer range") {
+        for (double v : { 0., -0., 0.0625, -0.0625, 0.0005, -0.0004, 2.5e-5, 1.0000049999, 203.200522, 99999.123, 123456789.0125, 1e15, -1e20 })
+            for (int digits : { 0, 3, 5 })
+                THEN("Output of " << v << " with " << digits << " digits is " << fixed(v, digits)) {
+                    REQUIRE(formatted(v, digits) == fixed(v, digits));
+                }
+    }
+    GIVEN("Random coordinates") {
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<double> dist(-500., 500.);
+        THEN("The output is identical to std::fixed for 3 and 5 digits") {
+            size_t mismatches = 0;
+            for (size_t i = 0; i < 100000; ++ i) {
+                double v = dist(rng);
+                // Also test the values rounded to the output precision, shifted to the ties.
+                for (double w : { v, std::round(v * 1000.) / 1000. + 0.0005 })
+                    for (int digits : { 3, 5 })
+                        if (formatted(w, digits) != fixed(w, digits))
+                            ++ mismatches;
+            }
+            REQUIRE(mismatches == 0);
+        }
+    }
+}
+
+SCENARIO("Moves are emitted with fixed-point coordinates.", "[GCodeWriter]") {
+    GIVEN("GCodeWriter instance with a single extruder") {
+        GCodeWriter writer;
+        writer.config.gcode_comments.value = true;
+        writer.set_extruders({ 0 });
+        writer.set_tool(0);
+        WHEN("travel_to_xy is called") {
+            writer.config.travel_speed.value = 130.;
+            THEN("X, Y and F have 3 digits") {
+                REQUIRE_THAT(writer.travel_to_xy(Vec2d(10.0625, -2.), "move"), Catch::Equals("G1 X10.062 Y-2.000 F7800.000 ; move\n"));
+            }
+        }
+        WHEN("travel_to_z is called") {
+            writer.config.travel_speed.value = 130.;
+            THEN("Z and F have 3 digits") {
+                REQUIRE_THAT(writer.travel_to_z(0.35), Catch::Equals("G1 Z0.350 F7800.000\n"));
+            }
+        }
+        WHEN("extrude_to_xy is called") {
+            THEN("E has 5 digits") {
+                std::string gcode = writer.extrude_to_xy(Vec2d(104.3174, 95.6826), 0.038264);
+                REQUIRE_THAT(gcode, Catch::Equals("G1 X104.317 Y95.683 " + writer.extrusion_axis() + "0.03826\n"));
+            }
+        }
+    }
+}
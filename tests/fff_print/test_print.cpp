@@ -3,6 +3,10 @@
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/Print.hpp"
 
+#include <algorithm>
+
+#include <tbb/task_arena.h>
+
 #include "test_data.hpp"
 
 using namespace Slic3r;
@@ -29,6 +33,88 @@ SCENARIO("PrintObject: Perimeter generation", "[PrintObject]") {
     }
 }
 
+SCENARIO("PrintObject: Perimeters and infill of many islands per layer", "[PrintObject]") {
+    GIVEN("2mm tall plate of 16 separate 4mm cubes") {
+        TriangleMesh plate;
+        for (size_t i = 0; i < 16; ++ i) {
+            TriangleMesh cube = make_cube(4., 4., 2.);
+            cube.translate(10.f * float(i % 4), 10.f * float(i / 4), 0.f);
+            plate.merge(cube);
+        }
+        // Collect the number of islands and the points of the perimeters and of the infill, layer by layer, region by region.
+        struct Extrusions {
+            std::vector<size_t> islands;
+            std::vector<Points> points;
+        };
+        auto extrusions = [&plate]() {
+            Slic3r::Print print;
+            Slic3r::Test::init_and_process_print({ plate }, print, { { "fill_density", "20%" }, { "layer_height", 0.2 }, { "first_layer_height", 0.2 } });
+            Extrusions out;
+            for (const Layer *layer : print.objects().front()->layers())
+                for (const LayerRegion *layerm : layer->regions()) {
+                    out.islands.emplace_back(layerm->perimeters.entities.size());
+                    for (const ExtrusionEntityCollection *collection : { &layerm->perimeters, &layerm->fills }) {
+                        out.points.emplace_back();
+                        for (const Polyline &polyline : collection->as_polylines())
+                            append(out.points.back(), polyline.points);
+                    }
+                }
+            return out;
+        };
+        WHEN("the print is processed by a single thread and by all the threads") {
+            Extrusions      single_thread;
+            tbb::task_arena arena(1);
+            arena.execute([&single_thread, &extrusions]() { single_thread = extrusions(); });
+            Extrusions      all_threads = extrusions();
+            THEN("every layer has the perimeters of all the islands") {
+                REQUIRE(! all_threads.islands.empty());
+                for (size_t islands : all_threads.islands)
+                    REQUIRE(islands == 16);
+            }
+            THEN("the perimeters and the infill are output in the same order") {
+                REQUIRE(single_thread.islands == all_threads.islands);
+                REQUIRE(single_thread.points == all_threads.points);
+            }
+        }
+    }
+}
+
+SCENARIO("Print: Objects processed concurrently", "[Print]") {
+    GIVEN("Three different objects with support material") {
+        // Export the G-code of the print, collect the progress reported while processing it.
+        auto export_gcode = [](std::vector<int> &progress) {
+            Slic3r::Print print;
+            Slic3r::Model model;
+            Slic3r::Test::init_print({ TestMesh::cube_20x20x20, TestMesh::overhang, TestMesh::pyramid }, print, model, {
+                { "support_material",   true },
+                { "fill_density",       "20%" }
+                });
+            print.set_status_callback([&progress](const PrintBase::SlicingStatus &status) { progress.emplace_back(status.percent); });
+            print.process();
+            std::string gcode = Slic3r::Test::gcode(print);
+            // Drop the "; generated by ... on <timestamp>" header line.
+            return gcode.substr(gcode.find('\n') + 1);
+        };
+        WHEN("the objects are processed by a single thread and by all the threads") {
+            std::vector<int> single_thread_progress;
+            std::vector<int> all_threads_progress;
+            std::string     single_thread;
+            tbb::task_arena arena(1);
+            arena.execute([&single_thread, &single_thread_progress, &export_gcode]() { single_thread = export_gcode(single_thread_progress); });
+            std::string     all_threads = export_gcode(all_threads_progress);
+            THEN("the G-code is identical") {
+                REQUIRE(! single_thread.empty());
+                REQUIRE(single_thread == all_threads);
+            }
+            THEN("the progress is monotonic") {
+                REQUIRE(! all_threads_progress.empty());
+                REQUIRE(std::is_sorted(all_threads_progress.begin(), all_threads_progress.end()));
+                REQUIRE(single_thread_progress == all_threads_progress);
+            }
+        }
+    }
+}
+
 SCENARIO("Print: Skirt generation", "[Print]") {
     GIVEN("20mm cube and default config") {
         WHEN("Skirts is set to 2 loops")  {
@@ -1,11 +1,18 @@
 #include <catch2/catch.hpp>
 
 #include "libslic3r/libslic3r.h"
+#include "libslic3r/GCode.hpp"
 #include "libslic3r/GCodeReader.hpp"
 
 #include "test_data.hpp"
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <boost/nowide/cstdio.hpp>
 #include <boost/regex.hpp>
 
 using namespace Slic3r;
@@ -268,3 +275,281 @@ SCENARIO( "PrintGCode basic functionality", "[PrintGCode]") {
         }
     }
 }
+
+// Export the G-code of an already processed print with the layer pipeline enabled or disabled,
+// with the remaining times inserted while writing the file or by post processing the written file,
+// with the motion planner graphs shared between the layers or calculated by each layer.
+static std::string export_gcode_pipelined(Print &print, bool pipelined, bool single_pass = true, bool share_mp_graphs = true)
+{
+    boost::filesystem::path temp = boost::filesystem::unique_path();
+    GCode gcodegen;
+    gcodegen.set_pipelined_export(pipelined);
+    gcodegen.set_single_pass_export(single_pass);
+    gcodegen.set_share_motion_planner_graphs(share_mp_graphs);
+    gcodegen.do_export(&print, temp.string().c_str());
+    std::ifstream t(temp.string());
+    std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+    boost::nowide::remove(temp.string().c_str());
+    // Drop the "; generated by ... on <timestamp>" header line, it differs between the two exports.
+    return str.substr(str.find('\n') + 1);
+}
+
+static void check_pipelined_export_matches_serial(std::initializer_list<TestMesh> meshes, std::initializer_list<Slic3r::ConfigBase::SetDeserializeItem> config_items)
+{
+    std::string gcode[2];
+    for (int pipelined = 0; pipelined < 2; ++ pipelined) {
+        Slic3r::Print print;
+        Slic3r::Test::init_and_process_print(meshes, print, config_items);
+        gcode[pipelined] = export_gcode_pipelined(print, pipelined != 0);
+    }
+    REQUIRE(! gcode[0].empty());
+    REQUIRE(gcode[0] == gcode[1]);
+}
+
+SCENARIO("PrintGCode pipelined export", "[PrintGCode]") {
+    GIVEN("A print exported layer by layer and through the layer pipeline") {
+        WHEN("a single object is printed") {
+            THEN("the G-code is identical") {
+                check_pipelined_export_matches_serial({ TestMesh::cube_20x20x20 }, {
+                    { "gcode_comments",                 true },
+                    { "cooling",                        "1" },
+                    { "fan_always_on",                  "1" }
+                    });
+            }
+        }
+        WHEN("multiple objects are printed sequentially") {
+            THEN("the G-code is identical") {
+                check_pipelined_export_matches_serial({ TestMesh::cube_20x20x20, TestMesh::cube_20x20x20 }, {
+                    { "complete_objects",               true },
+                    { "layer_gcode",                    ";Layer:[layer_num] ([layer_z] mm)" }
+                    });
+            }
+        }
+        WHEN("multiple objects and support material are printed layer by layer") {
+            THEN("the G-code is identical") {
+                check_pipelined_export_matches_serial({ TestMesh::overhang, TestMesh::cube_20x20x20 }, {
+                    { "support_material",               true },
+                    { "skirts",                         2 }
+                    });
+            }
+        }
+        WHEN("spiral vase is enabled") {
+            THEN("the G-code is identical") {
+                check_pipelined_export_matches_serial({ TestMesh::cube_20x20x20 }, {
+                    { "spiral_vase",                    true },
+                    { "perimeters",                     1 },
+                    { "fill_density",                   0 },
+                    { "top_solid_layers",               0 },
+                    { "bottom_solid_layers",            0 }
+                    });
+            }
+        }
+    }
+}
+
+SCENARIO("PrintGCode avoid crossing perimeters", "[PrintGCode]") {
+    GIVEN("A print of multiple islands with avoid_crossing_perimeters") {
+        // Index: pipelined * 2 + share_mp_graphs
+        std::string gcode[4];
+        for (int pipelined = 0; pipelined < 2; ++ pipelined)
+            for (int share_mp_graphs = 0; share_mp_graphs < 2; ++ share_mp_graphs) {
+                Slic3r::Print print;
+                Slic3r::Test::init_and_process_print({ TestMesh::two_hollow_squares, TestMesh::cube_20x20x20, TestMesh::cube_20x20x20 }, print, {
+                    { "avoid_crossing_perimeters",      true },
+                    { "gcode_comments",                 true }
+                    });
+                gcode[pipelined * 2 + share_mp_graphs] = export_gcode_pipelined(print, pipelined != 0, true, share_mp_graphs != 0);
+            }
+        REQUIRE(! gcode[0].empty());
+        WHEN("the motion planner graphs are calculated by each layer or shared through the cache") {
+            THEN("the G-code is identical") {
+                REQUIRE(gcode[0] == gcode[1]);
+                REQUIRE(gcode[2] == gcode[3]);
+            }
+        }
+        WHEN("the G-code is exported layer by layer or through the layer pipeline") {
+            THEN("the G-code is identical") {
+                REQUIRE(gcode[0] == gcode[2]);
+                REQUIRE(gcode[1] == gcode[3]);
+            }
+        }
+    }
+}
+
+// Check the M73 lines of the given mode ('P' for the normal mode, 'Q' for the silent mode) to be well formed,
+// return their percentages and remaining minutes.
+static std::vector<std::pair<int, int>> check_remaining_times(const std::string &gcode, char percent)
+{
+    const std::string prefix = std::string("M73 ") + percent;
+    const std::string format = prefix + "%d " + ((percent == 'P') ? 'R' : 'S') + "%d";
+    std::vector<std::pair<int, int>> times;
+    std::istringstream is(gcode);
+    for (std::string line; std::getline(is, line);)
+        if (line.compare(0, prefix.size(), prefix) == 0) {
+            // The M73 lines are padded to a fixed length, their values are filled in once the print time is known.
+            REQUIRE(line.size() == GCodeTimeEstimator::RemainingTimesWriter::M73_Line_Length);
+            int p = -1, r = -1;
+            REQUIRE(sscanf(line.c_str(), format.c_str(), &p, &r) == 2);
+            times.emplace_back(p, r);
+        }
+    REQUIRE(times.size() > 2);
+    REQUIRE(times.front().first == 0);
+    REQUIRE(times.front().second > 0);
+    REQUIRE(times.back() == std::make_pair(100, 0));
+    for (size_t i = 1; i < times.size(); ++ i) {
+        REQUIRE(times[i - 1].first <= times[i].first);
+        REQUIRE(times[i - 1].second >= times[i].second);
+    }
+    return times;
+}
+
+// G-code blocks of a synthetic print with the given number of layers, passed to the time estimators one by one as by GCode.
+static std::vector<std::string> remaining_times_test_gcode(size_t num_layers)
+{
+    std::vector<std::string> blocks;
+    blocks.emplace_back(GCodeTimeEstimator::Normal_First_M73_Output_Placeholder_Tag + "\n" +
+        GCodeTimeEstimator::Silent_First_M73_Output_Placeholder_Tag + "\nG21\nG90\nM82\nG92 E0\n");
+    char line[128];
+    double e = 0.;
+    for (size_t layer = 0; layer < num_layers; ++ layer) {
+        std::string gcode;
+        sprintf(line, "G1 Z%.3f F600\nG1 X0 Y0 F9000\n", 0.2 * double(layer + 1));
+        gcode += line;
+        for (int i = 1; i <= 100; ++ i) {
+            e += 0.05;
+            sprintf(line, "G1 X%d Y%d E%.5f F1200\n", (i % 2) * 50, i, e);
+            gcode += line;
+        }
+        if (layer == num_layers / 2)
+            gcode += "; " + GCodeTimeEstimator::Color_Change_Tag + "\nM600\n";
+        blocks.emplace_back(std::move(gcode));
+    }
+    blocks.emplace_back(GCodeTimeEstimator::Normal_Last_M73_Output_Placeholder_Tag + "\n" +
+        GCodeTimeEstimator::Silent_Last_M73_Output_Placeholder_Tag + "\n");
+    return blocks;
+}
+
+TEST_CASE("Remaining times written while exporting", "[GCodeTimeEstimator]") {
+    // Some 3 hours of print.
+    std::vector<std::string> blocks = remaining_times_test_gcode(40);
+    std::string gcode[2];
+    for (int single_pass = 0; single_pass < 2; ++ single_pass) {
+        GCodeTimeEstimator normal(GCodeTimeEstimator::Normal);
+        GCodeTimeEstimator silent(GCodeTimeEstimator::Silent);
+        silent.set_acceleration(500.f);
+        boost::filesystem::path temp = boost::filesystem::unique_path();
+        FILE *file = boost::nowide::fopen(temp.string().c_str(), "wb");
+        REQUIRE(file != nullptr);
+        std::unique_ptr<GCodeTimeEstimator::RemainingTimesWriter> writer;
+        if (single_pass) {
+            GCodeTimeEstimator::PostProcessData normal_data = normal.get_post_process_data();
+            GCodeTimeEstimator::PostProcessData silent_data = silent.get_post_process_data();
+            writer.reset(new GCodeTimeEstimator::RemainingTimesWriter(&normal_data, &silent_data, 60.f));
+        }
+        for (const std::string &block : blocks) {
+            for (GCodeTimeEstimator *estimator : { &normal, &silent }) {
+                estimator->add_gcode_block(block);
+                estimator->resolve_times();
+            }
+            if (writer) {
+                // Split the block in the middle of a line, the writer continues the unterminated line with the next write.
+                size_t half = block.size() / 2;
+                writer->write(file, block.data(), half);
+                writer->write(file, block.data() + half, block.size() - half);
+            } else
+                fwrite(block.data(), 1, block.size(), file);
+        }
+        normal.calculate_time(false);
+        silent.calculate_time(false);
+        if (writer)
+            writer->finalize(file, normal.get_time(), silent.get_time());
+        fclose(file);
+        if (! single_pass) {
+            GCodeTimeEstimator::PostProcessData normal_data = normal.get_post_process_data();
+            GCodeTimeEstimator::PostProcessData silent_data = silent.get_post_process_data();
+            GCodeTimeEstimator::post_process(temp.string(), 60.f, &normal_data, &silent_data);
+        }
+        std::ifstream t(temp.string(), std::ios::binary);
+        gcode[single_pass].assign((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+        t.close();
+        boost::nowide::remove(temp.string().c_str());
+    }
+
+    REQUIRE(gcode[0] == gcode[1]);
+    REQUIRE(gcode[1].find(GCodeTimeEstimator::Normal_First_M73_Output_Placeholder_Tag) == std::string::npos);
+    REQUIRE(gcode[1].find(GCodeTimeEstimator::Silent_Last_M73_Output_Placeholder_Tag) == std::string::npos);
+    REQUIRE(gcode[1].find(GCodeTimeEstimator::Color_Change_Tag) == std::string::npos);
+    // A line every minute.
+    REQUIRE(check_remaining_times(gcode[1], 'P').size() > 100);
+    std::vector<std::pair<int, int>> silent_times = check_remaining_times(gcode[1], 'Q');
+    REQUIRE(silent_times.size() > 100);
+    REQUIRE(silent_times.front().second >= check_remaining_times(gcode[1], 'P').front().second);
+}
+
+SCENARIO("PrintGCode single pass export", "[PrintGCode]") {
+    GIVEN("A print with remaining times enabled") {
+        for (const char *silent_mode : { "0", "1" }) {
+            WHEN(std::string("the G-code is exported with silent_mode = ") + silent_mode) {
+                std::string gcode[2];
+                for (int single_pass = 0; single_pass < 2; ++ single_pass) {
+                    Slic3r::Print print;
+                    Slic3r::Test::init_and_process_print({ TestMesh::cube_20x20x20 }, print, {
+                        { "gcode_flavor",                   "marlin" },
+                        { "remaining_times",                true },
+                        { "silent_mode",                    silent_mode }
+                        });
+                    gcode[single_pass] = export_gcode_pipelined(print, true, single_pass != 0);
+                }
+                THEN("the remaining times are inserted") {
+                    REQUIRE(gcode[1].find("M73 P0 R") != std::string::npos);
+                    REQUIRE(gcode[1].find("M73 P100 R0") != std::string::npos);
+                    REQUIRE(gcode[1].find(GCodeTimeEstimator::Normal_First_M73_Output_Placeholder_Tag) == std::string::npos);
+                    check_remaining_times(gcode[1], 'P');
+                    if (silent_mode[0] == '1')
+                        check_remaining_times(gcode[1], 'Q');
+                }
+                THEN("the G-code is identical to the post processed one") {
+                    REQUIRE(gcode[0] == gcode[1]);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("PrintGCode machine envelope", "[PrintGCode]") {
+    GIVEN("A Marlin print with the machine envelope enabled") {
+        std::string gcode[2];
+        for (int single_pass = 0; single_pass < 2; ++ single_pass) {
+            Slic3r::Print print;
+            Slic3r::Test::init_and_process_print({ TestMesh::cube_20x20x20 }, print, {
+                { "gcode_flavor",                   "marlin" },
+                { "print_machine_envelope",         true },
+                { "remaining_times",                true },
+                { "gcode_comments",                 true },
+                { "start_gcode",                    ";START_GCODE_MARKER" }
+                });
+            gcode[single_pass] = export_gcode_pipelined(print, true, single_pass != 0);
+        }
+        THEN("the machine limits are emitted after the header and before the start G-code") {
+            for (const std::string &str : gcode) {
+                size_t header = str.find("; external perimeters extrusion width");
+                size_t m201   = str.find("M201 X");
+                size_t m566   = str.find("M566 X");
+                size_t start  = str.find(";START_GCODE_MARKER");
+                REQUIRE(header != std::string::npos);
+                REQUIRE(m201   != std::string::npos);
+                REQUIRE(m566   != std::string::npos);
+                REQUIRE(start  != std::string::npos);
+                REQUIRE(header < m201);
+                REQUIRE(m201   < m566);
+                REQUIRE(m566   < str.find("M205 S"));
+                REQUIRE(str.find("M205 S") < start);
+                // The envelope is written verbatim, not as the first line of the file.
+                REQUIRE(str.compare(0, 4, "M201") != 0);
+            }
+        }
+        THEN("the G-code is identical with and without single pass export") {
+            REQUIRE(gcode[0] == gcode[1]);
+        }
+    }
+}
@@ -3,6 +3,8 @@
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/Print.hpp"
 
+#include <set>
+
 #include "test_data.hpp"
 
 using namespace Slic3r;
@@ -86,3 +88,224 @@ SCENARIO("PrintObject: object layer heights", "[PrintObject]") {
 #endif
     }
 }
+
+SCENARIO("PrintObject: reslicing after a change of the layer height", "[PrintObject]") {
+    GIVEN("20mm cube sliced with 0.2mm layers") {
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        config.set_deserialize({
+            { "first_layer_height", 0.2 },
+            { "layer_height",       0.2 }
+        });
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({TestMesh::cube_20x20x20}, print, model, config);
+        print.process();
+        REQUIRE(print.objects().front()->layers().size() == 100);
+        WHEN("the layer height is changed to 0.3mm and the object is sliced again") {
+            config.set_deserialize({ { "layer_height", 0.3 } });
+            print.apply(model, config);
+            print.process();
+            Slic3r::Print fresh_print;
+            Slic3r::Model fresh_model;
+            Slic3r::Test::init_print({TestMesh::cube_20x20x20}, fresh_print, fresh_model, config);
+            fresh_print.process();
+            const std::vector<Slic3r::Layer*> &layers       = print.objects().front()->layers();
+            const std::vector<Slic3r::Layer*> &fresh_layers = fresh_print.objects().front()->layers();
+            THEN("The layers match the layers of a print sliced from scratch") {
+                REQUIRE(layers.size() < 100);
+                REQUIRE(layers.size() == fresh_layers.size());
+                for (size_t i = 0; i < layers.size(); ++ i) {
+                    REQUIRE(layers[i]->print_z == Approx(fresh_layers[i]->print_z));
+                    REQUIRE(layers[i]->lslices.size() == fresh_layers[i]->lslices.size());
+                    for (size_t j = 0; j < layers[i]->lslices.size(); ++ j)
+                        REQUIRE(layers[i]->lslices[j].area() == Approx(fresh_layers[i]->lslices[j].area()));
+                }
+            }
+        }
+    }
+}
+
+// Mapping of the option keys to the invalidated steps as implemented by PrintObject::invalidate_state_by_config_options()
+// before the dependency table, returns false for the options resetting all the steps.
+static bool legacy_config_option_dependency(const t_config_option_key &opt_key, std::vector<PrintObjectStep> &steps, std::vector<PrintStep> &print_steps)
+{
+    if (   opt_key == "perimeters"
+        || opt_key == "extra_perimeters"
+        || opt_key == "extra_perimeters_odd_layers"
+        || opt_key == "gap_fill"
+        || opt_key == "gap_fill_speed"
+        || opt_key == "overhangs"
+        || opt_key == "overhangs_width"
+        || opt_key == "overhangs_reverse"
+        || opt_key == "overhangs_reverse_threshold"
+        || opt_key == "first_layer_extrusion_width"
+        || opt_key == "perimeter_extrusion_width"
+        || opt_key == "infill_overlap"
+        || opt_key == "thin_perimeters"
+        || opt_key == "thin_walls"
+        || opt_key == "thin_walls_min_width"
+        || opt_key == "thin_walls_overlap"
+        || opt_key == "external_perimeters_first"
+        || opt_key == "external_perimeters_vase"
+        || opt_key == "external_perimeters_nothole"
+        || opt_key == "external_perimeters_hole"
+        || opt_key == "perimeter_loop"
+        || opt_key == "perimeter_loop_seam"
+        || opt_key == "only_one_perimeter_top"
+        || opt_key == "no_perimeter_unsupported_algo") {
+        steps.emplace_back(posPerimeters);
+    } else if (
+           opt_key == "layer_height"
+        || opt_key == "first_layer_height"
+        || opt_key == "exact_last_layer_height"
+        || opt_key == "raft_layers"
+        || opt_key == "slice_closing_radius"
+        || opt_key == "clip_multipart_objects"
+        || opt_key == "elefant_foot_compensation"
+        || opt_key == "support_material_contact_distance_type" 
+        || opt_key == "support_material_contact_distance_top" 
+        || opt_key == "support_material_contact_distance_bottom" 
+        || opt_key == "xy_size_compensation"
+        || opt_key == "hole_size_compensation"
+        || opt_key == "hole_to_polyhole") {
+        steps.emplace_back(posSlice);
+    } else if (opt_key == "support_material") {
+        steps.emplace_back(posSupportMaterial);
+    } else if (
+           opt_key == "support_material_auto"
+        || opt_key == "support_material_angle"
+        || opt_key == "support_material_buildplate_only"
+        || opt_key == "support_material_enforce_layers"
+        || opt_key == "support_material_extruder"
+        || opt_key == "support_material_extrusion_width"
+        || opt_key == "support_material_interface_layers"
+        || opt_key == "support_material_interface_contact_loops"
+        || opt_key == "support_material_interface_extruder"
+        || opt_key == "support_material_interface_spacing"
+        || opt_key == "support_material_pattern"
+        || opt_key == "support_material_interface_pattern"
+        || opt_key == "support_material_xy_spacing"
+        || opt_key == "support_material_spacing"
+        || opt_key == "support_material_synchronize_layers"
+        || opt_key == "support_material_threshold"
+        || opt_key == "support_material_with_sheath"
+        || opt_key == "dont_support_bridges"
+        || opt_key == "first_layer_extrusion_width"
+        || opt_key == "support_material_solid_first_layer") {
+        steps.emplace_back(posSupportMaterial);
+    } else if (
+           opt_key == "interface_shells"
+        || opt_key == "infill_only_where_needed"
+        || opt_key == "infill_every_layers"
+        || opt_key == "solid_infill_every_layers"
+        || opt_key == "infill_dense"
+        || opt_key == "infill_not_connected"
+        || opt_key == "infill_dense_algo"
+        || opt_key == "bottom_solid_layers"
+        || opt_key == "bottom_solid_min_thickness"
+        || opt_key == "top_solid_layers"
+        || opt_key == "top_solid_min_thickness"
+        || opt_key == "solid_infill_below_area"
+        || opt_key == "infill_extruder"
+        || opt_key == "solid_infill_extruder"
+        || opt_key == "infill_extrusion_width"
+        || opt_key == "ensure_vertical_shell_thickness"
+        || opt_key == "bridged_infill_margin"
+        || opt_key == "bridge_angle") {
+        steps.emplace_back(posPrepareInfill);
+    } else if (
+        opt_key == "top_fill_pattern"
+        || opt_key == "bottom_fill_pattern"
+        || opt_key == "solid_fill_pattern"
+        || opt_key == "enforce_full_fill_volume"
+        || opt_key == "fill_angle"
+        || opt_key == "fill_pattern"
+        || opt_key == "fill_top_flow_ratio"
+        || opt_key == "fill_smooth_width"
+        || opt_key == "fill_smooth_distribution"
+        || opt_key == "top_infill_extrusion_width"
+        || opt_key == "first_layer_extrusion_width") {
+        steps.emplace_back(posInfill);
+    } else if (
+           opt_key == "fill_density"
+        || opt_key == "external_infill_margin"
+        || opt_key == "solid_infill_extrusion_width") {
+        steps.emplace_back(posPerimeters);
+        steps.emplace_back(posPrepareInfill);
+    } else if (
+           opt_key == "external_perimeter_extrusion_width"
+        || opt_key == "perimeter_extruder") {
+        steps.emplace_back(posPerimeters);
+        steps.emplace_back(posSupportMaterial);
+    } else if (opt_key == "bridge_flow_ratio") {
+        steps.emplace_back(posPerimeters);
+        steps.emplace_back(posInfill);
+        steps.emplace_back(posSupportMaterial);
+    } else if (
+           opt_key == "seam_position"
+        || opt_key == "seam_travel"
+        || opt_key == "seam_preferred_direction"
+        || opt_key == "seam_preferred_direction_jitter"
+        || opt_key == "support_material_speed"
+        || opt_key == "support_material_interface_speed"
+        || opt_key == "bridge_speed"
+        || opt_key == "external_perimeter_speed"
+        || opt_key == "external_perimeters_vase"
+        || opt_key == "infill_speed"
+        || opt_key == "perimeter_speed"
+        || opt_key == "small_perimeter_speed"
+        || opt_key == "solid_infill_speed"
+        || opt_key == "top_solid_infill_speed") {
+        print_steps.emplace_back(psGCodeExport);
+    } else if (
+           opt_key == "wipe_into_infill"
+        || opt_key == "wipe_into_objects") {
+        print_steps.emplace_back(psWipeTower);
+        print_steps.emplace_back(psGCodeExport);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+SCENARIO("PrintObject: config option dependencies", "[PrintObject]") {
+    GIVEN("All the PrintObjectConfig and PrintRegionConfig options") {
+        t_config_option_keys opt_keys = PrintObjectConfig().keys();
+        append(opt_keys, PrintRegionConfig().keys());
+        // Options which used to reset all the steps of the PrintObject.
+        const std::set<t_config_option_key> refined {
+            "brim_inside_holes", "brim_width", "brim_width_interior", "brim_ears", "brim_ears_max_angle", "brim_offset",
+            "external_perimeter_cut_corners", "extrusion_width", "model_precision",
+            "over_bridge_flow_ratio", "bridge_overlap", "curve_smoothing_precision", "curve_smoothing_cutoff_dist",
+            "curve_smoothing_angle_convex", "curve_smoothing_angle_concave", "external_perimeter_overlap", "extra_perimeters_overhangs",
+            "gap_fill_min_area", "infill_first", "milling_after_z", "milling_extra_size", "milling_post_process", "milling_speed",
+            "print_extrusion_multiplier", "thin_walls_speed"
+        };
+        THEN("Each option has a dependency") {
+            for (const t_config_option_key &opt_key : opt_keys) {
+                INFO(opt_key);
+                REQUIRE(PrintObject::config_option_dependency(opt_key) != nullptr);
+            }
+        }
+        THEN("The dependencies match the former mapping of the options to the steps") {
+            for (const t_config_option_key &opt_key : opt_keys) {
+                INFO(opt_key);
+                std::vector<PrintObjectStep> steps;
+                std::vector<PrintStep>       print_steps;
+                bool handled = legacy_config_option_dependency(opt_key, steps, print_steps);
+                REQUIRE(handled == (refined.find(opt_key) == refined.end()));
+                if (handled) {
+                    const PrintObjectConfigDependency *dependency = PrintObject::config_option_dependency(opt_key);
+                    std::vector<PrintObjectStep> new_steps       = dependency->object_steps;
+                    std::vector<PrintStep>       new_print_steps = dependency->print_steps;
+                    sort_remove_duplicates(steps);
+                    sort_remove_duplicates(print_steps);
+                    sort_remove_duplicates(new_steps);
+                    sort_remove_duplicates(new_print_steps);
+                    REQUIRE(new_steps == steps);
+                    REQUIRE(new_print_steps == print_steps);
+                }
+            }
+        }
+    }
+}
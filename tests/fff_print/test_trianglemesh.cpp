@@ -1,6 +1,7 @@
 #include <catch2/catch.hpp>
 
 #include "libslic3r/TriangleMesh.hpp"
+#include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/Point.hpp"
 #include "libslic3r/Config.hpp"
 #include "libslic3r/Model.hpp"
@@ -9,6 +10,7 @@
 #include <algorithm>
 #include <future>
 #include <chrono>
+#include <random>
 
 //#include "test_options.hpp"
 #include "test_data.hpp"
@@ -228,6 +230,43 @@ SCENARIO( "TriangleMesh: slice behavior.") {
     }
 }
 
+SCENARIO( "TriangleMeshSlicer: sweep algorithm matches the facet parallel algorithm.") {
+    for (Slic3r::Test::TestMesh test_mesh : { Slic3r::Test::TestMesh::cube_20x20x20, Slic3r::Test::TestMesh::sphere_50mm, Slic3r::Test::TestMesh::ipadstand,
+                                              Slic3r::Test::TestMesh::cube_with_concave_hole, Slic3r::Test::TestMesh::sloping_hole, Slic3r::Test::TestMesh::two_hollow_squares }) {
+        GIVEN(std::string("Mesh ") + Slic3r::Test::mesh_names.at(test_mesh)) {
+            TriangleMesh mesh = Slic3r::Test::mesh(test_mesh);
+            mesh.require_shared_vertices();
+            BoundingBoxf3 bb = mesh.bounding_box();
+            std::vector<float> z;
+            // Include planes exactly on the mesh vertices.
+            for (double slice_z = bb.min.z(); slice_z <= bb.max.z(); slice_z += 0.1)
+                z.emplace_back(float(slice_z));
+            WHEN("sliced by both algorithms") {
+                std::vector<ExPolygons> layers[2];
+                for (int i = 0; i < 2; ++ i) {
+                    TriangleMeshSlicer slicer(0.f, 0.f);
+                    slicer.algorithm = (i == 0) ? TriangleMeshSlicer::Algorithm::FacetParallel : TriangleMeshSlicer::Algorithm::Sweep;
+                    slicer.init(&mesh, [](){});
+                    slicer.slice(z, SlicingMode::Regular, &layers[i], [](){});
+                }
+                THEN("the slices are the same") {
+                    REQUIRE(layers[0].size() == z.size());
+                    REQUIRE(layers[1].size() == z.size());
+                    for (size_t layer_idx = 0; layer_idx < z.size(); ++ layer_idx) {
+                        REQUIRE(layers[0][layer_idx].size() == layers[1][layer_idx].size());
+                        double area[2] = { 0., 0. };
+                        for (int i = 0; i < 2; ++ i)
+                            for (const ExPolygon &expoly : layers[i][layer_idx])
+                                area[i] += expoly.area();
+                        REQUIRE(area[0] == Approx(area[1]));
+                        REQUIRE(diff_ex(to_polygons(layers[0][layer_idx]), to_polygons(layers[1][layer_idx])).empty());
+                    }
+                }
+            }
+        }
+    }
+}
+
 SCENARIO( "make_xxx functions produce meshes.") {
     GIVEN("make_cube() function") {
         WHEN("make_cube() is called with arguments 20,20,20") {
@@ -348,6 +387,56 @@ SCENARIO( "TriangleMesh: Mesh merge functions") {
     }
 }
 
+SCENARIO( "stl_check_facets_exact: edges are matched as they come.") {
+    GIVEN( "Three facets sharing an edge") {
+        const stl_vertex a(0, 0, 0), b(1, 0, 0), c(0, 1, 0), d(0, -1, 0), e(0, 0, 1);
+        stl_file stl;
+        stl.stats.number_of_facets = 3;
+        stl_allocate(&stl);
+        stl.facet_start[0].vertex[0] = a; stl.facet_start[0].vertex[1] = b; stl.facet_start[0].vertex[2] = c;
+        stl.facet_start[1].vertex[0] = b; stl.facet_start[1].vertex[1] = a; stl.facet_start[1].vertex[2] = d;
+        stl.facet_start[2].vertex[0] = a; stl.facet_start[2].vertex[1] = b; stl.facet_start[2].vertex[2] = e;
+        WHEN( "The neighbors are calculated") {
+            stl_check_facets_exact(&stl);
+            THEN( "The second facet is connected to the first one, the third one stays unconnected.") {
+                REQUIRE(stl.neighbors_start[0].neighbor[0] == 1);
+                REQUIRE(stl.neighbors_start[1].neighbor[0] == 0);
+                REQUIRE(stl.neighbors_start[2].num_neighbors() == 0);
+                REQUIRE(stl.stats.connected_edges == 2);
+                REQUIRE(stl.stats.connected_facets_1_edge == 2);
+                REQUIRE(stl.stats.connected_facets_2_edge == 0);
+            }
+        }
+    }
+    GIVEN( "A sphere with shuffled facets") {
+        TriangleMesh sphere = make_sphere(10., PI / 90.);
+        std::mt19937 rng(0);
+        std::shuffle(sphere.stl.facet_start.begin(), sphere.stl.facet_start.end(), rng);
+        WHEN( "The neighbors and the shared vertices are calculated") {
+            stl_check_facets_exact(&sphere.stl);
+            indexed_triangle_set its;
+            stl_generate_shared_vertices(&sphere.stl, its);
+            THEN( "All the edges are connected and the facets are indexed with the same vertices.") {
+                REQUIRE(sphere.stl.stats.connected_facets_3_edge == int(sphere.stl.stats.number_of_facets));
+                REQUIRE(its.vertices.size() == sphere.its.vertices.size());
+                bool same = true;
+                for (size_t i = 0; i < its.indices.size(); ++ i)
+                    for (size_t j = 0; j < 3; ++ j)
+                        same &= its.vertices[its.indices[i](j)] == sphere.stl.facet_start[i].vertex[j];
+                REQUIRE(same);
+            }
+            THEN( "The serial and the parallel algorithms produce identical indexed triangle sets.") {
+                indexed_triangle_set its_serial, its_parallel;
+                stl_generate_shared_vertices(&sphere.stl, its_serial, stl_shared_vertices_algorithm::serial);
+                stl_generate_shared_vertices(&sphere.stl, its_parallel, stl_shared_vertices_algorithm::parallel);
+                REQUIRE(its_serial.vertices.size() == its.vertices.size());
+                REQUIRE(its_serial.indices == its_parallel.indices);
+                REQUIRE(its_serial.vertices == its_parallel.vertices);
+            }
+        }
+    }
+}
+
 SCENARIO( "TriangleMeshSlicer: Cut behavior.") {
     GIVEN( "A 20mm cube with one corner on the origin") {
         const std::vector<Vec3d> vertices { Vec3d(20,20,0), Vec3d(20,0,0), Vec3d(0,0,0), Vec3d(0,20,0), Vec3d(20,20,20), Vec3d(0,20,20), Vec3d(0,0,20), Vec3d(20,0,20) };
@@ -201,3 +201,32 @@ SCENARIO("Config ini load/save interface", "[Config]") {
         }
     }
 }
+
+SCENARIO("Config diff of configs of the same type", "[Config]") {
+    GIVEN("Two default region configs") {
+        PrintRegionConfig config1, config2;
+        WHEN("No value is changed") {
+            THEN("The configs are equal.") {
+                REQUIRE(config1.diff(config2).empty());
+                REQUIRE(config1.equals(config2));
+            }
+        }
+        WHEN("Two values are changed") {
+            config2.set_deserialize("perimeters", "5");
+            config2.set_deserialize("infill_every_layers", "3");
+            THEN("The keys of the changed values are returned in the order of the keys.") {
+                REQUIRE(config1.diff(config2) == t_config_option_keys({ "infill_every_layers", "perimeters" }));
+                REQUIRE(config1.diff(config2) == static_cast<const ConfigBase&>(config1).diff(DynamicPrintConfig(config2)));
+            }
+        }
+    }
+    GIVEN("Two dynamic configs with partially overlapping keys") {
+        DynamicPrintConfig config1, config2;
+        config1.set_deserialize({ { "layer_height", "0.2" }, { "perimeters", "3" }, { "top_solid_layers", "4" } });
+        config2.set_deserialize({ { "bottom_solid_layers", "2" }, { "layer_height", "0.3" }, { "perimeters", "3" } });
+        THEN("Only the differing values of the options present in both configs are returned.") {
+            REQUIRE(config1.diff(config2) == t_config_option_keys({ "layer_height" }));
+            REQUIRE(config2.diff(config1) == t_config_option_keys({ "layer_height" }));
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include <catch2/catch.hpp>
+
+#include "libslic3r/GCodeReader.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <boost/nowide/fstream.hpp>
+
+using namespace Slic3r;
+
+static const std::string gcode_sample =
+    "G21 ; set units to millimeters\n"
+    "G90\n"
+    "M83 ; use relative distances for extrusion\n"
+    "G1 Z0.350 F7800.000\n"
+    "G1 X-12.5 Y.75 E+1.00000\n"
+    "\n"
+    "  G1 X104.317 Y95.683 E0.03826 ; perimeter\n"
+    "G1 X1e2 Y0x10 E-0.8 F2400\r\n"
+    "G1 X123456789.0123456 Y-0.000001\n"
+    "T1\n"
+    "G1 X10 Y20 ; last line without a newline";
+
+struct ParsedLine {
+    std::string raw;
+    std::string cmd;
+    std::string comment;
+    float       axis[4];
+    bool        has[4];
+};
+
+static void record(std::vector<ParsedLine> &out, const GCodeReader::GCodeLine &line)
+{
+    ParsedLine l;
+    l.raw     = std::string(line.raw());
+    l.cmd     = std::string(line.cmd());
+    l.comment = std::string(line.comment());
+    l.has[0] = line.has_x(); l.axis[0] = line.x();
+    l.has[1] = line.has_y(); l.axis[1] = line.y();
+    l.has[2] = line.has_z(); l.axis[2] = line.z();
+    l.has[3] = line.has_e(); l.axis[3] = line.e();
+    out.emplace_back(std::move(l));
+}
+
+SCENARIO("GCodeReader parses lines in place", "[GCodeReader]") {
+    GIVEN("A G-code buffer") {
+        std::vector<ParsedLine> lines;
+        GCodeReader reader;
+        reader.parse_buffer(gcode_sample, [&lines](GCodeReader &, const GCodeReader::GCodeLine &line) { record(lines, line); });
+
+        THEN("The raw lines, commands and comments are split") {
+            REQUIRE(lines.size() == 11);
+            REQUIRE(lines[0].raw == "G21 ; set units to millimeters");
+            REQUIRE(lines[0].cmd == "G21");
+            REQUIRE(lines[0].comment == " set units to millimeters");
+            REQUIRE(lines[5].raw.empty());
+            REQUIRE(lines[5].cmd.empty());
+            REQUIRE(lines[6].cmd == "G1");
+            REQUIRE(lines[6].comment == " perimeter");
+            REQUIRE(lines[7].raw == "G1 X1e2 Y0x10 E-0.8 F2400");
+            REQUIRE(lines[9].cmd == "T1");
+        }
+        THEN("The numbers are parsed exactly as by strtod()") {
+            REQUIRE(lines[3].has[2]);
+            REQUIRE(lines[3].axis[2] == float(strtod("0.350", nullptr)));
+            REQUIRE(lines[4].axis[0] == float(strtod("-12.5", nullptr)));
+            REQUIRE(lines[4].axis[1] == float(strtod(".75", nullptr)));
+            REQUIRE(lines[4].axis[3] == float(strtod("+1.00000", nullptr)));
+            REQUIRE(lines[6].axis[0] == float(strtod("104.317", nullptr)));
+            REQUIRE(lines[6].axis[3] == float(strtod("0.03826", nullptr)));
+            REQUIRE(lines[7].axis[0] == 100.f);
+            REQUIRE(lines[7].axis[1] == 16.f);
+            REQUIRE(lines[7].axis[3] == float(strtod("-0.8", nullptr)));
+            REQUIRE(lines[8].axis[0] == float(strtod("123456789.0123456", nullptr)));
+            REQUIRE(lines[8].axis[1] == float(strtod("-0.000001", nullptr)));
+        }
+    }
+    GIVEN("The same G-code saved into a file") {
+        boost::filesystem::path temp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        {
+            boost::nowide::ofstream f(temp.string(), std::ios::out | std::ios::binary);
+            f << gcode_sample;
+        }
+        std::vector<ParsedLine> from_buffer, from_file;
+        GCodeReader().parse_buffer(gcode_sample, [&from_buffer](GCodeReader &, const GCodeReader::GCodeLine &line) { record(from_buffer, line); });
+        GCodeReader().parse_file(temp.string(), [&from_file](GCodeReader &, const GCodeReader::GCodeLine &line) { record(from_file, line); });
+        boost::nowide::remove(temp.string().c_str());
+        THEN("The memory mapped file is parsed the same way as the buffer") {
+            REQUIRE(from_file.size() == from_buffer.size());
+            for (size_t i = 0; i < from_file.size(); ++ i) {
+                REQUIRE(from_file[i].raw == from_buffer[i].raw);
+                for (size_t j = 0; j < 4; ++ j) {
+                    REQUIRE(from_file[i].has[j] == from_buffer[i].has[j]);
+                    REQUIRE(from_file[i].axis[j] == from_buffer[i].axis[j]);
+                }
+            }
+        }
+    }
+    GIVEN("A line modified by set()") {
+        GCodeReader reader;
+        std::string modified;
+        reader.parse_buffer("G1 Z0.2 X1\n", [&modified](GCodeReader &reader, const GCodeReader::GCodeLine &line) {
+            GCodeReader::GCodeLine copy(line);
+            copy.set(reader, Z, 0.35f);
+            modified = std::string(copy.raw());
+        });
+        THEN("The copy owns the modified raw line") {
+            REQUIRE(modified == "G1 Z0.350 X1");
+        }
+    }
+}
@@ -9,6 +9,8 @@
 #include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/ShortestPath.hpp"
 
+#include <random>
+
 using namespace Slic3r;
 
 ExtrusionPath* createEP(std::initializer_list<Point> vec) {
@@ -376,6 +378,63 @@ SCENARIO("Path chaining", "[Geometry]") {
 			}
 		}
 	}
+	GIVEN("Many scattered points") {
+		std::mt19937 rng(0);
+		std::uniform_int_distribution<coord_t> coord(0, scale_(200.));
+		Points points;
+		for (size_t i = 0; i < 5000; ++ i)
+			points.emplace_back(coord(rng), coord(rng));
+		std::vector<size_t> indices = chain_points(points);
+		THEN("Chained by the closest neighbor, same as by the brute force search") {
+			std::vector<size_t> expected { 0 };
+			std::vector<char>   taken(points.size(), false);
+			taken.front() = true;
+			while (expected.size() < points.size()) {
+				const Point &last     = points[expected.back()];
+				size_t       best_idx = 0;
+				double       best_d2  = std::numeric_limits<double>::max();
+				for (size_t i = 0; i < points.size(); ++ i)
+					if (! taken[i]) {
+						double d2 = (points[i] - last).cast<double>().squaredNorm();
+						if (d2 < best_d2) {
+							best_d2  = d2;
+							best_idx = i;
+						}
+					}
+				taken[best_idx] = true;
+				expected.emplace_back(best_idx);
+			}
+			REQUIRE(indices == expected);
+		}
+	}
+	GIVEN("Hundreds of short scattered lines") {
+		std::mt19937 rng(0);
+		std::uniform_real_distribution<double> pos(0., 200.), dir(-1., 1.);
+		Polylines polylines;
+		for (size_t i = 0; i < 150; ++ i) {
+			Vec2d a(pos(rng), pos(rng));
+			Vec2d b = a + Vec2d(dir(rng), dir(rng));
+			polylines.emplace_back(Polyline(Point::new_scale(a.x(), a.y()), Point::new_scale(b.x(), b.y())));
+		}
+		auto travel_length = [](const Polylines &chained) {
+			double length = 0.;
+			for (size_t i = 1; i < chained.size(); ++ i)
+				length += (chained[i].first_point() - chained[i - 1].last_point()).cast<double>().norm();
+			return length;
+		};
+		Polylines greedy   = chain_polylines(Polylines(polylines), nullptr, 0);
+		Polylines uncapped = chain_polylines(Polylines(polylines), nullptr, std::numeric_limits<size_t>::max());
+		Polylines chained  = chain_polylines(Polylines(polylines));
+		THEN("The two exchanges shorten the travel of the greedy chain") {
+			REQUIRE(greedy.size() == polylines.size());
+			REQUIRE(uncapped.size() == polylines.size());
+			REQUIRE(travel_length(uncapped) < 0.95 * travel_length(greedy));
+		}
+		THEN("The travel is as short as without limiting the two exchanges") {
+			REQUIRE(chained.size() == polylines.size());
+			REQUIRE(travel_length(chained) == Approx(travel_length(uncapped)));
+		}
+	}
 }
 
 SCENARIO("Line distances", "[Geometry]"){
@@ -0,0 +1,105 @@
+#include <catch2/catch.hpp>
+
+#include "libslic3r/SliceCache.hpp"
+
+#include <ctime>
+#include <boost/filesystem.hpp>
+
+using namespace Slic3r;
+
+static std::vector<ExPolygons> slice_cube(TriangleMesh &mesh, const std::vector<float> &z)
+{
+    std::vector<ExPolygons> layers;
+    mesh.require_shared_vertices();
+    TriangleMeshSlicer slicer(0.049f, 0.f);
+    slicer.init(&mesh, [](){});
+    slicer.slice(z, SlicingMode::Regular, &layers, [](){});
+    return layers;
+}
+
+SCENARIO("SliceCache stores and loads the slices", "[SliceCache]") {
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dir);
+
+    TriangleMesh            mesh = make_cube(20., 20., 20.);
+    std::vector<float>      z { 0.1f, 5.f, 10.f, 19.9f };
+    std::vector<ExPolygons> slices = slice_cube(mesh, z);
+    const std::string       key = SliceCache::make_key(mesh, z, SlicingMode::Regular, 0.049f, 0.f);
+
+    GIVEN("A cache with enough space") {
+        SliceCache cache(dir.string(), 1024 * 1024);
+        THEN("A missing entry is not loaded") {
+            std::vector<ExPolygons> loaded;
+            REQUIRE(! cache.load(key, loaded));
+        }
+        WHEN("The slices are stored") {
+            cache.store(key, slices);
+            THEN("The same slices are loaded back") {
+                std::vector<ExPolygons> loaded;
+                REQUIRE(cache.load(key, loaded));
+                REQUIRE(loaded.size() == slices.size());
+                for (size_t i = 0; i < slices.size(); ++ i)
+                    REQUIRE(loaded[i] == slices[i]);
+            }
+        }
+    }
+    GIVEN("The slicing parameters") {
+        THEN("The key depends on all of them") {
+            std::vector<float> z2 = z;
+            z2[1] = 5.1f;
+            TriangleMesh moved = mesh;
+            moved.translate(1.f, 0.f, 0.f);
+            REQUIRE(key == SliceCache::make_key(mesh, z, SlicingMode::Regular, 0.049f, 0.f));
+            REQUIRE(key == SliceCache::make_key(SliceCache::mesh_hash(mesh), z, SlicingMode::Regular, 0.049f, 0.f));
+            REQUIRE(key != SliceCache::make_key(mesh, z2, SlicingMode::Regular, 0.049f, 0.f));
+            REQUIRE(key != SliceCache::make_key(moved, z, SlicingMode::Regular, 0.049f, 0.f));
+            REQUIRE(key != SliceCache::make_key(mesh, z, SlicingMode::Positive, 0.049f, 0.f));
+            REQUIRE(key != SliceCache::make_key(mesh, z, SlicingMode::Regular, 0.1f, 0.f));
+            REQUIRE(key != SliceCache::make_key(mesh, z, SlicingMode::Regular, 0.049f, 0.0001f));
+        }
+    }
+    GIVEN("A cache limited to two entries") {
+        size_t entry_size;
+        {
+            SliceCache unlimited(dir.string(), 1024 * 1024);
+            unlimited.store("a", slices);
+            entry_size = size_t(boost::filesystem::file_size(dir / "a.slices"));
+        }
+        SliceCache cache(dir.string(), 2 * entry_size + entry_size / 2);
+        cache.store("b", slices);
+        std::time_t now = std::time(nullptr);
+        boost::filesystem::last_write_time(dir / "a.slices", now - 200);
+        boost::filesystem::last_write_time(dir / "b.slices", now - 100);
+        WHEN("The older entry is used and a third one is stored") {
+            std::vector<ExPolygons> loaded;
+            REQUIRE(cache.load("a", loaded));
+            cache.store("c", slices);
+            THEN("The least recently used entry is evicted") {
+                REQUIRE(boost::filesystem::exists(dir / "a.slices"));
+                REQUIRE(! boost::filesystem::exists(dir / "b.slices"));
+                REQUIRE(boost::filesystem::exists(dir / "c.slices"));
+            }
+        }
+    }
+    GIVEN("A cache directory exceeding the limit") {
+        size_t entry_size;
+        {
+            SliceCache unlimited(dir.string(), 1024 * 1024);
+            unlimited.store("a", slices);
+            unlimited.store("b", slices);
+            entry_size = size_t(boost::filesystem::file_size(dir / "a.slices"));
+        }
+        std::time_t now = std::time(nullptr);
+        boost::filesystem::last_write_time(dir / "a.slices", now - 200);
+        boost::filesystem::last_write_time(dir / "b.slices", now - 100);
+        WHEN("The cache is opened with a limit of one entry") {
+            SliceCache cache(dir.string(), entry_size + entry_size / 2);
+            THEN("The least recently used entry is evicted at startup") {
+                REQUIRE(! boost::filesystem::exists(dir / "a.slices"));
+                REQUIRE(boost::filesystem::exists(dir / "b.slices"));
+            }
+        }
+    }
+
+    boost::filesystem::remove_all(dir);
+}
@@ -1,5 +1,10 @@
 #include <catch2/catch.hpp>
 
+#include <random>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/cstdio.hpp>
+
 #include "libslic3r/Model.hpp"
 #include "libslic3r/Format/STL.hpp"
 
@@ -55,3 +60,51 @@ SCENARIO("Reading an STL file", "[stl]") {
 		}
 	}
 }
+
+SCENARIO("Reading a large STL file in parallel", "[stl]") {
+	GIVEN("a mesh saved as an ASCII and as a binary STL file, the ASCII file is split into several chunks") {
+		// Random coordinates of a wide range of exponents, so that the float parser of the ASCII STL is exercised.
+		stl_file stl;
+		stl.stats.number_of_facets = 20000;
+		stl_allocate(&stl);
+		std::mt19937 rng(0);
+		std::uniform_real_distribution<float> coordinate(-100.f, 100.f);
+		std::uniform_int_distribution<int>    exponent(-20, 20);
+		for (stl_facet &facet : stl.facet_start) {
+			for (size_t i = 0; i < 3; ++ i)
+				facet.normal(i) = coordinate(rng) / 100.f;
+			for (size_t i = 0; i < 3; ++ i)
+				for (size_t j = 0; j < 3; ++ j)
+					facet.vertex[i](j) = std::ldexp(coordinate(rng), exponent(rng));
+		}
+		boost::filesystem::path path_ascii  = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+		boost::filesystem::path path_binary = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+		REQUIRE(stl_write_ascii(&stl, path_ascii.string().c_str(), "random"));
+		REQUIRE(stl_write_binary(&stl, path_binary.string().c_str(), "random"));
+		WHEN("both files are read") {
+			stl_file stl_ascii, stl_binary;
+			bool ascii_ok  = stl_open(&stl_ascii, path_ascii.string().c_str());
+			bool binary_ok = stl_open(&stl_binary, path_binary.string().c_str());
+			boost::nowide::remove(path_ascii.string().c_str());
+			boost::nowide::remove(path_binary.string().c_str());
+			THEN("the facets are read back exactly") {
+				REQUIRE(ascii_ok);
+				REQUIRE(binary_ok);
+				REQUIRE(stl_ascii.stats.type == ascii);
+				REQUIRE(stl_binary.stats.type == binary);
+				REQUIRE(stl_ascii.stats.number_of_facets == stl.stats.number_of_facets);
+				REQUIRE(stl_binary.stats.number_of_facets == stl.stats.number_of_facets);
+				bool same = true;
+				for (size_t i = 0; i < stl.facet_start.size(); ++ i)
+					for (const stl_file *loaded : { &stl_ascii, &stl_binary }) {
+						same &= loaded->facet_start[i].normal == stl.facet_start[i].normal;
+						for (size_t j = 0; j < 3; ++ j)
+							same &= loaded->facet_start[i].vertex[j] == stl.facet_start[i].vertex[j];
+					}
+				REQUIRE(same);
+				REQUIRE(stl_ascii.stats.min == stl_binary.stats.min);
+				REQUIRE(stl_ascii.stats.max == stl_binary.stats.max);
+			}
+		}
+	}
+}
@@ -1,9 +1,19 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <random>
+#include <numeric>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem/operations.hpp>
 
 #include "sla_test_utils.hpp"
 
+#include "libslic3r/SLA/Concurrency.hpp"
+#include "libslic3r/SLA/RasterWriter.hpp"
+#include "libslic3r/miniz_extension.hpp"
+
 namespace {
 
 const char *const BELOW_PAD_TEST_OBJECTS[] = {
@@ -218,6 +228,118 @@ TEST_CASE("RasterizedPolygonAreaShouldMatch", "[SLARasterOutput]") {
     REQUIRE(diff <= predict_error(poly, pixdim));
 }
 
+TEST_CASE("Ordered enumeration hands over the results in order", "[SLAConcurrency]") {
+    const size_t N = 200, max_in_flight = 8;
+    std::vector<size_t> input(N);
+    std::iota(input.begin(), input.end(), size_t(100));
+    
+    std::atomic<size_t> in_flight{0}, max_seen{0};
+    std::vector<size_t> consumed, consumed_idx;
+    sla::ccr::enumerate_ordered(input.begin(), input.end(), max_in_flight,
+        [&](size_t v, size_t idx) {
+            size_t cnt = ++in_flight;
+            for (size_t m = max_seen; cnt > m && ! max_seen.compare_exchange_weak(m, cnt););
+            // The lower items take longer, so that the higher ones finish first.
+            std::this_thread::sleep_for(std::chrono::microseconds(20 * (N - idx)));
+            return v * 2;
+        },
+        [&](size_t &&r, size_t idx) {
+            --in_flight;
+            consumed_idx.emplace_back(idx);
+            consumed.emplace_back(r);
+        });
+    
+    REQUIRE(consumed.size() == N);
+    for (size_t i = 0; i < N; ++i) {
+        REQUIRE(consumed_idx[i] == i);
+        REQUIRE(consumed[i] == 2 * input[i]);
+    }
+    REQUIRE(max_seen <= max_in_flight);
+}
+
+namespace {
+
+// Name and contents of the entries of a zip archive in their order.
+std::vector<std::pair<std::string, std::vector<uint8_t>>> read_zip_entries(const std::string &path)
+{
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> out;
+    mz_zip_archive archive;
+    mz_zip_zero_struct(&archive);
+    REQUIRE(open_zip_reader(&archive, path));
+    for (mz_uint i = 0; i < mz_zip_reader_get_num_files(&archive); ++i) {
+        mz_zip_archive_file_stat stat;
+        REQUIRE(mz_zip_reader_file_stat(&archive, i, &stat));
+        std::vector<uint8_t> data(size_t(stat.m_uncomp_size));
+        REQUIRE(mz_zip_reader_extract_to_mem(&archive, i, data.data(), data.size(), 0));
+        out.emplace_back(stat.m_filename, std::move(data));
+    }
+    close_zip_reader(&archive);
+    return out;
+}
+
+struct TmpArchive {
+    std::string path = (boost::filesystem::temp_directory_path() /
+                        boost::filesystem::unique_path("sla-test-%%%%-%%%%.sl1")).string();
+    ~TmpArchive() { boost::system::error_code ec; boost::filesystem::remove(path, ec); }
+};
+
+} // namespace
+
+TEST_CASE("Spooled raster layers are archived as the in memory ones", "[SLARasterOutput]") {
+    const size_t N = 40;
+    sla::Raster::Resolution res{320, 180};
+    sla::Raster::PixelDim   pixdim{120. / res.width_px, 68. / res.height_px};
+    sla::Raster::Trafo      trafo{sla::Raster::roPortrait, sla::Raster::MirrorX};
+    auto bb = BoundingBox({0, 0}, {scaled(120.), scaled(68.)});
+    
+    // A square with a hole growing with the layer index.
+    std::vector<ExPolygons> slices(N);
+    for (size_t i = 0; i < N; ++i) {
+        ExPolygon poly = square_with_hole(10. + double(i));
+        poly.translate(bb.center().x(), bb.center().y());
+        slices[i] = {poly};
+    }
+    
+    // All the layers kept in memory, the original export.
+    sla::RasterWriter inmemory(res, pixdim, trafo);
+    inmemory.layers(unsigned(N));
+    for (size_t i = 0; i < N; ++i) {
+        inmemory.begin_layer(unsigned(i));
+        for (const ExPolygon &poly : slices[i]) inmemory.draw_polygon(poly, unsigned(i));
+        inmemory.finish_layer(unsigned(i));
+    }
+    TmpArchive inmemory_archive;
+    inmemory.save(inmemory_archive.path, "test");
+    auto expected = read_zip_entries(inmemory_archive.path);
+    REQUIRE(expected.size() > N);
+    
+    auto rasterize_ordered = [&](bool parallel) {
+        sla::RasterWriter spooled(res, pixdim, trafo);
+        auto lvlfn = [&spooled, parallel](const ExPolygons &polys, size_t idx) {
+            // The lower layers take longer, so that they are done out of order.
+            if (parallel) std::this_thread::sleep_for(std::chrono::microseconds(200 * (N - idx)));
+            return spooled.rasterize_layer(polys);
+        };
+        auto writefn = [&spooled](sla::PNGImage &&png, size_t) { spooled.append_layer(png); };
+        if (parallel)
+            sla::ccr_par::enumerate_ordered(slices.begin(), slices.end(), 4, lvlfn, writefn);
+        else
+            sla::ccr_seq::enumerate_ordered(slices.begin(), slices.end(), 4, lvlfn, writefn);
+        REQUIRE(spooled.layers() == N);
+        TmpArchive archive;
+        spooled.save(archive.path, "test");
+        return read_zip_entries(archive.path);
+    };
+    
+    SECTION("Serial rasterization") {
+        REQUIRE(rasterize_ordered(false) == expected);
+    }
+    
+    SECTION("Parallel rasterization finishing the layers out of order") {
+        REQUIRE(rasterize_ordered(true) == expected);
+    }
+}
+
 TEST_CASE("Triangle mesh conversions should be correct", "[SLAConversions]")
 {
     sla::Contour3D cntr;